@@ -1,6 +1,9 @@
 #pragma once
 
 #include "VMAllocator.h"
+#include "AllocatorStats.h"
+#include "AllocatorPageMap.h"
+#include "HeapWalk.h"
 #include <iostream>
 #include <stdint.h>
 
@@ -11,13 +14,30 @@ struct ALLOC_BUFFER_STATIC {};
 struct ALLOC_BUFFER_STATIC_PREALLOC {};
 struct ALLOC_BUFFER_VMDYNAMIC {};
 
+struct ALLOC_FREELIST_ADDRESS_ORDERED {};
+struct ALLOC_FREELIST_BOUNDARY_TAG {};
+
+struct ALLOC_HANDLES_NONE {};
+struct ALLOC_HANDLES_GENERATIONAL {};
+
 enum BYTE_PREFIX {
     KB = 1024,
     MB = 1024*1024,
     GB = 1024*1024*1024
 };
 
-class Allocator {
+// what an allocator keeps outside of its buffer, as offsets from the buffer, so a heap in a mapped file can be adopted
+// by an allocator of a later process (see PersistentHeap.h), STATIC_PREALLOC Sequential List & Red Black Tree allocators only
+struct AllocatorPersistentState {
+    static constexpr uint64_t NIL = UINT64_MAX;
+
+    // address of the buffer when the state was saved, links inside the buffer that are pointers get rebased from it
+    uint64_t base;
+    uint64_t head;
+    uint64_t tail;
+};
+
+class Allocator : protected AllocatorStatsCounters<ALLOC_STATS_POLICY> {
 public:
     Allocator();
     ~Allocator();
@@ -38,4 +58,42 @@ public:
     virtual void Release() = 0;
 
     virtual void Layout() =0;
+
+    // ptr lies in memory this allocator hands out
+    virtual bool Owns(const void* ptr) =0;
+
+    // maps the address ranges of the allocator to owner (itself by default) in AllocatorPageMap, no ranges by default
+    virtual void RegisterPages(Allocator* owner = NULL) {}
+    // clears them, before the allocator is destroyed
+    virtual void UnregisterPages() {}
+
+    // counters since construction, all zero unless built with ALLOC_STATS
+    virtual AllocatorStats GetStats() { return _statsSnapshot(); }
+
+    // next block of the heap in address order (see HeapWalk.h), false once past the last block, no blocks by default
+    virtual bool Walk(HeapWalkCursor& cursor, HeapBlock& block) { return false; }
+    // free block histogram, largest free block & fragmentation index from one walk, empty by default
+    virtual HeapReport Report() { return HeapReport(); }
+
+protected:
+    // Layout() output, one line per block & a summary
+    static inline void _layoutBlock(const HeapBlock& block) {
+        std::cout << " [" << block.offset << ", " << block.offset + block.size << ") "
+            << (block.free ? "free" : "used");
+        if (!block.free)
+            std::cout << " padding " << block.padding;
+        std::cout << "\n";
+    }
+
+    static inline void _layoutReport(const HeapReport& report) {
+        std::cout << "Used blocks: " << report.nUsedBlocks << " (" << report.bytesUsed << " bytes)"
+            << " Free blocks: " << report.nFreeBlocks << " (" << report.bytesFree << " bytes)"
+            << " Largest free block: " << report.largestFree
+            << " Fragmentation index: " << report.FragmentationIndex() << "\nFree block sizes:";
+        for (uint32_t i = 0; i < HeapReport::N_HISTOGRAM_BUCKETS; ++i) {
+            if (report.freeHistogram[i])
+                std::cout << " [" << ((size_t)1 << i) << ": " << report.freeHistogram[i] << "]";
+        }
+        std::cout << std::endl;
+    }
 };
@@ -1,5 +1,8 @@
 #include "AllocatorBenchmark.h"
 #include <random>
+#include <string.h>
+#include <atomic>
+#include <thread>
 
 const size_t* AllocatorBenchmark::allocSize;
 
@@ -15,7 +18,7 @@ inline AllocatorBenchmark::FLAGS operator|(AllocatorBenchmark::FLAGS a, Allocato
 }
 
 void AllocatorBenchmark::allocSeq(Allocator* allocator, void** ptr) {
-    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, deltaTicks = 0;
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, deltaTicks = 0, worstTicks = 0;
     QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
     double QPCperiod = 1.0f / QPCfreq, deltaTime = 0, totalTime = 0;
 
@@ -28,6 +31,8 @@ void AllocatorBenchmark::allocSeq(Allocator* allocator, void** ptr) {
             void* p = allocator->Alloc(allocSize[i], alignment);
             QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
             deltaTicks += curTime - prevTime;
+            if (curTime - prevTime > worstTicks)
+                worstTicks = curTime - prevTime;
 
             ptr[i*N_TESTS + j] = p;
         }
@@ -38,11 +43,12 @@ void AllocatorBenchmark::allocSeq(Allocator* allocator, void** ptr) {
     }
 
     std::cout << N_TESTS*8 << " Sequential Allocations took " << totalTime << " ms\n";
+    std::cout << "Worst case allocation took " << worstTicks * (QPCperiod * 1000000) << " us\n";
     std::cout << "ALLOC SEQ\n/********************************/\n\n";
 }
 
 void AllocatorBenchmark::allocRand(Allocator* allocator, void** ptr) {
-    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, totalTime = 0;
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, totalTime = 0, worstTicks = 0;
     QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
     double QPCperiod = 1.0f / QPCfreq, deltaTime = 0;
 
@@ -65,62 +71,75 @@ void AllocatorBenchmark::allocRand(Allocator* allocator, void** ptr) {
         QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
         
         totalTime += curTime - prevTime;
+        if (curTime - prevTime > worstTicks)
+            worstTicks = curTime - prevTime;
 
         ptr[j] = p;
     }
 
     deltaTime = (totalTime) * (QPCperiod * 1000);
     std::cout << N_TESTS*8 << " Random Allocations took " << deltaTime << " ms\n";
+    std::cout << "Worst case allocation took " << worstTicks * (QPCperiod * 1000000) << " us\n";
 
     std::cout << "ALLOC RAND\n/********************************/\n\n";
 }
 
 void AllocatorBenchmark::freeLIFO(Allocator* allocator, void** ptr) {
-    __int64 prevTime = 0, QPCfreq = 0, curTime = 0;
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, deltaTicks = 0, worstTicks = 0;
     QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
     double QPCperiod = 1.0f / QPCfreq, deltaTime = 0, totalTime = 0;
 
     std::cout << "\n/********************************/\nFREE LIFO\n";
     for (int i = 7; i >= 0; --i) {
-        QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+        deltaTicks = 0;
+
         for (int j = N_TESTS - 1; j >= 0; --j) {
+            QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
             allocator->Free(ptr[i*N_TESTS + j]);
+            QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+            deltaTicks += curTime - prevTime;
+            if (curTime - prevTime > worstTicks)
+                worstTicks = curTime - prevTime;
         }
-        QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
 
-        deltaTime = ((curTime - prevTime) * QPCperiod);
+        deltaTime = deltaTicks * (QPCperiod * 1000);
         totalTime += deltaTime;
-        std::cout << N_TESTS << " LIFO Sequential Free w/ allocation size " << allocSize[i] << " took " << deltaTime * 1000 << " ms\n";
-        prevTime = curTime;
+        std::cout << N_TESTS << " LIFO Sequential Free w/ allocation size " << allocSize[i] << " took " << deltaTime << " ms\n";
     }
     std::cout << N_TESTS * 8 << " LIFO free took " << totalTime << " ms\n";
+    std::cout << "Worst case free took " << worstTicks * (QPCperiod * 1000000) << " us\n";
     std::cout << "FREE LIFO\n/********************************/\n\n";
 }
 
 void AllocatorBenchmark::freeFIFO(Allocator* allocator, void** ptr) {
-    __int64 prevTime = 0, QPCfreq = 0, curTime = 0;
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, deltaTicks = 0, worstTicks = 0;
     QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
     double QPCperiod = 1.0f / QPCfreq, deltaTime = 0, totalTime = 0;
 
     std::cout << "\n/********************************/\nFREE FIFO\n";
     for (int i = 0; i < 8; ++i) {
-        QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+        deltaTicks = 0;
+
         for (int j = 0; j < N_TESTS; ++j) {
+            QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
             allocator->Free(ptr[i*N_TESTS + j]);
+            QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+            deltaTicks += curTime - prevTime;
+            if (curTime - prevTime > worstTicks)
+                worstTicks = curTime - prevTime;
         }
-        QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
 
-        deltaTime = ((curTime - prevTime) * QPCperiod);
+        deltaTime = deltaTicks * (QPCperiod * 1000);
         totalTime += deltaTime;
-        std::cout << N_TESTS << " FIFO Sequential Free w/ allocation size " << allocSize[i] << " took " << deltaTime * 1000 << " ms\n";
-        prevTime = curTime;
+        std::cout << N_TESTS << " FIFO Sequential Free w/ allocation size " << allocSize[i] << " took " << deltaTime << " ms\n";
     }
     std::cout << N_TESTS * 8 << " FIFO free took " << totalTime << " ms\n";
+    std::cout << "Worst case free took " << worstTicks * (QPCperiod * 1000000) << " us\n";
     std::cout << "FREE FIFO\n/********************************/\n\n";
 }
 
 void AllocatorBenchmark::freeRand(Allocator* allocator, void** ptr) {
-    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, totalTime = 0;
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0, totalTime = 0, worstTicks = 0;
     QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
     double QPCperiod = 1.0f / QPCfreq, deltaTime = 0;
 
@@ -130,18 +149,191 @@ void AllocatorBenchmark::freeRand(Allocator* allocator, void** ptr) {
 
     std::cout << "\n/********************************/\nRAND FREE\n";
 
-    QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
     for (int j = 0; j < N_TESTS*8; ++j) {
+        QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
         allocator->Free(ptr[j]);
+        QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+        totalTime += curTime - prevTime;
+        if (curTime - prevTime > worstTicks)
+            worstTicks = curTime - prevTime;
     }
-    QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
 
-    deltaTime = ((curTime - prevTime) * QPCperiod);
-    std::cout << N_TESTS*8 << " RAND Free took " << deltaTime * 1000 << " ms\n";
+    deltaTime = totalTime * (QPCperiod * 1000);
+    std::cout << N_TESTS*8 << " RAND Free took " << deltaTime << " ms\n";
+    std::cout << "Worst case free took " << worstTicks * (QPCperiod * 1000000) << " us\n";
 
     std::cout << "RAND FREE\n/********************************/\n\n";
 }
 
+void AllocatorBenchmark::Throughput(Allocator* allocator) {
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+    double QPCperiod = 1.0f / QPCfreq, deltaTime = 0;
+
+    std::cout << "\n/********************************/\nTHROUGHPUT\n";
+
+    void** ptr = new void*[N_TESTS * 8];
+    size_t* sizes = new size_t[N_TESTS * 8];
+    uint32_t* order = new uint32_t[N_TESTS * 8];
+    size_t totalSize = 0;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    for (int j = 0; j < N_TESTS * 8; ++j) {
+        sizes[j] = allocSize[g() % 8];
+        ptr[j] = allocator->Alloc(sizes[j], alignment);
+        order[j] = j;
+        if (ptr[j])
+            totalSize += sizes[j];
+    }
+
+    std::shuffle(order, order + N_TESTS * 8, g);
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+    for (int k = 0; k < N_THROUGHPUT_PASSES; ++k) {
+        for (int j = 0; j < N_TESTS * 8; ++j) {
+            if (ptr[order[j]])
+                memset(ptr[order[j]], k, sizes[order[j]]);
+        }
+    }
+    QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+
+    deltaTime = (curTime - prevTime) * (QPCperiod * 1000);
+    std::cout << N_THROUGHPUT_PASSES << " passes over " << totalSize / 1024 << " KB in random block order took " << deltaTime << " ms\n";
+    std::cout << "Throughput " << (double)totalSize * N_THROUGHPUT_PASSES / (1024 * 1024) / (deltaTime / 1000) << " MB/s\n";
+
+    for (int j = 0; j < N_TESTS * 8; ++j)
+        allocator->Free(ptr[j]);
+
+    delete[] ptr;
+    delete[] sizes;
+    delete[] order;
+
+    std::cout << "THROUGHPUT\n/********************************/\n\n";
+}
+
+void AllocatorBenchmark::Fragmented(Allocator* allocator, uint32_t nFreeBlocks) {
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+    double QPCperiod = 1.0f / QPCfreq, deltaTime = 0;
+
+    std::cout << "\n/********************************/\nFRAGMENTED\n";
+
+    // holes of up to 128 bytes between 8 byte blocks that stay allocated
+    void** ptr = new void*[2 * (size_t)nFreeBlocks];
+    uint32_t* sizes = new uint32_t[N_FRAGMENTED_TESTS];
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    for (size_t j = 0; j < 2 * (size_t)nFreeBlocks; ++j)
+        ptr[j] = allocator->Alloc(j & 1 ? 8 : allocSize[g() % 5], alignment);
+    for (size_t j = 0; j < 2 * (size_t)nFreeBlocks; j += 2)
+        allocator->Free(ptr[j]);
+
+    for (uint32_t j = 0; j < N_FRAGMENTED_TESTS; ++j)
+        sizes[j] = (uint32_t)allocSize[g() % 5];
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+    for (uint32_t j = 0; j < N_FRAGMENTED_TESTS; ++j) {
+        void* p = allocator->Alloc(sizes[j], alignment);
+        allocator->Free(p);
+    }
+    QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+
+    deltaTime = (curTime - prevTime) * (QPCperiod * 1000);
+    std::cout << N_FRAGMENTED_TESTS << " Alloc & Free pairs over " << nFreeBlocks << " free blocks took " << deltaTime << " ms ("
+        << deltaTime * 1000000 / N_FRAGMENTED_TESTS << " ns per pair)\n";
+
+    for (size_t j = 1; j < 2 * (size_t)nFreeBlocks; j += 2)
+        allocator->Free(ptr[j]);
+
+    delete[] ptr;
+    delete[] sizes;
+
+    std::cout << "FRAGMENTED\n/********************************/\n\n";
+}
+
+void AllocatorBenchmark::CrossThread(Allocator* allocator) {
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+    double QPCperiod = 1.0f / QPCfreq, deltaTime = 0;
+
+    std::cout << "\n/********************************/\nCROSS THREAD\n";
+
+    void** ptr = new void*[N_CROSS_THREAD_TESTS];
+    std::atomic<uint32_t> nProduced(0);
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+
+    std::thread consumer([&]() {
+        for (uint32_t j = 0; j < N_CROSS_THREAD_TESTS; ++j) {
+            while (nProduced.load(std::memory_order_acquire) <= j)
+                std::this_thread::yield();
+            allocator->Free(ptr[j]);
+        }
+    });
+
+    for (uint32_t j = 0; j < N_CROSS_THREAD_TESTS; ++j) {
+        ptr[j] = allocator->Alloc(allocSize[j % 5], alignment);
+        nProduced.store(j + 1, std::memory_order_release);
+    }
+
+    consumer.join();
+    QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+
+    deltaTime = (curTime - prevTime) * (QPCperiod * 1000);
+    std::cout << N_CROSS_THREAD_TESTS << " Allocations freed on another thread took " << deltaTime << " ms ("
+        << deltaTime * 1000000 / N_CROSS_THREAD_TESTS << " ns per pair)\n";
+
+    delete[] ptr;
+
+    std::cout << "CROSS THREAD\n/********************************/\n\n";
+}
+
+void AllocatorBenchmark::Scaling(Allocator* allocator, uint32_t nThreads) {
+    __int64 prevTime = 0, QPCfreq = 0, curTime = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+    double QPCperiod = 1.0f / QPCfreq, deltaTime = 0;
+
+    std::cout << "\n/********************************/\nSCALING\n";
+
+    std::thread* threads = new std::thread[nThreads];
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+
+    for (uint32_t t = 0; t < nThreads; ++t) {
+        threads[t] = std::thread([allocator, t]() {
+            void* live[N_SCALING_LIVE_BLOCKS] = {};
+            std::mt19937 g(t);
+
+            // free the oldest block, allocate a new one in its place
+            for (uint32_t j = 0; j < N_SCALING_TESTS; ++j) {
+                void*& p = live[j % N_SCALING_LIVE_BLOCKS];
+                allocator->Free(p);
+                p = allocator->Alloc(allocSize[g() % 8], alignment);
+            }
+
+            for (uint32_t j = 0; j < N_SCALING_LIVE_BLOCKS; ++j)
+                allocator->Free(live[j]);
+        });
+    }
+
+    for (uint32_t t = 0; t < nThreads; ++t)
+        threads[t].join();
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
+
+    deltaTime = (curTime - prevTime) * (QPCperiod * 1000);
+    std::cout << nThreads << " Threads x " << N_SCALING_TESTS << " Alloc & Free pairs took " << deltaTime << " ms ("
+        << (double)nThreads * N_SCALING_TESTS / (deltaTime * 1000) << " M pairs/s)\n";
+
+    delete[] threads;
+
+    std::cout << "SCALING\n/********************************/\n\n";
+}
+
 void AllocatorBenchmark::Benchmark(Allocator* allocator, int flags) {
     __int64 prevTime = 0, QPCfreq = 0, curTime = 0, totalTime = 0;
     QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
@@ -22,10 +22,29 @@ public:
 
     void Benchmark(Allocator*, int);
 
+    // write over randomly sized blocks in a random order, memory bound rather than allocator bound,
+    // run it on the same allocator with and without large pages to see the TLB reach difference
+    void Throughput(Allocator*);
+
+    // alloc/free pairs against an arena fragmented into nFreeBlocks free blocks that can't coalesce,
+    // measures the free block index (tree, lists) rather than the carving
+    void Fragmented(Allocator*, uint32_t nFreeBlocks);
+
+    // one thread allocates, another one frees every block in allocation order, the allocator has to be thread-safe
+    void CrossThread(Allocator*);
+
+    // nThreads alloc/free in parallel, each keeping a window of live blocks, the allocator has to be thread-safe
+    void Scaling(Allocator*, uint32_t nThreads);
+
 private:
     const static uint32_t N_TESTS = 10000;
     const static uint32_t alignment = 8;
     const static size_t* allocSize;
+    const static uint32_t N_THROUGHPUT_PASSES = 16;
+    const static uint32_t N_FRAGMENTED_TESTS = 100000;
+    const static uint32_t N_CROSS_THREAD_TESTS = 1000000;
+    const static uint32_t N_SCALING_TESTS = 1000000;
+    const static uint32_t N_SCALING_LIVE_BLOCKS = 64;
 
     // allocate batches of K byte blocks
     void allocSeq(Allocator*, void**);
@@ -0,0 +1,363 @@
+#include "AllocatorInterpose.h"
+#include "ThreadHeapAllocator.h"
+#include "TLSFAllocator.h"
+#include "AllocatorPageMap.h"
+#include <new>
+#include <atomic>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+typedef TLSFAllocator<ALLOC_BUFFER_VMDYNAMIC> LargeAllocator;
+
+constexpr size_t DEFAULT_ALIGNMENT = 16;
+// ThreadHeapAllocator (SlabAllocator) limits
+constexpr size_t SMALL_MAX_SIZE = 2048;
+constexpr size_t THREAD_HEAP_SIZE = 256 * 1024 * 1024;
+constexpr size_t LARGE_INITIAL_SIZE = 1024 * 1024;
+constexpr size_t BOOTSTRAP_SIZE = 256 * 1024;
+// requests past it fail, the worst case padding of the back-end is below the alignment plus a few words
+constexpr size_t MAX_SIZE = LargeAllocator::MAX_BLOCK_SIZE / 2;
+
+enum INIT_STATE : uint32_t {
+    UNINITIALIZED,
+    INITIALIZING,
+    READY
+};
+
+// everything here is constant initialized, malloc can be called before any static constructor runs
+alignas(64) uint8_t threadHeapStorage[sizeof(ThreadHeapAllocator)];
+alignas(64) uint8_t largeStorage[sizeof(LargeAllocator)];
+ThreadHeapAllocator* threadHeaps = NULL;
+LargeAllocator* large = NULL;
+SRWLOCK largeLock = SRWLOCK_INIT;
+std::atomic<uint32_t> initState(UNINITIALIZED);
+
+// the calling thread is inside the allocators, a nested call goes to the back-end (or the bootstrap arena)
+thread_local bool inAllocator = false;
+
+struct BootstrapHeader {
+    size_t sz;
+    size_t padding;
+};
+
+alignas(DEFAULT_ALIGNMENT) uint8_t bootstrap[BOOTSTRAP_SIZE];
+std::atomic<size_t> bootstrapUsed(0);
+
+// bump allocator for the allocations made while the allocators are being built, never freed
+void* _bootstrapAlloc(size_t sz, size_t alignment) {
+    size_t used = bootstrapUsed.load(std::memory_order_relaxed);
+    uintptr_t ptr, end;
+
+    do {
+        ptr = ((uintptr_t)bootstrap + used + sizeof(BootstrapHeader) + alignment - 1) & ~(alignment - 1);
+        end = ptr + sz;
+        if (end > (uintptr_t)bootstrap + BOOTSTRAP_SIZE)
+            return NULL;
+    } while (!bootstrapUsed.compare_exchange_weak(used, end - (uintptr_t)bootstrap, std::memory_order_relaxed));
+
+    ((BootstrapHeader*)(ptr - sizeof(BootstrapHeader)))->sz = sz;
+    return (void*)ptr;
+}
+
+inline bool _isBootstrap(void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)bootstrap && (uintptr_t)ptr < (uintptr_t)bootstrap + BOOTSTRAP_SIZE;
+}
+
+// builds the allocators on the first call, false while the calling thread is the one building them
+bool _ready() {
+    uint32_t state = initState.load(std::memory_order_acquire);
+    if (state == READY)
+        return true;
+
+    if (state == UNINITIALIZED && initState.compare_exchange_strong(state, INITIALIZING, std::memory_order_acquire)) {
+        inAllocator = true;
+        large = new(largeStorage) LargeAllocator(LARGE_INITIAL_SIZE);
+        threadHeaps = new(threadHeapStorage) ThreadHeapAllocator(THREAD_HEAP_SIZE);
+        inAllocator = false;
+
+        initState.store(READY, std::memory_order_release);
+        return true;
+    }
+
+    if (inAllocator)
+        return false;
+
+    while (initState.load(std::memory_order_acquire) != READY)
+        SwitchToThread();
+    return true;
+}
+
+void* _largeAlloc(size_t sz, size_t alignment) {
+    AcquireSRWLockExclusive(&largeLock);
+    void* ptr = large->Alloc(sz, alignment);
+    ReleaseSRWLockExclusive(&largeLock);
+    return ptr;
+}
+
+void* _alloc(size_t sz, size_t alignment) {
+    if (!sz)
+        sz = 1;
+    if (alignment < DEFAULT_ALIGNMENT)
+        alignment = DEFAULT_ALIGNMENT;
+
+    // more than the back-end's largest block, NULL (bad_alloc for new) rather than a wrapped size
+    if (alignment > MAX_SIZE || sz > MAX_SIZE - alignment)
+        return NULL;
+
+    if (!_ready())
+        return _bootstrapAlloc(sz, alignment);
+
+    // e.g. ThreadHeapAllocator allocating a new heap
+    if (inAllocator)
+        return _largeAlloc(sz, alignment);
+
+    inAllocator = true;
+
+    void* ptr = NULL;
+    if (sz <= SMALL_MAX_SIZE && alignment <= DEFAULT_ALIGNMENT)
+        ptr = threadHeaps->Alloc(sz, alignment);
+    if (!ptr)
+        ptr = _largeAlloc(sz, alignment);
+
+    inAllocator = false;
+    return ptr;
+}
+
+void _free(void* ptr) {
+    if (!ptr || _isBootstrap(ptr))
+        return;
+
+    if (initState.load(std::memory_order_acquire) != READY)
+        return;
+
+    // the thread heaps are always in the page map, everything else came from the back-end
+    if (AllocatorPageMap::Owner(ptr) == threadHeaps) {
+        threadHeaps->Free(ptr);
+        return;
+    }
+
+    AcquireSRWLockExclusive(&largeLock);
+    large->Free(ptr);
+    ReleaseSRWLockExclusive(&largeLock);
+}
+
+size_t _usableSize(void* ptr) {
+    if (_isBootstrap(ptr))
+        return ((BootstrapHeader*)((uintptr_t)ptr - sizeof(BootstrapHeader)))->sz;
+
+    if (AllocatorPageMap::Owner(ptr) == threadHeaps)
+        return threadHeaps->UsableSize(ptr);
+
+    // the block belongs to the caller, its header doesn't change under the lock
+    return large->UsableSize(ptr);
+}
+
+inline bool _isPowerOfTwo(size_t x) {
+    return x && !(x & (x - 1));
+}
+
+void* _new(size_t sz, size_t alignment) {
+    for (;;) {
+        void* ptr = _alloc(sz, alignment);
+        if (ptr)
+            return ptr;
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+}
+
+/* C API */
+
+extern "C" void* interpose_malloc(size_t sz) {
+    void* ptr = _alloc(sz, DEFAULT_ALIGNMENT);
+    if (!ptr)
+        errno = ENOMEM;
+    return ptr;
+}
+
+extern "C" void interpose_free(void* ptr) {
+    _free(ptr);
+}
+
+extern "C" void* interpose_calloc(size_t n, size_t sz) {
+    if (sz && n > SIZE_MAX / sz) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void* ptr = interpose_malloc(n * sz);
+    // slots and blocks are reused, nothing comes back zeroed
+    if (ptr)
+        memset(ptr, 0, n * sz);
+    return ptr;
+}
+
+extern "C" void* interpose_realloc(void* ptr, size_t sz) {
+    if (!ptr)
+        return interpose_malloc(sz);
+
+    if (!sz) {
+        _free(ptr);
+        return NULL;
+    }
+
+    size_t usable = _usableSize(ptr);
+    if (sz <= usable)
+        return ptr;
+
+    void* newPtr = interpose_malloc(sz);
+    if (!newPtr)
+        return NULL;
+
+    memcpy(newPtr, ptr, usable);
+    _free(ptr);
+    return newPtr;
+}
+
+extern "C" int interpose_posix_memalign(void** ptr, size_t alignment, size_t sz) {
+    if (!_isPowerOfTwo(alignment) || alignment % sizeof(void*))
+        return EINVAL;
+
+    void* p = _alloc(sz, alignment);
+    if (!p)
+        return ENOMEM;
+
+    *ptr = p;
+    return 0;
+}
+
+extern "C" void* interpose_aligned_alloc(size_t alignment, size_t sz) {
+    if (!_isPowerOfTwo(alignment)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void* ptr = _alloc(sz, alignment);
+    if (!ptr)
+        errno = ENOMEM;
+    return ptr;
+}
+
+extern "C" size_t interpose_malloc_usable_size(void* ptr) {
+    return ptr ? _usableSize(ptr) : 0;
+}
+
+/* malloc family */
+
+#ifdef ALLOC_INTERPOSE_MALLOC
+
+extern "C" void* malloc(size_t sz) {
+    return interpose_malloc(sz);
+}
+
+extern "C" void free(void* ptr) {
+    interpose_free(ptr);
+}
+
+extern "C" void* calloc(size_t n, size_t sz) {
+    return interpose_calloc(n, sz);
+}
+
+extern "C" void* realloc(void* ptr, size_t sz) {
+    return interpose_realloc(ptr, sz);
+}
+
+extern "C" size_t _msize(void* ptr) {
+    return interpose_malloc_usable_size(ptr);
+}
+
+#endif
+
+/* global operator new/delete */
+
+#ifdef ALLOC_INTERPOSE_NEW
+
+void* operator new(size_t sz) {
+    return _new(sz, DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](size_t sz) {
+    return _new(sz, DEFAULT_ALIGNMENT);
+}
+
+void* operator new(size_t sz, const std::nothrow_t&) noexcept {
+    return _alloc(sz, DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](size_t sz, const std::nothrow_t&) noexcept {
+    return _alloc(sz, DEFAULT_ALIGNMENT);
+}
+
+void* operator new(size_t sz, std::align_val_t alignment) {
+    return _new(sz, (size_t)alignment);
+}
+
+void* operator new[](size_t sz, std::align_val_t alignment) {
+    return _new(sz, (size_t)alignment);
+}
+
+void* operator new(size_t sz, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return _alloc(sz, (size_t)alignment);
+}
+
+void* operator new[](size_t sz, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return _alloc(sz, (size_t)alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    _free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    _free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    _free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    _free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    _free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    _free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    _free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    _free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    _free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    _free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    _free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    _free(ptr);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+malloc family and global operator new/delete on top of the allocators in this repo,
+to measure them under real programs rather than AllocatorBenchmark loops.
+
+Front-end: ThreadHeapAllocator, per thread slab heaps for requests up to 2048 bytes & 16 byte alignment,
+frees from other threads go through its remote free lists.
+Back-end: one VMDYNAMIC TLSFAllocator behind an SRW lock for everything else.
+
+The interpose_* functions are always exported. Build flags turn on the replacements:
+ALLOC_INTERPOSE_MALLOC defines malloc, free, calloc, realloc and _msize, for an executable linked against the static CRT (/MT),
+    the linker takes them over the CRT's own, the rest of the CRT heap (_aligned_malloc, _expand, _recalloc ...) isn't replaced,
+ALLOC_INTERPOSE_NEW replaces every global operator new/delete, sized and aligned overloads included.
+Requests over the largest block of the back-end fail (NULL, ENOMEM, or bad_alloc from new).
+
+The allocators are built in static storage on the first call. Anything they allocate while they're being built
+(and anything allocated from inside the allocators afterwards) is served by a small bootstrap arena or the back-end,
+so the replaced malloc never recurses into itself.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void* interpose_malloc(size_t sz);
+void interpose_free(void* ptr);
+void* interpose_calloc(size_t n, size_t sz);
+void* interpose_realloc(void* ptr, size_t sz);
+int interpose_posix_memalign(void** ptr, size_t alignment, size_t sz);
+void* interpose_aligned_alloc(size_t alignment, size_t sz);
+size_t interpose_malloc_usable_size(void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
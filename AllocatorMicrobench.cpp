@@ -0,0 +1,72 @@
+#include "AllocatorMicrobench.h"
+#include "SequentialListAllocator.h"
+#include "RBTreeAllocator.h"
+#include "BTreeAllocator.h"
+#include "TLSFAllocator.h"
+#include "SlabAllocator.h"
+#include "Segregator.h"
+#include "Bucketizer.h"
+#include "SystemAllocator.h"
+#include <iostream>
+
+namespace {
+    // every pattern of a size & alignment
+    template <typename _ALLOCATOR, size_t _SIZE, size_t _ALIGNMENT, typename... _ARGS>
+    void runPatterns(const char* name, _ARGS... args) {
+        MicrobenchScenario<_ALLOCATOR, _SIZE, _ALIGNMENT, BENCH_PATTERN_ALLOC_FREE>::Run(name, args...).Print();
+        MicrobenchScenario<_ALLOCATOR, _SIZE, _ALIGNMENT, BENCH_PATTERN_LIFO>::Run(name, args...).Print();
+        MicrobenchScenario<_ALLOCATOR, _SIZE, _ALIGNMENT, BENCH_PATTERN_FIFO>::Run(name, args...).Print();
+        MicrobenchScenario<_ALLOCATOR, _SIZE, _ALIGNMENT, BENCH_PATTERN_RANDOM>::Run(name, args...).Print();
+    }
+
+    // small, medium & large blocks, and over aligned ones (cache line unless the allocator can't)
+    template <typename _ALLOCATOR, size_t _WIDE_ALIGNMENT = 64, typename... _ARGS>
+    void runAllocator(const char* name, _ARGS... args) {
+        runPatterns<_ALLOCATOR, 16, 8>(name, args...);
+        runPatterns<_ALLOCATOR, 64, 8>(name, args...);
+        runPatterns<_ALLOCATOR, 64, _WIDE_ALIGNMENT>(name, args...);
+        runPatterns<_ALLOCATOR, 256, 8>(name, args...);
+        runPatterns<_ALLOCATOR, 1024, 8>(name, args...);
+    }
+}
+
+void MicrobenchResult::PrintHeader() {
+    std::cout << "allocator\tpattern\tsize\talignment\tops\tfailed\tns/op";
+    for (uint32_t i = 0; i < PerfCounters::N_COUNTERS; ++i)
+        std::cout << "\t" << PerfCounters::Name((PerfCounters::COUNTER)i) << "/op";
+    std::cout << "\n";
+}
+
+void MicrobenchResult::Print() const {
+    std::cout << allocator << "\t" << pattern << "\t" << size << "\t" << alignment << "\t"
+        << nOps << "\t" << nFailed << "\t" << ns / nOps;
+
+    for (uint32_t i = 0; i < PerfCounters::N_COUNTERS; ++i) {
+        if (available[i])
+            std::cout << "\t" << (double)counters[i] / nOps;
+        else
+            std::cout << "\tn/a";
+    }
+
+    std::cout << std::endl;
+}
+
+void AllocatorMicrobench::Run() {
+    typedef SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT> SqlFirstFit;
+    typedef SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT> SqlBestFit;
+    typedef SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG> SqlTaggedBestFit;
+    typedef Segregator<256, Bucketizer<16, 256, 16>, TLSFAllocator<ALLOC_BUFFER_STATIC>> PoolsAndTLSF;
+
+    MicrobenchResult::PrintHeader();
+
+    runAllocator<SqlFirstFit>("SequentialList FIRST_FIT", 64 * MB);
+    runAllocator<SqlBestFit>("SequentialList BEST_FIT", 64 * MB);
+    runAllocator<SqlTaggedBestFit>("SequentialList BEST_FIT BOUNDARY_TAG", 64 * MB);
+    runAllocator<RBTreeAllocator<ALLOC_BUFFER_STATIC>>("RBTree", 64 * MB);
+    runAllocator<BTreeAllocator<ALLOC_BUFFER_STATIC>>("BTree", 64 * MB);
+    runAllocator<TLSFAllocator<ALLOC_BUFFER_STATIC>>("TLSF", 64 * MB);
+    // slots are aligned to 16 bytes at most
+    runAllocator<SlabAllocator, 16>("Slab", 256 * MB);
+    runAllocator<PoolsAndTLSF>("Segregator Bucketizer/TLSF", std::make_tuple(4 * MB), std::make_tuple(64 * MB));
+    runAllocator<SystemAllocator>("System");
+}
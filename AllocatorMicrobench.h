@@ -0,0 +1,162 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdint.h>
+#include <random>
+#include <algorithm>
+#include "Allocator.h"
+#include "PerfCounters.h"
+
+/*
+Microbenchmarks, every scenario is an instance of MicrobenchScenario<Allocator, Size, Alignment, Pattern>,
+all four are compile time constants, the allocator is called through its concrete type (no virtual dispatch, final methods inline)
+and is constructed in place for the scenario from the arguments of Run():
+
+    MicrobenchScenario<TLSFAllocator<ALLOC_BUFFER_STATIC>, 64, 8, BENCH_PATTERN_RANDOM>::Run("TLSF", 64 * MB).Print();
+
+A scenario runs one untimed warm up round and N_ROUNDS measured rounds of N_BLOCKS allocations and frees,
+wall time and the PerfCounters of the thread are taken around the measured rounds,
+so the counters say why a scenario is slow (cache & TLB misses, mispredicted branches, page faults) rather than only how slow.
+AllocatorMicrobench::Run() is the scenario list, build with ALLOC_MICROBENCH defined to run it instead of the benchmarks in main().
+*/
+
+// alloc & free right away, the hot path of the allocator
+struct BENCH_PATTERN_ALLOC_FREE { static constexpr const char* NAME = "ALLOC_FREE"; };
+// N_BLOCKS allocs, freed in reverse
+struct BENCH_PATTERN_LIFO { static constexpr const char* NAME = "LIFO"; };
+// N_BLOCKS allocs, freed in allocation order
+struct BENCH_PATTERN_FIFO { static constexpr const char* NAME = "FIFO"; };
+// N_BLOCKS allocs, freed in a shuffled order (same seed for every scenario)
+struct BENCH_PATTERN_RANDOM { static constexpr const char* NAME = "RANDOM"; };
+
+struct MicrobenchResult {
+    const char* allocator;
+    const char* pattern;
+    size_t size;
+    size_t alignment;
+    // allocs + frees of the measured rounds
+    uint64_t nOps;
+    uint64_t nFailed;
+    double ns;
+    uint64_t counters[PerfCounters::N_COUNTERS];
+    bool available[PerfCounters::N_COUNTERS];
+
+    // tab separated, per operation values, n/a for the counters that aren't available
+    static void PrintHeader();
+    void Print() const;
+};
+
+template <typename _ALLOCATOR, size_t _SIZE, size_t _ALIGNMENT, typename _PATTERN>
+class MicrobenchScenario {
+public:
+    template <typename... _ARGS>
+    static MicrobenchResult Run(const char* name, _ARGS... args);
+
+    static constexpr uint32_t N_BLOCKS = 4096;
+    static constexpr uint32_t N_ROUNDS = 16;
+
+private:
+    static_assert((_ALIGNMENT & (_ALIGNMENT - 1)) == 0, "ALIGNMENT MUST BE A POWER OF TWO");
+
+    static inline void _round(_ALLOCATOR& allocator, void** ptrs, const uint32_t* order, uint64_t& nFailed);
+};
+
+class AllocatorMicrobench {
+public:
+    // every scenario, one row each
+    static void Run();
+};
+
+template <typename _ALLOCATOR, size_t _SIZE, size_t _ALIGNMENT, typename _PATTERN>
+template <typename... _ARGS>
+MicrobenchResult MicrobenchScenario<_ALLOCATOR, _SIZE, _ALIGNMENT, _PATTERN>::Run(const char* name, _ARGS... args) {
+    __int64 startTime = 0, endTime = 0, QPCfreq = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+
+    _ALLOCATOR allocator(args...);
+    void** ptrs = new void*[N_BLOCKS];
+    uint32_t* order = new uint32_t[N_BLOCKS];
+
+    for (uint32_t i = 0; i < N_BLOCKS; ++i)
+        order[i] = i;
+
+    if constexpr(std::is_same<_PATTERN, BENCH_PATTERN_RANDOM>::value) {
+        std::mt19937 g(N_BLOCKS);
+        std::shuffle(order, order + N_BLOCKS, g);
+    }
+
+    MicrobenchResult result;
+    result.allocator = name;
+    result.pattern = _PATTERN::NAME;
+    result.size = _SIZE;
+    result.alignment = _ALIGNMENT;
+    result.nOps = (uint64_t)N_ROUNDS * N_BLOCKS * 2;
+    result.nFailed = 0;
+
+    // commits the pages & warms the caches the way the measured rounds find them
+    _round(allocator, ptrs, order, result.nFailed);
+    result.nFailed = 0;
+
+    PerfCounters counters;
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+    counters.Start();
+
+    for (uint32_t r = 0; r < N_ROUNDS; ++r)
+        _round(allocator, ptrs, order, result.nFailed);
+
+    counters.Stop();
+    QueryPerformanceCounter((LARGE_INTEGER*)&endTime);
+
+    result.ns = (double)(endTime - startTime) * 1000000000.0 / QPCfreq;
+    for (uint32_t i = 0; i < PerfCounters::N_COUNTERS; ++i) {
+        result.counters[i] = counters.Value((PerfCounters::COUNTER)i);
+        result.available[i] = counters.Available((PerfCounters::COUNTER)i);
+    }
+
+    delete[] ptrs;
+    delete[] order;
+
+    return result;
+}
+
+template <typename _ALLOCATOR, size_t _SIZE, size_t _ALIGNMENT, typename _PATTERN>
+void MicrobenchScenario<_ALLOCATOR, _SIZE, _ALIGNMENT, _PATTERN>::_round(_ALLOCATOR& allocator, void** ptrs, const uint32_t* order, uint64_t& nFailed) {
+    if constexpr(std::is_same<_PATTERN, BENCH_PATTERN_ALLOC_FREE>::value) {
+        for (uint32_t i = 0; i < N_BLOCKS; ++i) {
+            void* p = allocator.Alloc(_SIZE, _ALIGNMENT);
+            if (!p) {
+                ++nFailed;
+                continue;
+            }
+            allocator.Free(p);
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < N_BLOCKS; ++i) {
+        ptrs[i] = allocator.Alloc(_SIZE, _ALIGNMENT);
+        if (!ptrs[i])
+            ++nFailed;
+    }
+
+    if constexpr(std::is_same<_PATTERN, BENCH_PATTERN_LIFO>::value) {
+        for (uint32_t i = N_BLOCKS; i-- > 0; ) {
+            if (ptrs[i])
+                allocator.Free(ptrs[i]);
+        }
+    }
+    else if constexpr(std::is_same<_PATTERN, BENCH_PATTERN_FIFO>::value) {
+        for (uint32_t i = 0; i < N_BLOCKS; ++i) {
+            if (ptrs[i])
+                allocator.Free(ptrs[i]);
+        }
+    }
+    else if constexpr(std::is_same<_PATTERN, BENCH_PATTERN_RANDOM>::value) {
+        for (uint32_t i = 0; i < N_BLOCKS; ++i) {
+            if (ptrs[order[i]])
+                allocator.Free(ptrs[order[i]]);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#include "AllocatorPageMap.h"
+#include "Allocator.h"
+#include <assert.h>
+
+std::atomic<AllocatorPageMap::Entry*> AllocatorPageMap::s_root[AllocatorPageMap::ROOT_SIZE];
+SRWLOCK AllocatorPageMap::s_lock = SRWLOCK_INIT;
+
+// leaf of the granule, committed on first use, under s_lock
+AllocatorPageMap::Entry* AllocatorPageMap::_leaf(uintptr_t granule) {
+    std::atomic<Entry*>& slot = s_root[granule >> LEAF_BITS];
+
+    Entry* leaf = slot.load(std::memory_order_relaxed);
+    if (!leaf) {
+        // zeroed pages, every entry starts without an owner
+        leaf = (Entry*)VirtualAlloc(NULL, LEAF_SIZE * sizeof(Entry), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        assert(leaf && "ERR VIRTUALALLOC");
+        slot.store(leaf, std::memory_order_release);
+    }
+
+    return leaf;
+}
+
+void AllocatorPageMap::Register(const void* start, size_t sz, Allocator* owner, uint32_t sizeClass) {
+    if (!sz)
+        return;
+
+    uintptr_t first = (uintptr_t)start >> GRANULE_SHIFT;
+    uintptr_t last = ((uintptr_t)start + sz - 1) >> GRANULE_SHIFT;
+    assert(!(last >> (ROOT_BITS + LEAF_BITS)) && "ADDRESS OUTSIDE THE USER ADDRESS SPACE");
+
+    AcquireSRWLockExclusive(&s_lock);
+    for (uintptr_t granule = first; granule <= last; ++granule) {
+        Entry& entry = _leaf(granule)[granule & (LEAF_SIZE - 1)];
+        entry.owner = owner;
+        entry.sizeClass = sizeClass;
+    }
+    ReleaseSRWLockExclusive(&s_lock);
+}
+
+void AllocatorPageMap::Unregister(const void* start, size_t sz) {
+    if (!sz)
+        return;
+
+    uintptr_t first = (uintptr_t)start >> GRANULE_SHIFT;
+    uintptr_t last = ((uintptr_t)start + sz - 1) >> GRANULE_SHIFT;
+
+    AcquireSRWLockExclusive(&s_lock);
+    for (uintptr_t granule = first; granule <= last; ++granule) {
+        // nothing was ever registered under a missing leaf
+        Entry* leaf = s_root[granule >> LEAF_BITS].load(std::memory_order_relaxed);
+        if (!leaf) {
+            granule |= LEAF_SIZE - 1;
+            continue;
+        }
+
+        leaf[granule & (LEAF_SIZE - 1)].owner = NULL;
+        leaf[granule & (LEAF_SIZE - 1)].sizeClass = 0;
+    }
+    ReleaseSRWLockExclusive(&s_lock);
+}
+
+void AllocatorPageMap::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    Allocator* owner = Owner(ptr);
+    assert(owner && "PTR ISN'T IN ANY REGISTERED ALLOCATOR");
+    owner->Free(ptr);
+}
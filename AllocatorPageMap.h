@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <stdint.h>
+
+class Allocator;
+
+/*
+Process wide address -> allocator map, a two level radix tree over the 47 bits of the user address space.
+
+The unit is a 64KB granule (the Windows allocation granularity, every VirtualAlloc reservation starts on one,
+so two VM backed allocators never share a granule). The top 16 bits of the granule number index a static root,
+the low 15 bits a leaf of 32K entries (2GB of address space) that is committed the first time it's written.
+A lookup is two dependent loads, no lock, no header read and no search whatever the number of allocators.
+
+Every entry holds the owning allocator and a size class, 0 unless the allocator has one per range
+(Bucketizer: slot size, ThreadHeapAllocator: heap index + 1).
+
+Allocators fill it in with RegisterPages() and clear it with UnregisterPages() (call it before destroying them),
+after that AllocatorPageMap::Free(ptr) sends any pointer back to its allocator.
+Ranges that aren't granule aligned (malloc'ed buffers) may share their first and last granule with another range,
+the one registered last owns it, keep them aligned when several allocators are registered.
+*/
+
+class AllocatorPageMap {
+public:
+    struct Entry {
+        Allocator* owner;
+        uint32_t sizeClass;
+    };
+
+    // maps [start, start + sz) to owner, overwriting any earlier owner
+    static void Register(const void* start, size_t sz, Allocator* owner, uint32_t sizeClass = 0);
+    static void Unregister(const void* start, size_t sz);
+
+    // NULL when no allocator registered the address
+    static inline Allocator* Owner(const void* ptr, uint32_t* sizeClass = NULL);
+
+    // frees ptr into its owner
+    static void Free(void*& ptr);
+
+    static constexpr uint32_t GRANULE_SHIFT = 16;
+    static constexpr uint32_t LEAF_BITS = 15;
+    static constexpr uint32_t ROOT_BITS = 47 - GRANULE_SHIFT - LEAF_BITS;
+
+private:
+    static constexpr size_t LEAF_SIZE = (size_t)1 << LEAF_BITS;
+    static constexpr size_t ROOT_SIZE = (size_t)1 << ROOT_BITS;
+
+    static Entry* _leaf(uintptr_t granule);
+
+    static std::atomic<Entry*> s_root[ROOT_SIZE];
+    // serializes Register & Unregister, lookups don't take it
+    static SRWLOCK s_lock;
+};
+
+Allocator* AllocatorPageMap::Owner(const void* ptr, uint32_t* sizeClass) {
+    uintptr_t granule = (uintptr_t)ptr >> GRANULE_SHIFT;
+    if (granule >> (ROOT_BITS + LEAF_BITS))
+        return NULL;
+
+    Entry* leaf = s_root[granule >> LEAF_BITS].load(std::memory_order_acquire);
+    if (!leaf)
+        return NULL;
+
+    Entry& entry = leaf[granule & (LEAF_SIZE - 1)];
+    if (sizeClass)
+        *sizeClass = entry.sizeClass;
+    return entry.owner;
+}
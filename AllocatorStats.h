@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+Statistics policy, picked at compile time for every allocator:
+ALLOC_STATS_NONE compiles the hooks to empty inline functions of an empty base (no code, no space),
+ALLOC_STATS_COUNTERS keeps the counters below.
+Define ALLOC_STATS in the build to switch all allocators to ALLOC_STATS_COUNTERS.
+
+Counters have a single writer (the allocator isn't thread-safe itself) and are read with GetStats() from anywhere,
+so they are relaxed atomics updated with a plain load & store, no locked read-modify-write on the hot path.
+
+Bytes are block sizes as the allocator sees them (the usable size including alignment slack),
+the histogram counts allocations by the power of two of the requested size.
+*/
+
+struct ALLOC_STATS_NONE {};
+struct ALLOC_STATS_COUNTERS {};
+
+#ifdef ALLOC_STATS
+typedef ALLOC_STATS_COUNTERS ALLOC_STATS_POLICY;
+#else
+typedef ALLOC_STATS_NONE ALLOC_STATS_POLICY;
+#endif
+
+// snapshot returned by Allocator::GetStats()
+struct AllocatorStats {
+    static constexpr uint32_t N_HISTOGRAM_BUCKETS = 32;
+
+    uint64_t nAllocs;
+    uint64_t nFrees;
+    uint64_t nFailed;
+    uint64_t bytesLive;
+    uint64_t bytesPeak;
+    // sizeHistogram[i]: allocations with requested size in [2^i, 2^(i+1)), the last bucket takes the rest
+    uint64_t sizeHistogram[N_HISTOGRAM_BUCKETS];
+
+    // adds up the stats of sub-allocators, the peak is the sum of their peaks
+    inline void Accumulate(const AllocatorStats& other) {
+        nAllocs += other.nAllocs;
+        nFrees += other.nFrees;
+        nFailed += other.nFailed;
+        bytesLive += other.bytesLive;
+        bytesPeak += other.bytesPeak;
+        for (uint32_t i = 0; i < N_HISTOGRAM_BUCKETS; ++i)
+            sizeHistogram[i] += other.sizeHistogram[i];
+    }
+};
+
+template <typename _ALLOC_STATS>
+class AllocatorStatsCounters;
+
+template <>
+class AllocatorStatsCounters<ALLOC_STATS_NONE> {
+protected:
+    inline void _statsAlloc(size_t sz, size_t blockSize) {}
+    inline void _statsFree(size_t blockSize) {}
+    inline void _statsFail(size_t sz) {}
+    inline void _statsReset() {}
+
+    inline AllocatorStats _statsSnapshot() {
+        AllocatorStats stats;
+        memset(&stats, 0, sizeof(stats));
+        return stats;
+    }
+};
+
+template <>
+class AllocatorStatsCounters<ALLOC_STATS_COUNTERS> {
+protected:
+    AllocatorStatsCounters() : m_nAllocs(0), m_nFrees(0), m_nFailed(0), m_bytesLive(0), m_bytesPeak(0) {
+        for (uint32_t i = 0; i < AllocatorStats::N_HISTOGRAM_BUCKETS; ++i)
+            m_sizeHistogram[i].store(0, std::memory_order_relaxed);
+    }
+
+    inline void _statsAlloc(size_t sz, size_t blockSize) {
+        _add(m_nAllocs, 1);
+        _add(m_sizeHistogram[_bucket(sz)], 1);
+
+        uint64_t live = m_bytesLive.load(std::memory_order_relaxed) + blockSize;
+        m_bytesLive.store(live, std::memory_order_relaxed);
+        if (live > m_bytesPeak.load(std::memory_order_relaxed))
+            m_bytesPeak.store(live, std::memory_order_relaxed);
+    }
+
+    inline void _statsFree(size_t blockSize) {
+        _add(m_nFrees, 1);
+        m_bytesLive.store(m_bytesLive.load(std::memory_order_relaxed) - blockSize, std::memory_order_relaxed);
+    }
+
+    inline void _statsFail(size_t sz) {
+        _add(m_nFailed, 1);
+    }
+
+    // every block was given back at once (Reset, Release)
+    inline void _statsReset() {
+        m_bytesLive.store(0, std::memory_order_relaxed);
+    }
+
+    inline AllocatorStats _statsSnapshot() {
+        AllocatorStats stats;
+        stats.nAllocs = m_nAllocs.load(std::memory_order_relaxed);
+        stats.nFrees = m_nFrees.load(std::memory_order_relaxed);
+        stats.nFailed = m_nFailed.load(std::memory_order_relaxed);
+        stats.bytesLive = m_bytesLive.load(std::memory_order_relaxed);
+        stats.bytesPeak = m_bytesPeak.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < AllocatorStats::N_HISTOGRAM_BUCKETS; ++i)
+            stats.sizeHistogram[i] = m_sizeHistogram[i].load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static inline void _add(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // index of the most significant set bit
+    static inline uint32_t _bucket(size_t sz) {
+        if (!sz)
+            return 0;
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, sz);
+#else
+        uint32_t index = 63 - (uint32_t)__builtin_clzll(sz);
+#endif
+        return index < AllocatorStats::N_HISTOGRAM_BUCKETS ? (uint32_t)index : AllocatorStats::N_HISTOGRAM_BUCKETS - 1;
+    }
+
+    std::atomic<uint64_t> m_nAllocs;
+    std::atomic<uint64_t> m_nFrees;
+    std::atomic<uint64_t> m_nFailed;
+    std::atomic<uint64_t> m_bytesLive;
+    std::atomic<uint64_t> m_bytesPeak;
+    std::atomic<uint64_t> m_sizeHistogram[AllocatorStats::N_HISTOGRAM_BUCKETS];
+};
@@ -0,0 +1,519 @@
+#include "AllocatorWorkload.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+namespace {
+    void defaultStream(WorkloadStream& stream, const char* name) {
+        memset(&stream, 0, sizeof(stream));
+        strncpy(stream.name, name, sizeof(stream.name) - 1);
+        stream.alignment = 8;
+        stream.size.kind = WorkloadSizeDistribution::FIXED;
+        stream.size.min = stream.size.max = 64;
+        stream.lifetime.kind = WorkloadLifetime::FRAME;
+    }
+
+    bool parseUInt(const char* token, size_t& value) {
+        if (!token)
+            return false;
+        char* end;
+        unsigned long long v = strtoull(token, &end, 10);
+        if (end == token || *end)
+            return false;
+        value = (size_t)v;
+        return true;
+    }
+
+    bool parseDouble(const char* token, double& value) {
+        if (!token)
+            return false;
+        char* end;
+        value = strtod(token, &end);
+        return end != token && !*end;
+    }
+
+    // the statement after the keyword, false on a malformed one
+    bool parseSize(WorkloadSizeDistribution& size) {
+        const char* kind = strtok(NULL, " \t\r\n");
+        if (!kind)
+            return false;
+
+        memset(&size, 0, sizeof(size));
+
+        if (!strcmp(kind, "fixed")) {
+            size.kind = WorkloadSizeDistribution::FIXED;
+            if (!parseUInt(strtok(NULL, " \t\r\n"), size.min))
+                return false;
+            size.max = size.min;
+        }
+        else if (!strcmp(kind, "uniform")) {
+            size.kind = WorkloadSizeDistribution::UNIFORM;
+            if (!parseUInt(strtok(NULL, " \t\r\n"), size.min) || !parseUInt(strtok(NULL, " \t\r\n"), size.max))
+                return false;
+        }
+        else if (!strcmp(kind, "powerlaw")) {
+            size.kind = WorkloadSizeDistribution::POWER_LAW;
+            if (!parseUInt(strtok(NULL, " \t\r\n"), size.min) || !parseUInt(strtok(NULL, " \t\r\n"), size.max) ||
+                !parseDouble(strtok(NULL, " \t\r\n"), size.param) || size.param <= 0.0)
+                return false;
+        }
+        else if (!strcmp(kind, "bimodal")) {
+            size.kind = WorkloadSizeDistribution::BIMODAL;
+            if (!parseUInt(strtok(NULL, " \t\r\n"), size.min) || !parseUInt(strtok(NULL, " \t\r\n"), size.max) ||
+                !parseDouble(strtok(NULL, " \t\r\n"), size.param) || size.param < 0.0 || size.param > 1.0)
+                return false;
+        }
+        else if (!strcmp(kind, "empirical")) {
+            size.kind = WorkloadSizeDistribution::EMPIRICAL;
+            char* bucket;
+            while ((bucket = strtok(NULL, " \t\r\n")) != NULL) {
+                char* colon = strchr(bucket, ':');
+                if (!colon || size.nBuckets == WorkloadSizeDistribution::MAX_EMPIRICAL_BUCKETS)
+                    return false;
+                *colon = '\0';
+                if (!parseUInt(bucket, size.sizes[size.nBuckets]) || !parseDouble(colon + 1, size.weights[size.nBuckets]) ||
+                    size.sizes[size.nBuckets] == 0 || size.weights[size.nBuckets] < 0.0)
+                    return false;
+                ++size.nBuckets;
+            }
+            if (!size.nBuckets)
+                return false;
+            return true;
+        }
+        else
+            return false;
+
+        return size.min > 0 && size.min <= size.max;
+    }
+
+    bool parseLifetime(WorkloadLifetime& lifetime) {
+        const char* kind = strtok(NULL, " \t\r\n");
+        if (!kind)
+            return false;
+
+        lifetime.minFrames = lifetime.maxFrames = 1;
+
+        if (!strcmp(kind, "frame"))
+            lifetime.kind = WorkloadLifetime::FRAME;
+        else if (!strcmp(kind, "frames")) {
+            size_t minFrames, maxFrames;
+            if (!parseUInt(strtok(NULL, " \t\r\n"), minFrames) || !parseUInt(strtok(NULL, " \t\r\n"), maxFrames) ||
+                minFrames == 0 || minFrames > maxFrames)
+                return false;
+            lifetime.kind = WorkloadLifetime::FRAMES;
+            lifetime.minFrames = (uint32_t)minFrames;
+            lifetime.maxFrames = (uint32_t)maxFrames;
+        }
+        else if (!strcmp(kind, "level"))
+            lifetime.kind = WorkloadLifetime::LEVEL;
+        else if (!strcmp(kind, "immortal"))
+            lifetime.kind = WorkloadLifetime::IMMORTAL;
+        else
+            return false;
+
+        return true;
+    }
+}
+
+/* WorkloadSpec */
+
+bool WorkloadSpec::Load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        std::cout << "workload spec " << path << ": can't open\n";
+        return false;
+    }
+
+    nFrames = 1;
+    framesPerLevel = 1;
+    seed = 1;
+    nStreams = 0;
+
+    char line[1024];
+    uint32_t lineNumber = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file)) {
+        ++lineNumber;
+
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+
+        const char* key = strtok(line, " \t\r\n");
+        if (!key)
+            continue;
+
+        WorkloadStream* stream = nStreams ? &streams[nStreams - 1] : NULL;
+        size_t value;
+
+        if (!strcmp(key, "frames"))
+            ok = parseUInt(strtok(NULL, " \t\r\n"), value) && value > 0 && (nFrames = (uint32_t)value);
+        else if (!strcmp(key, "level_frames"))
+            ok = parseUInt(strtok(NULL, " \t\r\n"), value) && value > 0 && (framesPerLevel = (uint32_t)value);
+        else if (!strcmp(key, "seed"))
+            ok = parseUInt(strtok(NULL, " \t\r\n"), value) && ((seed = (uint32_t)value), true);
+        else if (!strcmp(key, "stream")) {
+            const char* name = strtok(NULL, " \t\r\n");
+            ok = name && nStreams < MAX_STREAMS;
+            if (ok)
+                defaultStream(streams[nStreams++], name);
+        }
+        // the rest belongs to a stream
+        else if (!stream)
+            ok = false;
+        else if (!strcmp(key, "allocs_per_frame"))
+            ok = parseUInt(strtok(NULL, " \t\r\n"), value) && ((stream->allocsPerFrame = (uint32_t)value), true);
+        else if (!strcmp(key, "alignment"))
+            ok = parseUInt(strtok(NULL, " \t\r\n"), value) && value && !(value & (value - 1)) && (stream->alignment = value);
+        else if (!strcmp(key, "size"))
+            ok = parseSize(stream->size);
+        else if (!strcmp(key, "lifetime"))
+            ok = parseLifetime(stream->lifetime);
+        else if (!strcmp(key, "reset_per_frame"))
+            ok = parseUInt(strtok(NULL, " \t\r\n"), value) && value <= 1 && ((stream->resetPerFrame = value == 1), true);
+        else
+            ok = false;
+    }
+
+    fclose(file);
+
+    if (!ok) {
+        std::cout << "workload spec " << path << ":" << lineNumber << ": can't parse\n";
+        return false;
+    }
+
+    for (uint32_t i = 0; i < nStreams; ++i) {
+        // the blocks have to be dead by the time of the reset
+        if (streams[i].resetPerFrame && streams[i].lifetime.kind != WorkloadLifetime::FRAME) {
+            std::cout << "workload spec " << path << ": stream " << streams[i].name << " is reset per frame, its lifetime has to be frame\n";
+            return false;
+        }
+    }
+
+    if (!nStreams) {
+        std::cout << "workload spec " << path << ": no streams\n";
+        return false;
+    }
+
+    return true;
+}
+
+WorkloadSpec WorkloadSpec::RendererFrame() {
+    WorkloadSpec spec;
+    spec.nFrames = 300;
+    spec.framesPerLevel = 100;
+    spec.seed = 1;
+    spec.nStreams = 4;
+
+    // command lists, constants, transient vertex data, reset every frame
+    WorkloadStream& scratch = spec.streams[0];
+    defaultStream(scratch, "scratch");
+    scratch.allocsPerFrame = 2000;
+    scratch.alignment = 16;
+    scratch.size.kind = WorkloadSizeDistribution::POWER_LAW;
+    scratch.size.min = 16;
+    scratch.size.max = 16 * KB;
+    scratch.size.param = 1.5;
+    scratch.resetPerFrame = true;
+
+    // entities, particles, render nodes, a few fixed sizes living a few frames
+    WorkloadStream& objects = spec.streams[1];
+    defaultStream(objects, "objects");
+    objects.allocsPerFrame = 500;
+    objects.size.kind = WorkloadSizeDistribution::EMPIRICAL;
+    objects.size.nBuckets = 5;
+    const size_t objectSizes[] = { 32, 48, 64, 128, 256 };
+    const double objectWeights[] = { 30, 25, 25, 15, 5 };
+    for (uint32_t i = 0; i < objects.size.nBuckets; ++i) {
+        objects.size.sizes[i] = objectSizes[i];
+        objects.size.weights[i] = objectWeights[i];
+    }
+    objects.lifetime.kind = WorkloadLifetime::FRAMES;
+    objects.lifetime.minFrames = 1;
+    objects.lifetime.maxFrames = 30;
+
+    // streamed textures & meshes, small descriptors and large payloads, for the level
+    WorkloadStream& assets = spec.streams[2];
+    defaultStream(assets, "assets");
+    assets.allocsPerFrame = 4;
+    assets.alignment = 64;
+    assets.size.kind = WorkloadSizeDistribution::BIMODAL;
+    assets.size.min = 256;
+    assets.size.max = 256 * KB;
+    assets.size.param = 0.75;
+    assets.lifetime.kind = WorkloadLifetime::LEVEL;
+
+    // engine systems & caches, never freed
+    WorkloadStream& systems = spec.streams[3];
+    defaultStream(systems, "systems");
+    systems.allocsPerFrame = 1;
+    systems.size.kind = WorkloadSizeDistribution::POWER_LAW;
+    systems.size.min = 64;
+    systems.size.max = 64 * KB;
+    systems.size.param = 1.2;
+    systems.lifetime.kind = WorkloadLifetime::IMMORTAL;
+
+    return spec;
+}
+
+/* WorkloadTrace */
+
+WorkloadTrace::WorkloadTrace(const WorkloadSpec& spec) : m_spec(spec), m_events(NULL), m_nEvents(0), m_nSlots(0) {
+    uint32_t allocsPerFrame = 0;
+    for (uint32_t i = 0; i < spec.nStreams; ++i)
+        allocsPerFrame += spec.streams[i].allocsPerFrame;
+
+    size_t nAllocs = (size_t)allocsPerFrame * spec.nFrames;
+    m_events = new Event[nAllocs * 2 + spec.nFrames];
+
+    // a slot is freed at the end of its due frame, linked per frame, immortal blocks are due at nFrames
+    uint32_t* dueHead = new uint32_t[spec.nFrames + 1];
+    uint32_t* dueNext = new uint32_t[nAllocs ? nAllocs : 1];
+    uint32_t* slotSize = new uint32_t[nAllocs ? nAllocs : 1];
+    uint8_t* slotStream = new uint8_t[nAllocs ? nAllocs : 1];
+    uint32_t* freeSlots = new uint32_t[nAllocs ? nAllocs : 1];
+    uint32_t nFreeSlots = 0;
+    uint8_t* order = new uint8_t[allocsPerFrame ? allocsPerFrame : 1];
+    uint32_t* dying = new uint32_t[nAllocs ? nAllocs : 1];
+
+    for (uint32_t f = 0; f <= spec.nFrames; ++f)
+        dueHead[f] = NIL;
+
+    std::mt19937 g(spec.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    for (uint32_t f = 0; f < spec.nFrames; ++f) {
+        // the streams allocate interleaved
+        uint32_t n = 0;
+        for (uint32_t s = 0; s < spec.nStreams; ++s) {
+            for (uint32_t i = 0; i < spec.streams[s].allocsPerFrame; ++i)
+                order[n++] = (uint8_t)s;
+        }
+        std::shuffle(order, order + n, g);
+
+        for (uint32_t i = 0; i < n; ++i) {
+            const WorkloadStream& stream = spec.streams[order[i]];
+            uint32_t slot = nFreeSlots ? freeSlots[--nFreeSlots] : m_nSlots++;
+
+            double u = unit(g);
+            double v = unit(g);
+            slotSize[slot] = (uint32_t)_sampleSize(stream.size, u, v);
+            slotStream[slot] = order[i];
+
+            uint32_t due;
+            switch (stream.lifetime.kind) {
+            case WorkloadLifetime::FRAME:
+                due = f;
+                break;
+            case WorkloadLifetime::FRAMES:
+                due = f + std::uniform_int_distribution<uint32_t>(stream.lifetime.minFrames, stream.lifetime.maxFrames)(g) - 1;
+                break;
+            case WorkloadLifetime::LEVEL:
+                due = (f / spec.framesPerLevel + 1) * spec.framesPerLevel - 1;
+                break;
+            default:
+                due = spec.nFrames;
+                break;
+            }
+            if (due > spec.nFrames)
+                due = spec.nFrames;
+
+            dueNext[slot] = dueHead[due];
+            dueHead[due] = slot;
+
+            Event& e = m_events[m_nEvents++];
+            e.type = Event::ALLOC;
+            e.stream = order[i];
+            e.slot = slot;
+            e.size = slotSize[slot];
+        }
+
+        // then what dies this frame, in no particular order, the last round is the teardown of the immortal blocks
+        for (uint32_t d = f; d <= (f + 1 == spec.nFrames ? spec.nFrames : f); ++d) {
+            uint32_t nDying = 0;
+            for (uint32_t slot = dueHead[d]; slot != NIL; slot = dueNext[slot])
+                dying[nDying++] = slot;
+            std::shuffle(dying, dying + nDying, g);
+
+            for (uint32_t i = 0; i < nDying; ++i) {
+                Event& e = m_events[m_nEvents++];
+                e.type = Event::FREE;
+                e.stream = slotStream[dying[i]];
+                e.slot = dying[i];
+                e.size = slotSize[dying[i]];
+                freeSlots[nFreeSlots++] = dying[i];
+            }
+
+            if (d == f) {
+                Event& e = m_events[m_nEvents++];
+                e.type = Event::FRAME_END;
+                e.stream = 0;
+                e.slot = NIL;
+                e.size = 0;
+            }
+        }
+    }
+
+    delete[] dueHead;
+    delete[] dueNext;
+    delete[] slotSize;
+    delete[] slotStream;
+    delete[] freeSlots;
+    delete[] order;
+    delete[] dying;
+}
+
+WorkloadTrace::~WorkloadTrace() {
+    delete[] m_events;
+}
+
+size_t WorkloadTrace::_sampleSize(const WorkloadSizeDistribution& size, double u, double v) {
+    double x;
+
+    switch (size.kind) {
+    case WorkloadSizeDistribution::FIXED:
+        return size.min;
+    case WorkloadSizeDistribution::UNIFORM:
+        return size.min + (size_t)(u * (size.max - size.min + 1)) % (size.max - size.min + 1);
+    case WorkloadSizeDistribution::POWER_LAW: {
+        // inverse CDF of the Pareto distribution bounded to [min, max], log uniform for alpha 1
+        double a = size.param;
+        double lo = (double)size.min;
+        double hi = (double)size.max;
+        if (fabs(a - 1.0) < 1e-9)
+            x = lo * pow(hi / lo, u);
+        else
+            x = pow(pow(lo, 1.0 - a) + u * (pow(hi, 1.0 - a) - pow(lo, 1.0 - a)), 1.0 / (1.0 - a));
+        break;
+    }
+    case WorkloadSizeDistribution::BIMODAL:
+        // each mode spread by +-25% so the sizes don't all fall into one class
+        x = (u < size.param ? (double)size.min : (double)size.max) * (0.75 + 0.5 * v);
+        break;
+    default: {
+        double total = 0.0;
+        for (uint32_t i = 0; i < size.nBuckets; ++i)
+            total += size.weights[i];
+
+        double w = u * total;
+        for (uint32_t i = 0; i < size.nBuckets; ++i) {
+            if (w < size.weights[i])
+                return size.sizes[i];
+            w -= size.weights[i];
+        }
+        return size.sizes[size.nBuckets - 1];
+    }
+    }
+
+    size_t sz = (size_t)x;
+    if (sz < size.min)
+        sz = size.min;
+    if (sz > size.max && size.kind == WorkloadSizeDistribution::POWER_LAW)
+        sz = size.max;
+    // real sizes are mostly multiples of 8
+    return (sz + 7) & ~(size_t)7;
+}
+
+void WorkloadTrace::Replay(const char* name, Allocator** allocators) {
+    __int64 startTime = 0, frameStart = 0, now = 0, QPCfreq = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+
+    // a stream's allocator is reset at the end of the frame only when it serves that stream alone
+    bool reset[WorkloadSpec::MAX_STREAMS];
+    for (uint32_t s = 0; s < m_spec.nStreams; ++s) {
+        reset[s] = m_spec.streams[s].resetPerFrame;
+        for (uint32_t t = 0; t < m_spec.nStreams; ++t) {
+            if (t != s && allocators[t] == allocators[s])
+                reset[s] = false;
+        }
+    }
+
+    void** ptrs = new void*[m_nSlots ? m_nSlots : 1];
+    uint64_t nAllocs[WorkloadSpec::MAX_STREAMS] = {};
+    uint64_t nFailed[WorkloadSpec::MAX_STREAMS] = {};
+    uint64_t liveBytes[WorkloadSpec::MAX_STREAMS] = {};
+    uint64_t peakBytes[WorkloadSpec::MAX_STREAMS] = {};
+    uint64_t totalLive = 0, totalPeak = 0;
+    double worstFrameMs = 0.0;
+    uint32_t nFrames = 0;
+
+    HeapReport report;
+    bool reported = false;
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+    frameStart = startTime;
+
+    for (size_t i = 0; i < m_nEvents; ++i) {
+        const Event& e = m_events[i];
+
+        if (e.type == Event::ALLOC) {
+            ptrs[e.slot] = allocators[e.stream]->Alloc(e.size, m_spec.streams[e.stream].alignment);
+            ++nAllocs[e.stream];
+            if (!ptrs[e.slot]) {
+                ++nFailed[e.stream];
+                continue;
+            }
+            liveBytes[e.stream] += e.size;
+            if (liveBytes[e.stream] > peakBytes[e.stream])
+                peakBytes[e.stream] = liveBytes[e.stream];
+            totalLive += e.size;
+            if (totalLive > totalPeak)
+                totalPeak = totalLive;
+        }
+        else if (e.type == Event::FREE) {
+            if (!ptrs[e.slot])
+                continue;
+            if (!reset[e.stream])
+                allocators[e.stream]->Free(ptrs[e.slot]);
+            liveBytes[e.stream] -= e.size;
+            totalLive -= e.size;
+        }
+        else {
+            for (uint32_t s = 0; s < m_spec.nStreams; ++s) {
+                if (reset[s])
+                    allocators[s]->Reset();
+            }
+
+            QueryPerformanceCounter((LARGE_INTEGER*)&now);
+            double frameMs = (double)(now - frameStart) * 1000.0 / QPCfreq;
+            if (frameMs > worstFrameMs)
+                worstFrameMs = frameMs;
+            ++nFrames;
+
+            // the heaps as the last frame leaves them, before the teardown of the immortal blocks (untimed)
+            if (nFrames == m_spec.nFrames) {
+                for (uint32_t s = 0; s < m_spec.nStreams; ++s) {
+                    bool seen = false;
+                    for (uint32_t t = 0; t < s; ++t)
+                        seen |= allocators[t] == allocators[s];
+                    if (!seen && !reset[s])
+                        report.Merge(allocators[s]->Report());
+                }
+                reported = true;
+            }
+
+            QueryPerformanceCounter((LARGE_INTEGER*)&frameStart);
+        }
+    }
+
+    double totalMs = (double)(frameStart - startTime) * 1000.0 / QPCfreq;
+
+    std::cout << name << ": " << nFrames << " frames, " << totalMs / (nFrames ? nFrames : 1) << " ms/frame avg, "
+        << worstFrameMs << " ms worst, peak live " << totalPeak << " bytes\n";
+    for (uint32_t s = 0; s < m_spec.nStreams; ++s) {
+        std::cout << "    " << m_spec.streams[s].name << ": " << nAllocs[s] << " allocs, " << nFailed[s] << " failed, peak live "
+            << peakBytes[s] << " bytes" << (reset[s] ? ", reset per frame" : "") << "\n";
+    }
+    if (reported && report.nUsedBlocks + report.nFreeBlocks) {
+        std::cout << "    heap after the last frame: " << report.bytesUsed << " bytes used, " << report.bytesFree << " free, largest free "
+            << report.largestFree << ", fragmentation index " << report.FragmentationIndex() << "\n";
+    }
+    std::cout << std::endl;
+
+    delete[] ptrs;
+}
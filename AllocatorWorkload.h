@@ -0,0 +1,130 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdint.h>
+#include "Allocator.h"
+
+/*
+Workloads shaped like an application rather than a size table: a WorkloadSpec (loaded from a spec file or built in)
+is a set of streams, each allocating allocsPerFrame blocks every frame with its own size distribution, alignment and lifetime.
+WorkloadTrace generates the whole run from the spec up front (deterministic for a seed, so every allocator replays the same trace),
+Replay() runs it against one allocator per stream, timing every frame.
+
+Spec file, one statement per line, # starts a comment:
+
+    frames 300              number of frames
+    level_frames 100        a level lasts that many frames
+    seed 1
+
+    stream scratch          starts a stream, the statements below belong to it
+    allocs_per_frame 2000
+    alignment 16
+    size uniform 16 512     fixed S | uniform MIN MAX | powerlaw MIN MAX ALPHA | bimodal SMALL LARGE P_SMALL | empirical S:W S:W ...
+    lifetime frame          frame | frames MIN MAX | level | immortal
+    reset_per_frame 1       Reset() the stream's allocator at the end of every frame instead of freeing (lifetime frame only)
+
+Blocks are freed at the end of the frame their lifetime runs out in, in a random order, immortal blocks after the last frame.
+*/
+
+struct WorkloadSizeDistribution {
+    enum KIND {
+        FIXED,
+        UNIFORM,
+        // bounded Pareto, P(size) ~ size^-alpha
+        POWER_LAW,
+        BIMODAL,
+        // sizes & their weights, e.g. a histogram taken from a real run
+        EMPIRICAL
+    };
+
+    static constexpr uint32_t MAX_EMPIRICAL_BUCKETS = 32;
+
+    KIND kind;
+    // FIXED: min, UNIFORM & POWER_LAW: the bounds, BIMODAL: the two sizes
+    size_t min;
+    size_t max;
+    // POWER_LAW: alpha, BIMODAL: probability of the small size
+    double param;
+    uint32_t nBuckets;
+    size_t sizes[MAX_EMPIRICAL_BUCKETS];
+    double weights[MAX_EMPIRICAL_BUCKETS];
+};
+
+struct WorkloadLifetime {
+    enum KIND {
+        // freed at the end of the frame
+        FRAME,
+        // lives minFrames to maxFrames frames
+        FRAMES,
+        // freed at the end of the level
+        LEVEL,
+        // freed after the last frame
+        IMMORTAL
+    };
+
+    KIND kind;
+    uint32_t minFrames;
+    uint32_t maxFrames;
+};
+
+struct WorkloadStream {
+    char name[32];
+    uint32_t allocsPerFrame;
+    size_t alignment;
+    WorkloadSizeDistribution size;
+    WorkloadLifetime lifetime;
+    // the allocator of the stream is Reset() at the end of every frame (linear scratch),
+    // only when it serves no other stream, blocks are freed one by one otherwise
+    bool resetPerFrame;
+};
+
+struct WorkloadSpec {
+    static constexpr uint32_t MAX_STREAMS = 8;
+
+    uint32_t nFrames;
+    uint32_t framesPerLevel;
+    uint32_t seed;
+    uint32_t nStreams;
+    WorkloadStream streams[MAX_STREAMS];
+
+    // false and the offending line on std::cout if the file can't be read or parsed
+    bool Load(const char* path);
+
+    // scratch memory reset every frame, pooled objects living a few frames, large assets living a level & a few immortal ones
+    static WorkloadSpec RendererFrame();
+};
+
+class WorkloadTrace {
+public:
+    WorkloadTrace(const WorkloadSpec& spec);
+    ~WorkloadTrace();
+
+    // allocators[i] serves stream i, an allocator may serve several streams
+    void Replay(const char* name, Allocator** allocators);
+
+private:
+    struct Event {
+        enum TYPE : uint8_t {
+            ALLOC,
+            FREE,
+            FRAME_END
+        };
+
+        TYPE type;
+        uint8_t stream;
+        uint32_t slot;
+        uint32_t size;
+    };
+
+    size_t _sampleSize(const WorkloadSizeDistribution& size, double u, double v);
+
+    WorkloadSpec m_spec;
+
+    Event* m_events;
+    size_t m_nEvents;
+    // blocks live at the same time at most, a block keeps its slot from alloc to free
+    uint32_t m_nSlots;
+
+    static constexpr uint32_t NIL = UINT32_MAX;
+};
@@ -0,0 +1,778 @@
+#include "BTreeAllocator.h"
+
+template <typename _ALLOC_BUFFER>
+BTreeAllocator<_ALLOC_BUFFER>::BTreeAllocator(size_t sz) :
+    m_size(sz), m_start(NULL), m_end(NULL), m_initialized(false),
+    m_nodes(NULL), m_metaAllocator(NULL),
+    m_vmAllocator(NULL), m_nVMPages(0)
+{
+    m_metaAllocator = new VMLinearAllocator(RESERVE_METADATA_SPACE);
+    m_nodes = (Node*)m_metaAllocator->Alloc(1);
+    m_nCommittedNodes = (uint32_t)(m_metaAllocator->PageSize() / sizeof(Node));
+
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
+        m_size &= ~TAG_MASK;
+        m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        m_initialized = true;
+        build();
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        m_vmAllocator = new VMLinearAllocator(RESERVE_VIRTUAL_ADDRESS_SPACE);
+
+        uint32_t vmPageSize = m_vmAllocator->PageSize();
+        uint32_t n = (uint32_t)ceil((double)sz / vmPageSize);
+        size_t vmAllocSize = (size_t)n * vmPageSize;
+
+        m_start = m_vmAllocator->Alloc(n);
+        m_end = (void*)((uintptr_t)m_start + vmAllocSize);
+        m_size = vmAllocSize;
+        m_nVMPages = n;
+        m_initialized = true;
+        build();
+    }
+    else {
+        assert(false && "BUFFER WASN'T PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
+}
+
+template <typename _ALLOC_BUFFER>
+BTreeAllocator<_ALLOC_BUFFER>::BTreeAllocator(void* buffer, size_t sz) :
+    m_size(sz), m_start(NULL), m_end(NULL), m_initialized(true),
+    m_nodes(NULL), m_metaAllocator(NULL),
+    m_vmAllocator(NULL), m_nVMPages(0)
+{
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+        m_metaAllocator = new VMLinearAllocator(RESERVE_METADATA_SPACE);
+        m_nodes = (Node*)m_metaAllocator->Alloc(1);
+        m_nCommittedNodes = (uint32_t)(m_metaAllocator->PageSize() / sizeof(Node));
+
+        assert(((uintptr_t)buffer & TAG_MASK) == 0);
+        m_size &= ~TAG_MASK;
+        m_start = buffer;
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        build();
+    }
+    else {
+        assert(false && "BUFFER PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
+}
+
+template <typename _ALLOC_BUFFER>
+BTreeAllocator<_ALLOC_BUFFER>::~BTreeAllocator() {
+    if (m_initialized)
+        Release();
+    if (m_vmAllocator)
+        delete m_vmAllocator;
+    if (m_metaAllocator)
+        delete m_metaAllocator;
+}
+
+/*
+* The last word of the arena is an epilogue tag of size 0 that is never free,
+* so merging with the right neighbour never runs past m_end.
+*/
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::build() {
+    assert(m_size >= minBlockSize + tagSize && m_size < MAX_ARENA_SIZE);
+
+    // committed metadata pages are kept, the nodes are handed out from the start again
+    m_nNodes = 0;
+    m_freeNodes = NIL;
+    m_nFreeBlocks = 0;
+    m_root = _newNode(true);
+
+    *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+
+    _markFree(m_start, m_size - tagSize);
+    _insertFreeBlock(m_start);
+}
+
+/* INDEX */
+
+/*
+* The compares are picked at runtime: MSVC only defines __AVX2__ under /arch:AVX2 and never __SSE4_2__,
+* and it takes the intrinsics without them, GCC & Clang compile the SIMD paths for their target with an attribute.
+*/
+#ifdef _MSC_VER
+#define BTREE_TARGET(isa)
+#else
+#define BTREE_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+enum BTREE_SIMD : uint32_t {
+    BTREE_SIMD_NONE,
+    BTREE_SIMD_SSE42,
+    BTREE_SIMD_AVX2
+};
+
+static BTREE_SIMD _simdLevel() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int nIds = info[0];
+
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    // AVX state saved by the OS (OSXSAVE, then XCR0 bits 1 & 2)
+    bool avxOS = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+
+    bool avx2 = false;
+    if (nIds >= 7 && avxOS) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse42 = __builtin_cpu_supports("sse4.2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return avx2 ? BTREE_SIMD_AVX2 : sse42 ? BTREE_SIMD_SSE42 : BTREE_SIMD_NONE;
+}
+
+static const BTREE_SIMD simdLevel = _simdLevel();
+
+template <uint32_t _NODE_KEYS>
+BTREE_TARGET("avx2,popcnt") static uint32_t _rankAVX2(const uint64_t* keys, uint64_t key) {
+    __m256i k = _mm256_set1_epi64x((int64_t)key);
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < _NODE_KEYS; i += 4) {
+        __m256i v = _mm256_load_si256((const __m256i*)(keys + i));
+        mask |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))) << i;
+    }
+    return (uint32_t)_mm_popcnt_u32(mask);
+}
+
+template <uint32_t _NODE_KEYS>
+BTREE_TARGET("sse4.2,popcnt") static uint32_t _rankSSE42(const uint64_t* keys, uint64_t key) {
+    __m128i k = _mm_set1_epi64x((int64_t)key);
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < _NODE_KEYS; i += 2) {
+        __m128i v = _mm_load_si128((const __m128i*)(keys + i));
+        mask |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))) << i;
+    }
+    return (uint32_t)_mm_popcnt_u32(mask);
+}
+
+// number of keys less than key, keys are sorted and padded with KEY_PAD
+template <typename _ALLOC_BUFFER>
+uint32_t BTreeAllocator<_ALLOC_BUFFER>::_rank(const uint64_t* keys, uint64_t key) {
+    // the same for the whole run, the branch predicts
+    if (simdLevel == BTREE_SIMD_AVX2)
+        return _rankAVX2<NODE_KEYS>(keys, key);
+    if (simdLevel == BTREE_SIMD_SSE42)
+        return _rankSSE42<NODE_KEYS>(keys, key);
+
+    // branchless, compilers vectorize it
+    uint32_t rank = 0;
+    for (uint32_t i = 0; i < NODE_KEYS; ++i)
+        rank += keys[i] < key;
+    return rank;
+}
+
+template <typename _ALLOC_BUFFER>
+typename BTreeAllocator<_ALLOC_BUFFER>::Node* BTreeAllocator<_ALLOC_BUFFER>::_node(uint32_t index) {
+    return m_nodes + index;
+}
+
+template <typename _ALLOC_BUFFER>
+uint32_t BTreeAllocator<_ALLOC_BUFFER>::_newNode(bool isLeaf) {
+    uint32_t index;
+
+    if (m_freeNodes != NIL) {
+        index = m_freeNodes;
+        m_freeNodes = _node(index)->next;
+    }
+    else {
+        if (m_nNodes == m_nCommittedNodes) {
+            // the metadata region grows a page at a time
+            void* vmAlloc = m_metaAllocator->Alloc(1);
+            assert(vmAlloc == (void*)(m_nodes + m_nCommittedNodes) && "ERR METADATA VMALLOC IS NOT CONTIGUOUS");
+            m_nCommittedNodes += (uint32_t)(m_metaAllocator->PageSize() / sizeof(Node));
+        }
+        index = m_nNodes++;
+    }
+
+    Node* node = _node(index);
+    for (uint32_t i = 0; i < NODE_KEYS; ++i)
+        node->keys[i] = KEY_PAD;
+    node->nKeys = 0;
+    node->isLeaf = isLeaf;
+    node->next = NIL;
+    node->prev = NIL;
+
+    return index;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_freeNode(uint32_t index) {
+    _node(index)->next = m_freeNodes;
+    m_freeNodes = index;
+}
+
+// child i of parent is full, split it in two and hang the right half next to it
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_splitChild(uint32_t parent, uint32_t i) {
+    uint32_t left = _node(parent)->children[i];
+    uint32_t right = _newNode(_node(left)->isLeaf);
+
+    Node* p = _node(parent);
+    Node* l = _node(left);
+    Node* r = _node(right);
+    uint64_t separator;
+
+    if (l->isLeaf) {
+        // [0, half) stays, [half, NODE_KEYS) moves, the separator is the first key on the right
+        uint32_t half = NODE_KEYS / 2;
+        for (uint32_t j = half; j < NODE_KEYS; ++j) {
+            r->keys[j - half] = l->keys[j];
+            l->keys[j] = KEY_PAD;
+        }
+        r->nKeys = NODE_KEYS - half;
+        l->nKeys = half;
+        separator = r->keys[0];
+
+        r->next = l->next;
+        r->prev = left;
+        if (l->next != NIL)
+            _node(l->next)->prev = right;
+        l->next = right;
+    }
+    else {
+        // [0, half) stays, half goes up, (half, NODE_KEYS) moves
+        uint32_t half = NODE_KEYS / 2;
+        separator = l->keys[half];
+        for (uint32_t j = half + 1; j < NODE_KEYS; ++j) {
+            r->keys[j - half - 1] = l->keys[j];
+            r->children[j - half - 1] = l->children[j];
+        }
+        r->children[NODE_KEYS - half - 1] = l->children[NODE_KEYS];
+        for (uint32_t j = half; j < NODE_KEYS; ++j)
+            l->keys[j] = KEY_PAD;
+        r->nKeys = NODE_KEYS - half - 1;
+        l->nKeys = half;
+    }
+
+    for (uint32_t j = p->nKeys; j > i; --j) {
+        p->keys[j] = p->keys[j - 1];
+        p->children[j + 1] = p->children[j];
+    }
+    p->keys[i] = separator;
+    p->children[i + 1] = right;
+    ++p->nKeys;
+}
+
+// full nodes are split on the way down, so the leaf always has room
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_insert(uint64_t key) {
+    if (_node(m_root)->nKeys == NODE_KEYS) {
+        uint32_t root = _newNode(false);
+        _node(root)->children[0] = m_root;
+        m_root = root;
+        _splitChild(root, 0);
+    }
+
+    uint32_t index = m_root;
+
+    while (!_node(index)->isLeaf) {
+        Node* node = _node(index);
+        uint32_t i = _rank(node->keys, key + 1);
+
+        if (_node(node->children[i])->nKeys == NODE_KEYS) {
+            _splitChild(index, i);
+            if (key >= node->keys[i])
+                ++i;
+        }
+
+        index = node->children[i];
+    }
+
+    Node* leaf = _node(index);
+    uint32_t pos = _rank(leaf->keys, key);
+
+    for (uint32_t j = leaf->nKeys; j > pos; --j)
+        leaf->keys[j] = leaf->keys[j - 1];
+    leaf->keys[pos] = key;
+    ++leaf->nKeys;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_erase(uint64_t key) {
+    _eraseRecursive(m_root, key);
+
+    Node* root = _node(m_root);
+    if (!root->isLeaf && root->nKeys == 0) {
+        uint32_t oldRoot = m_root;
+        m_root = root->children[0];
+        _freeNode(oldRoot);
+    }
+}
+
+// returns true if the node fell below the minimum fill, the parent fixes it
+template <typename _ALLOC_BUFFER>
+bool BTreeAllocator<_ALLOC_BUFFER>::_eraseRecursive(uint32_t index, uint64_t key) {
+    Node* node = _node(index);
+
+    if (node->isLeaf) {
+        uint32_t pos = _rank(node->keys, key);
+        assert(pos < node->nKeys && node->keys[pos] == key && "KEY ISN'T IN THE INDEX");
+
+        for (uint32_t j = pos; j < node->nKeys - 1; ++j)
+            node->keys[j] = node->keys[j + 1];
+        node->keys[--node->nKeys] = KEY_PAD;
+
+        return node->nKeys < MIN_LEAF_KEYS;
+    }
+
+    uint32_t i = _rank(node->keys, key + 1);
+    if (!_eraseRecursive(node->children[i], key))
+        return false;
+
+    _fixChild(index, i);
+    return node->nKeys < MIN_INNER_KEYS;
+}
+
+// borrow a key from a sibling that can spare one, merge with a sibling otherwise
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_fixChild(uint32_t parent, uint32_t i) {
+    Node* p = _node(parent);
+    Node* c = _node(p->children[i]);
+    uint32_t minKeys = c->isLeaf ? MIN_LEAF_KEYS : MIN_INNER_KEYS;
+
+    if (i > 0 && _node(p->children[i - 1])->nKeys > minKeys) {
+        Node* l = _node(p->children[i - 1]);
+
+        for (uint32_t j = c->nKeys; j > 0; --j)
+            c->keys[j] = c->keys[j - 1];
+
+        if (c->isLeaf) {
+            c->keys[0] = l->keys[l->nKeys - 1];
+            p->keys[i - 1] = c->keys[0];
+        }
+        else {
+            for (uint32_t j = c->nKeys + 1; j > 0; --j)
+                c->children[j] = c->children[j - 1];
+            c->keys[0] = p->keys[i - 1];
+            c->children[0] = l->children[l->nKeys];
+            p->keys[i - 1] = l->keys[l->nKeys - 1];
+        }
+
+        l->keys[--l->nKeys] = KEY_PAD;
+        ++c->nKeys;
+    }
+    else if (i < p->nKeys && _node(p->children[i + 1])->nKeys > minKeys) {
+        Node* r = _node(p->children[i + 1]);
+
+        if (c->isLeaf) {
+            c->keys[c->nKeys] = r->keys[0];
+            for (uint32_t j = 0; j < r->nKeys - 1; ++j)
+                r->keys[j] = r->keys[j + 1];
+            p->keys[i] = r->keys[0];
+        }
+        else {
+            c->keys[c->nKeys] = p->keys[i];
+            c->children[c->nKeys + 1] = r->children[0];
+            p->keys[i] = r->keys[0];
+            for (uint32_t j = 0; j < r->nKeys - 1; ++j) {
+                r->keys[j] = r->keys[j + 1];
+                r->children[j] = r->children[j + 1];
+            }
+            r->children[r->nKeys - 1] = r->children[r->nKeys];
+        }
+
+        r->keys[--r->nKeys] = KEY_PAD;
+        ++c->nKeys;
+    }
+    else if (i > 0) {
+        _mergeChildren(parent, i - 1);
+    }
+    else {
+        _mergeChildren(parent, i);
+    }
+}
+
+// fold child i + 1 into child i and drop their separator from the parent
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_mergeChildren(uint32_t parent, uint32_t i) {
+    Node* p = _node(parent);
+    uint32_t right = p->children[i + 1];
+    Node* l = _node(p->children[i]);
+    Node* r = _node(right);
+
+    if (l->isLeaf) {
+        for (uint32_t j = 0; j < r->nKeys; ++j)
+            l->keys[l->nKeys + j] = r->keys[j];
+        l->nKeys += r->nKeys;
+
+        l->next = r->next;
+        if (r->next != NIL)
+            _node(r->next)->prev = p->children[i];
+    }
+    else {
+        l->keys[l->nKeys] = p->keys[i];
+        for (uint32_t j = 0; j < r->nKeys; ++j) {
+            l->keys[l->nKeys + 1 + j] = r->keys[j];
+            l->children[l->nKeys + 1 + j] = r->children[j];
+        }
+        l->children[l->nKeys + 1 + r->nKeys] = r->children[r->nKeys];
+        l->nKeys += r->nKeys + 1;
+    }
+
+    for (uint32_t j = i; j < p->nKeys - 1; ++j) {
+        p->keys[j] = p->keys[j + 1];
+        p->children[j + 1] = p->children[j + 2];
+    }
+    p->keys[--p->nKeys] = KEY_PAD;
+
+    _freeNode(right);
+}
+
+// smallest key >= key
+template <typename _ALLOC_BUFFER>
+bool BTreeAllocator<_ALLOC_BUFFER>::_lowerBound(uint64_t key, uint64_t& found) {
+    Node* node = _node(m_root);
+
+    while (!node->isLeaf)
+        node = _node(node->children[_rank(node->keys, key + 1)]);
+
+    uint32_t pos = _rank(node->keys, key);
+
+    if (pos == node->nKeys) {
+        // the successor is the first key of the next leaf
+        if (node->next == NIL)
+            return false;
+        node = _node(node->next);
+        pos = 0;
+    }
+
+    found = node->keys[pos];
+    return true;
+}
+
+template <typename _ALLOC_BUFFER>
+uint64_t BTreeAllocator<_ALLOC_BUFFER>::_key(void* block, size_t sz) {
+    return ((uint64_t)(sz >> GRANULE_SHIFT) << 32) | (((uintptr_t)block - (uintptr_t)m_start) >> GRANULE_SHIFT);
+}
+
+template <typename _ALLOC_BUFFER>
+void* BTreeAllocator<_ALLOC_BUFFER>::_keyBlock(uint64_t key) {
+    return (void*)((uintptr_t)m_start + ((key & UINT32_MAX) << GRANULE_SHIFT));
+}
+
+/* BLOCKS */
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_insertFreeBlock(void* block) {
+    _insert(_key(block, ((FreeBlockHeader*)block)->tag & ~TAG_MASK));
+    ++m_nFreeBlocks;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_removeFreeBlock(void* block) {
+    _erase(_key(block, ((FreeBlockHeader*)block)->tag & ~TAG_MASK));
+    --m_nFreeBlocks;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_markFree(void* block, size_t sz) {
+    // a free block never has a free left neighbour, they would have been merged
+    ((FreeBlockHeader*)block)->tag = sz | TAG_FREE;
+    *(size_t*)((uintptr_t)block + sz - tagSize) = sz;
+    *(size_t*)((uintptr_t)block + sz) |= TAG_PREV_FREE;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::_fitPadding(ptrdiff_t& padding, size_t alignment) {
+    // if can't fit the tag and the header into the padding
+    if (padding < (ptrdiff_t)minPadding) {
+        if ((minPadding - padding) % alignment == 0) {
+            padding = minPadding;
+        }
+        else {
+            padding += alignment * (1 + (minPadding - padding) / alignment);
+        }
+    }
+}
+
+// block is free and already removed from the index
+template <typename _ALLOC_BUFFER>
+void* BTreeAllocator<_ALLOC_BUFFER>::_carve(void* block, size_t sz, size_t alignment) {
+    size_t blockSize = ((FreeBlockHeader*)block)->tag & ~TAG_MASK;
+
+    void* ptr = (void*)(((uintptr_t)block + alignment - 1) & ~(alignment - 1));
+    ptrdiff_t padding = (uintptr_t)ptr - (uintptr_t)block;
+    _fitPadding(padding, alignment);
+    ptr = (void*)((uintptr_t)block + padding);
+
+    size_t usedSize = (padding + sz + TAG_MASK) & ~TAG_MASK;
+    assert(usedSize <= blockSize);
+
+    if (blockSize - usedSize >= minBlockSize) {
+        // the remainder goes back to the index
+        void* newBlock = (void*)((uintptr_t)block + usedSize);
+        _markFree(newBlock, blockSize - usedSize);
+        _insertFreeBlock(newBlock);
+        blockSize = usedSize;
+    }
+    else {
+        *(size_t*)((uintptr_t)block + blockSize) &= ~TAG_PREV_FREE;
+    }
+
+    ((FreeBlockHeader*)block)->tag = blockSize;
+
+    AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)ptr - allocHeaderSize)) AllocatedBlockHeader;
+    allocHeader->sz = blockSize - padding;
+    allocHeader->padding = padding;
+    *(size_t*)((uintptr_t)block + tagSize) = padding;
+
+    return ptr;
+}
+
+template <typename _ALLOC_BUFFER>
+void* BTreeAllocator<_ALLOC_BUFFER>::Alloc(size_t sz, size_t alignment) {
+    assert((alignment & (alignment - 1)) == 0);
+
+    // blocks are only granule aligned, reserve the worst case padding up front
+    // so that the lower bound is guaranteed to fit
+    size_t worstPadding = minPadding + (alignment > tagSize ? alignment - tagSize : 0);
+
+    // the size of a key is 31 bits of granules, larger requests would wrap into a small key
+    if (sz >= MAX_ARENA_SIZE - worstPadding) {
+        _statsFail(sz);
+        return NULL;
+    }
+
+    size_t blockSize = (sz + worstPadding + TAG_MASK) & ~TAG_MASK;
+
+    uint64_t key;
+    void* block = NULL;
+
+    if (_lowerBound(_key(m_start, blockSize), key)) {
+        block = _keyBlock(key);
+        _removeFreeBlock(block);
+    }
+    else {
+        if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+            block = alloc_VMDYNAMIC_VMEXPAND(blockSize);
+        }
+        if (!block) {
+            _statsFail(sz);
+            return NULL;
+        }
+    }
+
+    void* ptr = _carve(block, sz, alignment);
+    _statsAlloc(sz, ((AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize))->sz);
+
+    return ptr;
+}
+
+template <typename _ALLOC_BUFFER>
+void* BTreeAllocator<_ALLOC_BUFFER>::alloc_VMDYNAMIC_VMEXPAND(size_t sz) {
+    // no free block could serve the request
+    // grow the arena from the epilogue, absorbing the last block if it is free
+    uint32_t vmPageSize = m_vmAllocator->PageSize();
+    size_t* epilogue = (size_t*)((uintptr_t)m_end - tagSize);
+    void* block;
+    size_t blockSize;
+
+    if (*epilogue & TAG_PREV_FREE) {
+        blockSize = *(size_t*)((uintptr_t)epilogue - tagSize);
+        block = (void*)((uintptr_t)epilogue - blockSize);
+        _removeFreeBlock(block);
+    }
+    else {
+        block = epilogue;
+        blockSize = 0;
+    }
+
+    // the new epilogue takes a word from the new pages
+    uint32_t n = (uint32_t)ceil((double)(sz + tagSize - blockSize) / vmPageSize);
+    size_t vmAllocSize = (size_t)n * vmPageSize;
+
+    void* vmAlloc = m_size + vmAllocSize < MAX_ARENA_SIZE ? m_vmAllocator->Alloc(n) : NULL;
+    // out of address space, or the pages didn't land right after the arena
+    if (vmAlloc != m_end) {
+        if (vmAlloc)
+            m_vmAllocator->Shrink(n);
+        if (blockSize)
+            _insertFreeBlock(block);
+        return NULL;
+    }
+
+    m_nVMPages += n;
+    m_end = (void*)((uintptr_t)m_end + vmAllocSize);
+    m_size += vmAllocSize;
+
+    *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+
+    _markFree(block, blockSize + vmAllocSize);
+
+    return block;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    AllocatedBlockHeader* allocHeader = (AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize);
+
+    void* block = (void*)((uintptr_t)ptr - allocHeader->padding);
+    size_t tag = *(size_t*)block;
+
+    if (tag & TAG_FREE)
+        return;
+
+    _statsFree(allocHeader->sz);
+
+    size_t blockSize = tag & ~TAG_MASK;
+    void* next = (void*)((uintptr_t)block + blockSize);
+    size_t nextTag = *(size_t*)next;
+
+    // merge with the left neighbour, its footer sits right before our tag
+    if (tag & TAG_PREV_FREE) {
+        size_t prevSize = *(size_t*)((uintptr_t)block - tagSize);
+        block = (void*)((uintptr_t)block - prevSize);
+        blockSize += prevSize;
+        _removeFreeBlock(block);
+    }
+
+    // merge with the right neighbour
+    if (nextTag & TAG_FREE) {
+        blockSize += nextTag & ~TAG_MASK;
+        _removeFreeBlock(next);
+    }
+
+    _markFree(block, blockSize);
+    _insertFreeBlock(block);
+
+    ptr = NULL;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::Layout() {
+    uint32_t height = 1;
+    for (Node* node = _node(m_root); !node->isLeaf; node = _node(node->children[0]))
+        ++height;
+
+    // the largest block is the last key of the rightmost leaf
+    Node* node = _node(m_root);
+    while (!node->isLeaf)
+        node = _node(node->children[node->nKeys]);
+    size_t largest = node->nKeys ? (size_t)(node->keys[node->nKeys - 1] >> 32) << GRANULE_SHIFT : 0;
+
+    std::cout << ((uintptr_t)m_end - (uintptr_t)m_start) << "\nNum of committed VM pages: " << m_nVMPages
+        << "\nNum of free blocks: " << m_nFreeBlocks << " Largest free block: " << largest
+        << "\nIndex height: " << height << " Index nodes: " << m_nNodes
+        << " (" << m_nNodes * sizeof(Node) << " bytes of metadata)";
+
+    std::cout << "\n";
+
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    while (_walk(cursor, block)) {
+        _layoutBlock(block);
+        report.Add(block);
+    }
+
+    _layoutReport(report);
+}
+
+template <typename _ALLOC_BUFFER>
+bool BTreeAllocator<_ALLOC_BUFFER>::Walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    return _walk(cursor, block);
+}
+
+template <typename _ALLOC_BUFFER>
+HeapReport BTreeAllocator<_ALLOC_BUFFER>::Report() {
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    while (_walk(cursor, block))
+        report.Add(block);
+
+    return report;
+}
+
+// physical walk by the boundary tags, the epilogue (size 0) ends it
+template <typename _ALLOC_BUFFER>
+bool BTreeAllocator<_ALLOC_BUFFER>::_walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    if (!m_initialized)
+        return false;
+
+    if (!cursor.block)
+        cursor.block = m_start;
+
+    uintptr_t cur = (uintptr_t)cursor.block;
+    if (cur >= (uintptr_t)m_end - tagSize)
+        return false;
+
+    size_t tag = *(size_t*)cur;
+    if (!(tag & ~TAG_MASK))
+        return false;
+
+    block.offset = cur - (uintptr_t)m_start;
+    block.size = tag & ~TAG_MASK;
+    block.free = (tag & TAG_FREE) != 0;
+    block.padding = block.free ? 0 : *(size_t*)(cur + tagSize);
+
+    cursor.block = (void*)(cur + block.size);
+    return true;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::Release() {
+    _statsReset();
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        m_vmAllocator->Release();
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
+        free(m_start);
+    }
+    m_initialized = false;
+    return;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::Reset() {
+    _statsReset();
+    build();
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::ZeroMem() {
+    memset(m_start, 0, m_size);
+}
+
+template <typename _ALLOC_BUFFER>
+bool BTreeAllocator<_ALLOC_BUFFER>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::RegisterPages(Allocator* owner) {
+    // VMDYNAMIC: the whole reservation, pages committed later are covered too
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Register(m_start, sz, owner ? owner : this);
+}
+
+template <typename _ALLOC_BUFFER>
+void BTreeAllocator<_ALLOC_BUFFER>::UnregisterPages() {
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Unregister(m_start, sz);
+}
+
+template class BTreeAllocator<ALLOC_BUFFER_STATIC>;
+template class BTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>;
+template class BTreeAllocator<ALLOC_BUFFER_VMDYNAMIC>;
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Allocator.h"
+#include "VMLinearAllocator.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <memory>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+Best fit allocator with the free blocks indexed by a B+ tree
+
+RBTreeAllocator keeps its nodes inside the free blocks, so every level of a lookup is a cache miss somewhere in the arena.
+Here the index lives in a separate metadata region (its own VM reservation) and a node holds NODE_KEYS sorted keys
+in a couple of cache lines, a lookup touches log16(N) nodes and every node is searched with SIMD compares
+(AVX2 or SSE4.2, picked at startup from CPUID, so the default /arch build uses them too).
+
+Key: (size, address) packed in 64 bits, size in granules in the upper half, offset from m_start in granules in the lower half,
+so a lower bound on (size, 0) is the smallest fitting block at the lowest address.
+Leaves are chained in key order, Alloc walks to the successor when the lower bound leaf is exhausted.
+
+Blocks carry boundary tags (same layout as TLSFAllocator), so Free merges with both physical neighbours.
+*/
+
+template <typename _ALLOC_BUFFER>
+class BTreeAllocator : public Allocator {
+
+public:
+    // STATIC & VMDYNAMIC
+    BTreeAllocator(size_t sz);
+
+    // STATIC PREALLOC
+    BTreeAllocator(void* buffer, size_t sz);
+
+    ~BTreeAllocator();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+
+    void Layout() final;
+
+    // ptr lies in the arena
+    bool Owns(const void* ptr) final;
+    // maps the arena (the whole reservation in VMDYNAMIC mode) in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    // blocks in address order, see HeapWalk.h
+    bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    HeapReport Report() final;
+
+protected:
+    // [tag ... footer] free block, the links live in the index
+    // [tag ... AllocatedBlockHeader|user data] allocated block
+    struct FreeBlockHeader {
+        size_t tag;
+    };
+
+    // the padding comes first, with the minimum padding it's the word after the tag,
+    // larger paddings are repeated there, so a heap walk finds the header from the start of the block
+    struct AllocatedBlockHeader {
+        size_t padding;
+        size_t sz;
+    };
+
+    static constexpr uint32_t NODE_KEYS = 16;
+
+    // unused key slots hold KEY_PAD, that way a node is always searched in full with no masking
+    struct alignas(64) Node {
+        uint64_t keys[NODE_KEYS];
+        uint32_t children[NODE_KEYS + 1];
+        uint32_t nKeys;
+        uint32_t isLeaf;
+        // leaf chain in key order, next also links the free nodes
+        uint32_t next;
+        uint32_t prev;
+    };
+
+private:
+    /* FUNCTIONS */
+
+    inline void build();
+
+    void* alloc_VMDYNAMIC_VMEXPAND(size_t sz);
+
+    // index
+    static inline uint32_t _rank(const uint64_t* keys, uint64_t key);
+
+    inline Node* _node(uint32_t index);
+    uint32_t _newNode(bool isLeaf);
+    inline void _freeNode(uint32_t index);
+
+    void _insert(uint64_t key);
+    void _erase(uint64_t key);
+    bool _lowerBound(uint64_t key, uint64_t& found);
+
+    void _splitChild(uint32_t parent, uint32_t i);
+    bool _eraseRecursive(uint32_t node, uint64_t key);
+    void _fixChild(uint32_t parent, uint32_t i);
+    void _mergeChildren(uint32_t parent, uint32_t i);
+
+    inline uint64_t _key(void* block, size_t sz);
+    inline void* _keyBlock(uint64_t key);
+
+    // blocks
+    inline void _insertFreeBlock(void* block);
+    inline void _removeFreeBlock(void* block);
+    inline void _markFree(void* block, size_t sz);
+
+    inline void _fitPadding(ptrdiff_t& padding, size_t alignment);
+    inline void* _carve(void* block, size_t sz, size_t alignment);
+
+    bool _walk(HeapWalkCursor& cursor, HeapBlock& block);
+
+    /* CONSTEXPRS */
+
+    static constexpr size_t tagSize = sizeof(size_t);
+    static constexpr size_t TAG_FREE = 1;
+    static constexpr size_t TAG_PREV_FREE = 2;
+    static constexpr size_t TAG_MASK = tagSize - 1;
+
+    static constexpr size_t allocHeaderSize = sizeof(AllocatedBlockHeader);
+    // tag + footer
+    static constexpr size_t minBlockSize = 2 * tagSize;
+    static constexpr size_t minPadding = tagSize + allocHeaderSize;
+
+    static constexpr uint32_t GRANULE_SHIFT = 3;
+    // sizes are compared as signed 64-bit integers, the upper half has to stay below 2^31 granules
+    static constexpr size_t MAX_ARENA_SIZE = (size_t)1 << (31 + GRANULE_SHIFT);
+
+    static constexpr uint64_t KEY_PAD = INT64_MAX;
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr uint32_t MIN_LEAF_KEYS = NODE_KEYS / 2;
+    static constexpr uint32_t MIN_INNER_KEYS = NODE_KEYS / 2 - 1;
+
+    static constexpr size_t RESERVE_VIRTUAL_ADDRESS_SPACE = 1024 * 1024 * 1024;
+    static constexpr size_t RESERVE_METADATA_SPACE = 256 * 1024 * 1024;
+
+    /* VARIABLES */
+
+    size_t m_size;
+
+    void* m_start;
+    void* m_end;
+
+    bool m_initialized;
+
+    // index
+    Node* m_nodes;
+    uint32_t m_root;
+    uint32_t m_nNodes;
+    uint32_t m_nCommittedNodes;
+    uint32_t m_freeNodes;
+    size_t m_nFreeBlocks;
+
+    VMLinearAllocator* m_metaAllocator;
+
+    VMLinearAllocator* m_vmAllocator;
+    uint32_t m_nVMPages;
+};
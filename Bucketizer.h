@@ -0,0 +1,161 @@
+#pragma once
+
+#include "Allocator.h"
+#include "PoolAllocator.h"
+#include "LockPolicy.h"
+#include <Windows.h>
+#include <stdint.h>
+#include <assert.h>
+
+/*
+One PoolAllocator per size range: bucket i takes the requests in (_MIN_SIZE + (i-1)*_STEP, _MIN_SIZE + i*_STEP],
+bucket 0 everything up to _MIN_SIZE, and its slots are _MIN_SIZE + i*_STEP bytes.
+Requests above _MAX_SIZE, or aligned to more than the slots are, fail with NULL, put it behind a Segregator or in a FallbackAllocator.
+
+The pools share one reservation cut into page aligned slices of bucketSize bytes,
+Alloc picks the pool from the size and Free from the address, both are an index computation.
+The bucket count and the slot sizes are compile time constants, the pools are instances of the concrete PoolAllocator.
+Every pool has its own lock when _LOCK_POLICY isn't ALLOC_LOCK_NONE. Header only.
+*/
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY = ALLOC_LOCK_NONE>
+class Bucketizer : public Allocator {
+public:
+    // bucketSize: bytes per bucket
+    Bucketizer(size_t bucketSize);
+    ~Bucketizer();
+
+    inline void* Alloc(size_t sz, size_t alignment) final;
+    inline void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    inline void Layout() final;
+    inline AllocatorStats GetStats() final;
+
+    // ptr lies in the reservation
+    inline bool Owns(const void* ptr) final;
+    // maps every bucket in AllocatorPageMap with its slot size as the size class
+    inline void RegisterPages(Allocator* owner = NULL) final;
+    inline void UnregisterPages() final;
+
+    static constexpr size_t N_BUCKETS = (_MAX_SIZE - _MIN_SIZE + _STEP - 1) / _STEP + 1;
+    // every slot size is a multiple of it
+    static constexpr size_t SLOT_ALIGNMENT = (_MIN_SIZE | _STEP) & ~((_MIN_SIZE | _STEP) - 1);
+
+private:
+    static_assert(_MIN_SIZE >= sizeof(void*) && _MIN_SIZE <= _MAX_SIZE, "SLOTS MUST HOLD THE FREE LIST LINK");
+    static_assert(_STEP > 0 && _STEP % sizeof(void*) == 0, "STEP MUST KEEP THE SLOTS POINTER ALIGNED");
+
+    static constexpr size_t _slotSize(size_t bucket) { return _MIN_SIZE + bucket * _STEP; }
+
+    PoolAllocator<_LOCK_POLICY>* m_buckets[N_BUCKETS];
+    void* m_start;
+    void* m_end;
+    size_t m_bucketStride;
+};
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Bucketizer(size_t bucketSize) {
+    SYSTEM_INFO sSysInfo;
+    GetSystemInfo(&sSysInfo);
+
+    assert(bucketSize >= _slotSize(N_BUCKETS - 1) && "BUCKET SMALLER THAN ONE SLOT");
+
+    // slices on allocation granularity boundaries, the AllocatorPageMap unit, so no two buckets share an entry
+    m_bucketStride = (bucketSize + sSysInfo.dwAllocationGranularity - 1) & ~((size_t)sSysInfo.dwAllocationGranularity - 1);
+    size_t commitSize = (bucketSize + sSysInfo.dwPageSize - 1) & ~((size_t)sSysInfo.dwPageSize - 1);
+
+    // the tail of every slice past its pages stays reserved only
+    m_start = VirtualAlloc(NULL, m_bucketStride * N_BUCKETS, MEM_RESERVE, PAGE_READWRITE);
+    assert(m_start && "ERR VIRTUALALLOC");
+    m_end = (void*)((uintptr_t)m_start + m_bucketStride * N_BUCKETS);
+
+    for (size_t i = 0; i < N_BUCKETS; ++i) {
+        void* bucket = VirtualAlloc((void*)((uintptr_t)m_start + i * m_bucketStride), commitSize, MEM_COMMIT, PAGE_READWRITE);
+        assert(bucket && "ERR VIRTUALALLOC");
+
+        // whole slots only, the pool needs its size to be a multiple of the slot size
+        size_t slotSize = _slotSize(i);
+        m_buckets[i] = new PoolAllocator<_LOCK_POLICY>(bucket, (bucketSize / slotSize) * slotSize, slotSize);
+    }
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::~Bucketizer() {
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+        delete m_buckets[i];
+
+    VirtualFree(m_start, 0, MEM_RELEASE);
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void* Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Alloc(size_t sz, size_t alignment) {
+    if (sz > _MAX_SIZE || alignment > SLOT_ALIGNMENT)
+        return NULL;
+
+    size_t bucket = sz <= _MIN_SIZE ? 0 : (sz - _MIN_SIZE + _STEP - 1) / _STEP;
+    return m_buckets[bucket]->Alloc(sz, alignment);
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    assert(Owns(ptr) && "PTR ISN'T OWNED BY ANY BUCKET");
+    m_buckets[((uintptr_t)ptr - (uintptr_t)m_start) / m_bucketStride]->Free(ptr);
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Release() {
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+        m_buckets[i]->Release();
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Reset() {
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+        m_buckets[i]->Reset();
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::ZeroMem() {
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+        m_buckets[i]->ZeroMem();
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Layout() {
+    for (size_t i = 0; i < N_BUCKETS; ++i) {
+        std::cout << "Bucket " << i << ", " << _slotSize(i) << " byte slots\n";
+        m_buckets[i]->Layout();
+    }
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+AllocatorStats Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::GetStats() {
+    AllocatorStats stats = m_buckets[0]->GetStats();
+
+    for (size_t i = 1; i < N_BUCKETS; ++i)
+        stats.Accumulate(m_buckets[i]->GetStats());
+
+    return stats;
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+bool Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::RegisterPages(Allocator* owner) {
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+        AllocatorPageMap::Register((void*)((uintptr_t)m_start + i * m_bucketStride), m_bucketStride,
+            owner ? owner : this, (uint32_t)_slotSize(i));
+}
+
+template <size_t _MIN_SIZE, size_t _MAX_SIZE, size_t _STEP, typename _LOCK_POLICY>
+void Bucketizer<_MIN_SIZE, _MAX_SIZE, _STEP, _LOCK_POLICY>::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_start, m_bucketStride * N_BUCKETS);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Allocator.h"
+#include <tuple>
+#include <stdint.h>
+
+/*
+Tries _PRIMARY first and hands the request to _SECONDARY when the primary can't serve it
+(full, or the request doesn't fit its blocks), e.g. a PoolAllocator or StackAllocator in front of a RBTreeAllocator.
+Free goes to the primary when it owns the pointer (Owns(), an address range check), to the secondary otherwise.
+
+The primary must fail with NULL rather than assert, Pool and Stack allocators do.
+Same rules as Segregator: members of their concrete type, no virtual dispatch inside, no lock of its own, header only.
+
+    FallbackAllocator<PoolAllocator<>, RBTreeAllocator<ALLOC_BUFFER_STATIC>>
+        allocator(std::make_tuple(1 * MB, 1024), std::make_tuple(64 * MB));
+*/
+
+template <typename _PRIMARY, typename _SECONDARY>
+class FallbackAllocator : public Allocator {
+public:
+    template <typename... _PRIMARY_ARGS, typename... _SECONDARY_ARGS>
+    FallbackAllocator(std::tuple<_PRIMARY_ARGS...> primaryArgs, std::tuple<_SECONDARY_ARGS...> secondaryArgs);
+
+    inline void* Alloc(size_t sz, size_t alignment) final;
+    inline void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    inline void Layout() final;
+    inline AllocatorStats GetStats() final;
+    // merged reports of both allocators
+    inline HeapReport Report() final;
+
+    // ptr lies in either allocator
+    inline bool Owns(const void* ptr) final;
+    // maps both allocators in AllocatorPageMap, each to itself unless an owner is given
+    inline void RegisterPages(Allocator* owner = NULL) final;
+    inline void UnregisterPages() final;
+
+    inline _PRIMARY& Primary();
+    inline _SECONDARY& Secondary();
+
+private:
+    _PRIMARY m_primary;
+    _SECONDARY m_secondary;
+};
+
+template <typename _PRIMARY, typename _SECONDARY>
+template <typename... _PRIMARY_ARGS, typename... _SECONDARY_ARGS>
+FallbackAllocator<_PRIMARY, _SECONDARY>::FallbackAllocator(std::tuple<_PRIMARY_ARGS...> primaryArgs, std::tuple<_SECONDARY_ARGS...> secondaryArgs) :
+    // guaranteed copy elision, the allocators are built in place
+    m_primary(std::make_from_tuple<_PRIMARY>(primaryArgs)),
+    m_secondary(std::make_from_tuple<_SECONDARY>(secondaryArgs))
+{}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void* FallbackAllocator<_PRIMARY, _SECONDARY>::Alloc(size_t sz, size_t alignment) {
+    void* ptr = m_primary.Alloc(sz, alignment);
+    if (ptr)
+        return ptr;
+    return m_secondary.Alloc(sz, alignment);
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    if (m_primary.Owns(ptr))
+        m_primary.Free(ptr);
+    else
+        m_secondary.Free(ptr);
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::Release() {
+    m_primary.Release();
+    m_secondary.Release();
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::Reset() {
+    m_primary.Reset();
+    m_secondary.Reset();
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::ZeroMem() {
+    m_primary.ZeroMem();
+    m_secondary.ZeroMem();
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::Layout() {
+    std::cout << "Fallback, primary\n";
+    m_primary.Layout();
+    std::cout << "Fallback, secondary\n";
+    m_secondary.Layout();
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+AllocatorStats FallbackAllocator<_PRIMARY, _SECONDARY>::GetStats() {
+    AllocatorStats stats = m_primary.GetStats();
+    stats.Accumulate(m_secondary.GetStats());
+    return stats;
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+HeapReport FallbackAllocator<_PRIMARY, _SECONDARY>::Report() {
+    HeapReport report = m_primary.Report();
+    report.Merge(m_secondary.Report());
+    return report;
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+bool FallbackAllocator<_PRIMARY, _SECONDARY>::Owns(const void* ptr) {
+    return m_primary.Owns(ptr) || m_secondary.Owns(ptr);
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::RegisterPages(Allocator* owner) {
+    m_primary.RegisterPages(owner);
+    m_secondary.RegisterPages(owner);
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+void FallbackAllocator<_PRIMARY, _SECONDARY>::UnregisterPages() {
+    m_primary.UnregisterPages();
+    m_secondary.UnregisterPages();
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+_PRIMARY& FallbackAllocator<_PRIMARY, _SECONDARY>::Primary() {
+    return m_primary;
+}
+
+template <typename _PRIMARY, typename _SECONDARY>
+_SECONDARY& FallbackAllocator<_PRIMARY, _SECONDARY>::Secondary() {
+    return m_secondary;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+Heap walk, the blocks of an allocator in address order, one HeapBlock per call of Allocator::Walk.
+The walk allocates nothing and takes no memory outside the arena, the position lives in a HeapWalkCursor owned by the caller:
+
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    while (allocator.Walk(cursor, block))
+        ...
+
+Every call is a single step (under the allocator's lock when it has one), an Alloc or Free in between invalidates the cursor,
+walk from a thread that owns the allocator or call Report(), it walks the whole heap under the lock once.
+Allocators that have no per block layout (Linear, Stack, Pool, Slab) return false right away and an empty report,
+the wrappers (Sharded, NUMA, Segregator, Fallback) don't walk either, their Report() merges the reports of the allocators inside.
+*/
+
+struct HeapBlock {
+    // from the start of the arena
+    size_t offset;
+    // bytes the block spans, header and padding included
+    size_t size;
+    // bytes in front of the user pointer, 0 for free blocks
+    size_t padding;
+    bool free;
+};
+
+// position of a walk, a default constructed cursor starts from the first block
+struct HeapWalkCursor {
+    void* block = NULL;
+    // allocator specific, e.g. the next free block of an address ordered list
+    void* aux = NULL;
+};
+
+// heap health, built from one walk
+struct HeapReport {
+    static constexpr uint32_t N_HISTOGRAM_BUCKETS = 32;
+
+    uint64_t nFreeBlocks = 0;
+    uint64_t nUsedBlocks = 0;
+    uint64_t bytesFree = 0;
+    uint64_t bytesUsed = 0;
+    // bytes in front of the user pointers (headers and alignment)
+    uint64_t bytesPadding = 0;
+    uint64_t largestFree = 0;
+    // freeHistogram[i]: free blocks of [2^i, 2^(i+1)) bytes, the last bucket takes the rest
+    uint64_t freeHistogram[N_HISTOGRAM_BUCKETS] = {};
+
+    inline void Add(const HeapBlock& block) {
+        if (block.free) {
+            ++nFreeBlocks;
+            bytesFree += block.size;
+            largestFree = block.size > largestFree ? block.size : largestFree;
+            ++freeHistogram[_bucket(block.size)];
+        }
+        else {
+            ++nUsedBlocks;
+            bytesUsed += block.size;
+            bytesPadding += block.padding;
+        }
+    }
+
+    // adds up the reports of sub-allocators, the largest free block is the largest of theirs
+    inline void Merge(const HeapReport& other) {
+        nFreeBlocks += other.nFreeBlocks;
+        nUsedBlocks += other.nUsedBlocks;
+        bytesFree += other.bytesFree;
+        bytesUsed += other.bytesUsed;
+        bytesPadding += other.bytesPadding;
+        largestFree = other.largestFree > largestFree ? other.largestFree : largestFree;
+        for (uint32_t i = 0; i < N_HISTOGRAM_BUCKETS; ++i)
+            freeHistogram[i] += other.freeHistogram[i];
+    }
+
+    // 1 - largest free block / free bytes
+    // 0 when the free memory is a single block, towards 1 the more it's scattered in small blocks
+    inline double FragmentationIndex() const {
+        if (!bytesFree)
+            return 0.0;
+        return 1.0 - (double)largestFree / (double)bytesFree;
+    }
+
+private:
+    // index of the most significant set bit
+    static inline uint32_t _bucket(size_t sz) {
+        if (!sz)
+            return 0;
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, sz);
+#else
+        uint32_t index = 63 - (uint32_t)__builtin_clzll(sz);
+#endif
+        return index < N_HISTOGRAM_BUCKETS ? (uint32_t)index : N_HISTOGRAM_BUCKETS - 1;
+    }
+};
+
+// the blocks of a heap of heapSize bytes tile it from offset 0, a walk that skips, runs off the end or loops fails,
+// the allocators leave less than a granule (or the end tag) of the buffer out. Consistency check of a heap adopted from a file
+// or a shared section, nFreeBlocks: free blocks walked
+template <typename _ALLOCATOR>
+bool HeapWalkTiles(_ALLOCATOR& allocator, size_t heapSize, uint64_t& nFreeBlocks) {
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    uint64_t expected = 0;
+    uint64_t nBlocks = 0;
+
+    nFreeBlocks = 0;
+    while (allocator.Walk(cursor, block)) {
+        if (block.offset != expected || !block.size || block.size > heapSize - expected || ++nBlocks > heapSize / sizeof(size_t))
+            return false;
+        expected += block.size;
+        nFreeBlocks += block.free;
+    }
+
+    return heapSize - expected < 2 * sizeof(size_t);
+}
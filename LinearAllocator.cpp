@@ -2,40 +2,58 @@
 
 /* Constructors */
 
-LinearAllocator::LinearAllocator(size_t sz) : m_size(sz), m_free(sz), m_preAlloc(false), m_initialized(false) {
-    m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
+template <typename _LOCK_POLICY>
+LinearAllocator<_LOCK_POLICY>::LinearAllocator(size_t sz, bool largePages) : m_size(sz), m_free(sz), m_preAlloc(false), m_initialized(false), m_largePages(false) {
+    if (largePages) {
+        m_start = VMLinearAllocator::AllocLargePages(m_size * sizeof(uint8_t));
+        m_largePages = m_start != NULL;
+    }
+    if (!m_largePages)
+        m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
     m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
     m_cur = m_start;
     m_initialized = true;
 }
 
-LinearAllocator::LinearAllocator(void* buffer, size_t sz) : m_size(sz), m_free(sz), m_preAlloc(true), m_initialized(true) {
+template <typename _LOCK_POLICY>
+LinearAllocator<_LOCK_POLICY>::LinearAllocator(void* buffer, size_t sz) : m_size(sz), m_free(sz), m_preAlloc(true), m_initialized(true), m_largePages(false) {
     m_start = buffer;
     m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+    m_cur = m_start;
 }
 
 /* Destructor */
 
-LinearAllocator::~LinearAllocator() {
+template <typename _LOCK_POLICY>
+LinearAllocator<_LOCK_POLICY>::~LinearAllocator() {
     if (m_preAlloc || !m_initialized)
         return;
-    free(m_start);
+    if (m_largePages)
+        VMLinearAllocator::FreeLargePages(m_start);
+    else
+        free(m_start);
 }
 
-void* LinearAllocator::Alloc(size_t sz, size_t alignment) {
+template <typename _LOCK_POLICY>
+void* LinearAllocator<_LOCK_POLICY>::Alloc(size_t sz, size_t alignment) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     if (!m_initialized)
         return nullptr;
 
     assert((alignment & (alignment - 1)) == 0);
 
+    void* prevCur = m_cur;
     void* ptr = std::align(alignment, sz, m_cur, m_free);
     //std::cout << (uintptr_t)m_cur - (uintptr_t)m_start << std::endl;
 
     if (!ptr) {
+        _statsFail(sz);
         assert(false && "Linear allocator full!");
         return nullptr;
     }
 
+    _statsAlloc(sz, (uintptr_t)ptr + sz - (uintptr_t)prevCur);
+
     m_free -= sz;
     m_cur = (void*)((uintptr_t)ptr+sz);
 
@@ -44,24 +62,58 @@ void* LinearAllocator::Alloc(size_t sz, size_t alignment) {
     return ptr;
 }
 
-void LinearAllocator::Free(void*&) {
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::Free(void*&) {
     // not supported for linear allocator
 }
 
-void LinearAllocator::Release() {
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::Release() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
     if (m_preAlloc)
         return;
-    free(m_start);
+    if (m_largePages)
+        VMLinearAllocator::FreeLargePages(m_start);
+    else
+        free(m_start);
     m_initialized = false;
 }
 
-void LinearAllocator::Reset() {
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::Reset() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
     m_cur = m_start;
+    m_free = m_size;
 }
 
-void LinearAllocator::ZeroMem() {
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::ZeroMem() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     memset(m_start, 0, m_size);
 }
 
-void LinearAllocator::Layout() {
-}
\ No newline at end of file
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::Layout() {
+}
+
+template <typename _LOCK_POLICY>
+bool LinearAllocator<_LOCK_POLICY>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::RegisterPages(Allocator* owner) {
+    AllocatorPageMap::Register(m_start, m_size, owner ? owner : this);
+}
+
+template <typename _LOCK_POLICY>
+void LinearAllocator<_LOCK_POLICY>::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_start, m_size);
+}
+
+template class LinearAllocator<ALLOC_LOCK_NONE>;
+template class LinearAllocator<ALLOC_LOCK_SPIN>;
+template class LinearAllocator<ALLOC_LOCK_MUTEX>;
+template class LinearAllocator<ALLOC_LOCK_TICKET>;
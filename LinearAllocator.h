@@ -1,15 +1,19 @@
 #pragma once
 
 #include "Allocator.h"
+#include "VMLinearAllocator.h"
+#include "LockPolicy.h"
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <memory>
 
-class LinearAllocator : public Allocator {
+template <typename _LOCK_POLICY = ALLOC_LOCK_NONE>
+class LinearAllocator : public Allocator, protected AllocatorLock<_LOCK_POLICY> {
 public:
-    LinearAllocator(size_t sz);
+    // largePages: back the buffer with large pages when the process is allowed to, malloc otherwise
+    LinearAllocator(size_t sz, bool largePages = false);
     LinearAllocator(void* buffer, size_t sz);
     ~LinearAllocator();
 
@@ -20,6 +24,12 @@ public:
     inline void ZeroMem() final;
     inline void Layout() final;
 
+    // ptr lies in the buffer
+    bool Owns(const void* ptr) final;
+    // maps the buffer in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
 private:
     void* m_start;
     void* m_cur;
@@ -28,4 +38,5 @@ private:
     size_t m_free;
     bool m_initialized;
     bool m_preAlloc;
+    bool m_largePages;
 };
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <stdint.h>
+
+#pragma comment(lib, "Synchronization.lib")
+
+/*
+Lock policy, a template argument of the Linear, Stack, Pool, Sequential List and Red Black Tree allocators.
+Every public entry point (Alloc, Free, Reset, Release, ZeroMem, Layout) holds the lock for its whole body.
+
+ALLOC_LOCK_NONE: no lock, an empty base, the guard compiles to nothing. Single threaded use, the default.
+ALLOC_LOCK_SPIN: test & test-and-set spinlock with exponential backoff, yields the time slice once the backoff tops out.
+ALLOC_LOCK_MUTEX: futex style mutex on WaitOnAddress (0 free, 1 locked, 2 locked with waiters),
+    no syscall unless a thread has to sleep, and Unlock only wakes somebody when there's a sleeper.
+ALLOC_LOCK_TICKET: ticket lock, FIFO fair, each waiter backs off in proportion to its distance from the head of the queue
+    only the waiters close to the head spin, and only for MAX_SPIN_ROUNDS, the rest yield the core.
+*/
+
+struct ALLOC_LOCK_NONE {};
+struct ALLOC_LOCK_SPIN {};
+struct ALLOC_LOCK_MUTEX {};
+struct ALLOC_LOCK_TICKET {};
+
+template <typename _LOCK_POLICY>
+class AllocatorLock;
+
+template <>
+class AllocatorLock<ALLOC_LOCK_NONE> {
+protected:
+    inline void _lock() {}
+    inline void _unlock() {}
+
+    template <typename>
+    friend class AllocatorLockGuard;
+};
+
+template <>
+class AllocatorLock<ALLOC_LOCK_SPIN> {
+protected:
+    AllocatorLock() : m_locked(0) {}
+
+    inline void _lock() {
+        uint32_t backoff = 1;
+
+        while (m_locked.exchange(1, std::memory_order_acquire)) {
+            // wait on a plain load, the cache line stays shared until the owner lets go
+            do {
+                if (backoff < MAX_BACKOFF) {
+                    for (uint32_t i = 0; i < backoff; ++i)
+                        YieldProcessor();
+                    backoff <<= 1;
+                }
+                else {
+                    SwitchToThread();
+                }
+            } while (m_locked.load(std::memory_order_relaxed));
+        }
+    }
+
+    inline void _unlock() {
+        m_locked.store(0, std::memory_order_release);
+    }
+
+    template <typename>
+    friend class AllocatorLockGuard;
+
+private:
+    static constexpr uint32_t MAX_BACKOFF = 1024;
+
+    std::atomic<uint32_t> m_locked;
+};
+
+template <>
+class AllocatorLock<ALLOC_LOCK_MUTEX> {
+protected:
+    AllocatorLock() : m_state(0) {}
+
+    inline void _lock() {
+        uint32_t state = 0;
+        if (m_state.compare_exchange_strong(state, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            return;
+
+        // contended, mark the lock as having waiters and sleep until it's free
+        if (state != 2)
+            state = m_state.exchange(2, std::memory_order_acquire);
+
+        while (state != 0) {
+            uint32_t waiting = 2;
+            WaitOnAddress(&m_state, &waiting, sizeof(uint32_t), INFINITE);
+            state = m_state.exchange(2, std::memory_order_acquire);
+        }
+    }
+
+    inline void _unlock() {
+        if (m_state.exchange(0, std::memory_order_release) == 2)
+            WakeByAddressSingle(&m_state);
+    }
+
+    template <typename>
+    friend class AllocatorLockGuard;
+
+private:
+    std::atomic<uint32_t> m_state;
+};
+
+template <>
+class AllocatorLock<ALLOC_LOCK_TICKET> {
+protected:
+    AllocatorLock() : m_next(0), m_serving(0) {}
+
+    inline void _lock() {
+        uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+
+        for (uint32_t round = 0; ; ++round) {
+            uint32_t serving = m_serving.load(std::memory_order_acquire);
+            if (serving == ticket)
+                return;
+
+            // the holder or the next in line may be preempted (more threads than cores), give them the core
+            if (round >= MAX_SPIN_ROUNDS || ticket - serving > MAX_SPINNING_WAITERS) {
+                SwitchToThread();
+                continue;
+            }
+
+            for (uint32_t i = 0; i < (ticket - serving) * BACKOFF_PER_WAITER; ++i)
+                YieldProcessor();
+        }
+    }
+
+    inline void _unlock() {
+        // only the owner writes m_serving
+        m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    template <typename>
+    friend class AllocatorLockGuard;
+
+private:
+    static constexpr uint32_t BACKOFF_PER_WAITER = 32;
+    static constexpr uint32_t MAX_SPIN_ROUNDS = 16;
+    static constexpr uint32_t MAX_SPINNING_WAITERS = 2;
+
+    // owner and waiters hammer m_serving, new arrivals m_next
+    alignas(64) std::atomic<uint32_t> m_next;
+    alignas(64) std::atomic<uint32_t> m_serving;
+};
+
+// holds the lock of an allocator for a scope
+template <typename _LOCK_POLICY>
+class AllocatorLockGuard {
+public:
+    inline AllocatorLockGuard(AllocatorLock<_LOCK_POLICY>& lock) : m_lock(lock) {
+        m_lock._lock();
+    }
+
+    inline ~AllocatorLockGuard() {
+        m_lock._unlock();
+    }
+
+private:
+    AllocatorLock<_LOCK_POLICY>& m_lock;
+};
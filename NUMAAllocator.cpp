@@ -0,0 +1,162 @@
+#include "NUMAAllocator.h"
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::NUMAAllocator(size_t sz, bool largePages) {
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode))
+        highestNode = 0;
+
+    m_nNodes = highestNode + 1;
+    if (m_nNodes > MAX_NUMA_NODES)
+        m_nNodes = MAX_NUMA_NODES;
+
+    if (m_nNodes == 1) {
+        m_arenas[0] = new Arena(sz, largePages);
+        return;
+    }
+
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        m_arenas[node] = new Arena(sz, largePages, node);
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::~NUMAAllocator() {
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        delete m_arenas[node];
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+uint32_t NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::NodeCount() {
+    return m_nNodes;
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+uint32_t NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::CurrentNode() {
+    if (m_nNodes == 1)
+        return 0;
+
+    // threads are expected to be pinned to a node, so the lookup is done once per thread
+    static thread_local uint32_t threadNode = UINT32_MAX;
+
+    if (threadNode == UINT32_MAX) {
+        PROCESSOR_NUMBER processor;
+        USHORT node = 0;
+
+        GetCurrentProcessorNumberEx(&processor);
+        if (!GetNumaProcessorNodeEx(&processor, &node) || node >= m_nNodes)
+            node = 0;
+
+        threadNode = node;
+    }
+
+    return threadNode;
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Alloc(size_t sz, size_t alignment) {
+    return m_arenas[CurrentNode()]->Alloc(sz, alignment);
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    for (uint32_t node = 0; node < m_nNodes; ++node) {
+        if (m_arenas[node]->Owns(ptr)) {
+            m_arenas[node]->Free(ptr);
+            return;
+        }
+    }
+
+    assert(false && "PTR ISN'T OWNED BY ANY NUMA ARENA");
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Release() {
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        m_arenas[node]->Release();
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Reset() {
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        m_arenas[node]->Reset();
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::ZeroMem() {
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        m_arenas[node]->ZeroMem();
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Layout() {
+    for (uint32_t node = 0; node < m_nNodes; ++node) {
+        std::cout << "NUMA node " << node << "\n";
+        m_arenas[node]->Layout();
+    }
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+AllocatorStats NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::GetStats() {
+    AllocatorStats stats = m_arenas[0]->GetStats();
+
+    for (uint32_t node = 1; node < m_nNodes; ++node)
+        stats.Accumulate(m_arenas[node]->GetStats());
+
+    return stats;
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+HeapReport NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Report() {
+    HeapReport report = m_arenas[0]->Report();
+
+    for (uint32_t node = 1; node < m_nNodes; ++node)
+        report.Merge(m_arenas[node]->Report());
+
+    return report;
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+bool NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Owns(const void* ptr) {
+    for (uint32_t node = 0; node < m_nNodes; ++node) {
+        if (m_arenas[node]->Owns(ptr))
+            return true;
+    }
+
+    return false;
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::RegisterPages(Allocator* owner) {
+    // NUMAAllocator::Free would only find the arena and call its Free, which takes the arena's lock
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        m_arenas[node]->RegisterPages(owner);
+}
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void NUMAAllocator<_ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::UnregisterPages() {
+    for (uint32_t node = 0; node < m_nNodes; ++node)
+        m_arenas[node]->UnregisterPages();
+}
+
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_NONE>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_NONE>;
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_NONE>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_NONE>;
+
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class NUMAAllocator<ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
+template class NUMAAllocator<ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
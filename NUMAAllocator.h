@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Allocator.h"
+#include "SequentialListAllocator.h"
+#include "LockPolicy.h"
+#include <stdint.h>
+#include <assert.h>
+
+/*
+One VMDYNAMIC SequentialListAllocator arena per NUMA node.
+Alloc is served by the arena of the node the calling thread runs on (looked up once per thread and cached),
+Free goes back to the arena that owns the pointer, whichever thread frees it.
+Each arena commits its pages with VirtualAllocExNuma on its own node.
+
+On a single node machine there is one arena without a preferred node, i.e. a plain SequentialListAllocator.
+
+Every arena holds its own _LOCK_POLICY lock (see LockPolicy.h): the threads of a node serialize on their arena,
+a thread freeing a block of another node takes that node's lock. Locked by default, ALLOC_LOCK_NONE is for one thread per node.
+*/
+
+template <typename _ALLOC_PATTERN, typename _ALLOC_FREELIST = ALLOC_FREELIST_ADDRESS_ORDERED, typename _LOCK_POLICY = ALLOC_LOCK_MUTEX>
+class NUMAAllocator : public Allocator {
+public:
+    // sz: initial size of every node's arena
+    NUMAAllocator(size_t sz, bool largePages = false);
+    ~NUMAAllocator();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    void Layout() final;
+
+    // sum of the arenas, the peak is the sum of the per arena peaks
+    AllocatorStats GetStats() final;
+    // merged reports of the arenas
+    HeapReport Report() final;
+
+    // ptr lies in one of the arenas
+    bool Owns(const void* ptr) final;
+    // maps every arena in AllocatorPageMap, to itself unless an owner is given
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    uint32_t NodeCount();
+    // node of the calling thread
+    uint32_t CurrentNode();
+
+private:
+    typedef SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY> Arena;
+
+    static constexpr uint32_t MAX_NUMA_NODES = 64;
+
+    Arena* m_arenas[MAX_NUMA_NODES];
+    uint32_t m_nNodes;
+};
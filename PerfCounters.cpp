@@ -0,0 +1,150 @@
+#include "PerfCounters.h"
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#else
+#include <Windows.h>
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+#endif
+
+#ifdef __linux__
+namespace {
+    struct PerfEvent {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    constexpr uint64_t cacheEvent(uint64_t cache, uint64_t op, uint64_t result) {
+        return cache | (op << 8) | (result << 16);
+    }
+
+    // in COUNTER order
+    const PerfEvent events[PerfCounters::N_COUNTERS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+        { PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+        { PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+    };
+
+    // value, time enabled, time running
+    struct PerfReading {
+        uint64_t value;
+        uint64_t timeEnabled;
+        uint64_t timeRunning;
+    };
+}
+#endif
+
+/* Constructors */
+
+PerfCounters::PerfCounters() {
+    memset(m_values, 0, sizeof(m_values));
+    memset(m_available, 0, sizeof(m_available));
+
+#ifdef __linux__
+    for (uint32_t i = 0; i < N_COUNTERS; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // this thread, any cpu, no group
+        m_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        m_available[i] = m_fds[i] >= 0;
+    }
+#else
+    m_startCycles = 0;
+    m_startPageFaults = 0;
+    m_available[CYCLES] = true;
+    m_available[PAGE_FAULTS] = true;
+#endif
+}
+
+/* Destructor */
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (uint32_t i = 0; i < N_COUNTERS; ++i) {
+        if (m_fds[i] >= 0)
+            close(m_fds[i]);
+    }
+#endif
+}
+
+void PerfCounters::Start() {
+#ifdef __linux__
+    for (uint32_t i = 0; i < N_COUNTERS; ++i) {
+        if (m_fds[i] < 0)
+            continue;
+        ioctl(m_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    PROCESS_MEMORY_COUNTERS memCounters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &memCounters, sizeof(memCounters));
+    m_startPageFaults = memCounters.PageFaultCount;
+
+    // last, the page fault query isn't part of the measurement
+    QueryThreadCycleTime(GetCurrentThread(), &m_startCycles);
+#endif
+}
+
+void PerfCounters::Stop() {
+#ifdef __linux__
+    for (uint32_t i = 0; i < N_COUNTERS; ++i) {
+        if (m_fds[i] >= 0)
+            ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (uint32_t i = 0; i < N_COUNTERS; ++i) {
+        PerfReading reading;
+        if (m_fds[i] < 0 || read(m_fds[i], &reading, sizeof(reading)) != sizeof(reading)) {
+            m_values[i] = 0;
+            continue;
+        }
+
+        // the PMU was shared with other events for a part of the time, extrapolate
+        if (reading.timeRunning && reading.timeRunning < reading.timeEnabled)
+            m_values[i] = (uint64_t)((double)reading.value * reading.timeEnabled / reading.timeRunning);
+        else
+            m_values[i] = reading.value;
+    }
+#else
+    uint64_t cycles;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    m_values[CYCLES] = cycles - m_startCycles;
+
+    PROCESS_MEMORY_COUNTERS memCounters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &memCounters, sizeof(memCounters));
+    m_values[PAGE_FAULTS] = memCounters.PageFaultCount - m_startPageFaults;
+#endif
+}
+
+bool PerfCounters::Available(COUNTER counter) const {
+    return m_available[counter];
+}
+
+uint64_t PerfCounters::Value(COUNTER counter) const {
+    return m_values[counter];
+}
+
+const char* PerfCounters::Name(COUNTER counter) {
+    static const char* names[N_COUNTERS] = {
+        "cycles", "instructions", "L1d misses", "LLC misses", "dTLB misses", "branch misses", "page faults"
+    };
+    return names[counter];
+}
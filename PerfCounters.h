@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+Hardware & OS counters of the calling thread between Start() and Stop(), for the microbenchmarks.
+
+Linux: every counter is a perf_event_open event (user space only), opened one by one so the PMU can multiplex them,
+the values are scaled by time enabled / time running. A counter the kernel or the PMU refuses
+(no PMU in a VM, perf_event_paranoid) is left unavailable, the others still count.
+Windows: user mode has no access to the PMU, CYCLES is QueryThreadCycleTime (cycles the thread was scheduled)
+and PAGE_FAULTS the process page fault count, the rest is unavailable.
+
+Counters are per thread, Start() and Stop() have to run on the thread that's measured.
+*/
+
+class PerfCounters {
+public:
+    enum COUNTER {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        DTLB_MISSES,
+        BRANCH_MISSES,
+        PAGE_FAULTS,
+        N_COUNTERS
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    void Start();
+    void Stop();
+
+    // the counter could be opened, Value() is 0 otherwise
+    bool Available(COUNTER counter) const;
+    // count between the last Start() & Stop()
+    uint64_t Value(COUNTER counter) const;
+
+    static const char* Name(COUNTER counter);
+
+private:
+    uint64_t m_values[N_COUNTERS];
+    bool m_available[N_COUNTERS];
+
+#ifdef __linux__
+    int m_fds[N_COUNTERS];
+#else
+    uint64_t m_startCycles;
+    uint64_t m_startPageFaults;
+#endif
+};
@@ -0,0 +1,391 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "Allocator.h"
+#include <stdint.h>
+#include <string.h>
+
+/*
+A heap in a file, mapped into the process, that a later process maps again and resumes with its contents intact
+(warm restart of large in-memory structures instead of reloading and reallocating them).
+
+_ALLOCATOR is a STATIC_PREALLOC Sequential List or Red Black Tree allocator running over the mapped file,
+everything it keeps outside of the file is saved as offsets (AllocatorPersistentState) in the header of the file by Checkpoint().
+The Red Black Tree links are granule offsets already, the Sequential List free list links are pointers,
+they are rebased once when the file doesn't map at the address it was saved at (the old address is asked for first).
+
+    PersistentHeap<RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>> heap("index.heap", 1 * GB);
+    Index* index = (Index*)heap.Root();
+    if (!index) {
+        index = new(heap.Alloc(sizeof(Index), 8)) Index;
+        heap.SetRoot(index);
+    }
+
+Data structures in the heap link with OffsetPtr (self relative) or ToOffset()/FromOffset() (relative to the heap), never raw pointers.
+
+The header carries a clean flag, set by Checkpoint() and by Release() / the destructor (both checkpoint),
+cleared by the first Alloc, Free, Reset, ZeroMem or SetRoot after it.
+A file that isn't clean when it's opened was left by a process that died between two checkpoints,
+its state is stale and the heap is rebuilt empty (REBUILT), as it is when the header or the consistency walk of the heap fails.
+An existing file that doesn't start with the magic of a heap (a mistyped path) is never touched, the heap FAILS instead.
+Checkpoint at quiescent points, no allocation or free may be in flight (the wrapper takes no lock of its own).
+*/
+
+// self relative pointer for structures living in a PersistentHeap (or any mapping), 0 is NULL
+template <typename T>
+class OffsetPtr {
+public:
+    OffsetPtr() : m_offset(0) {}
+    OffsetPtr(T* ptr) { Set(ptr); }
+    OffsetPtr(const OffsetPtr& other) { Set(other.Get()); }
+
+    OffsetPtr& operator=(T* ptr) { Set(ptr); return *this; }
+    OffsetPtr& operator=(const OffsetPtr& other) { Set(other.Get()); return *this; }
+
+    inline T* Get() const { return m_offset ? (T*)((intptr_t)this + m_offset) : NULL; }
+    inline void Set(T* ptr) { m_offset = ptr ? (intptr_t)ptr - (intptr_t)this : 0; }
+
+    T* operator->() const { return Get(); }
+    T& operator*() const { return *Get(); }
+    explicit operator bool() const { return m_offset != 0; }
+
+private:
+    int64_t m_offset;
+};
+
+template <typename _ALLOCATOR>
+class PersistentHeap : public Allocator {
+public:
+    enum STATUS {
+        // new file
+        CREATED,
+        // clean file, the heap is the one the last process checkpointed
+        RESTORED,
+        // existing file that wasn't clean or failed the checks, the heap is empty
+        REBUILT,
+        // the file couldn't be opened or mapped, or isn't a heap, every Alloc fails
+        FAILED
+    };
+
+    // maps path, created (or rebuilt) with a heap of sz bytes, an existing valid file keeps its own size
+    PersistentHeap(const char* path, size_t sz);
+    // checkpoints and unmaps
+    ~PersistentHeap();
+
+    inline void* Alloc(size_t sz, size_t alignment) final;
+    inline void Free(void*&) final;
+    // checkpoints, unmaps & closes the file
+    inline void Release() final;
+    // empty heap, no root
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    inline void Layout() final;
+    inline AllocatorStats GetStats() final;
+    inline bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    inline HeapReport Report() final;
+
+    inline bool Owns(const void* ptr) final;
+    inline void RegisterPages(Allocator* owner = NULL) final;
+    inline void UnregisterPages() final;
+
+    // saves the allocator state, flushes the heap & the file, then marks the file clean
+    void Checkpoint();
+
+    inline STATUS Status() const;
+
+    // the object the application finds its structures from after a restart, NULL until set
+    inline void* Root();
+    inline void SetRoot(void* ptr);
+
+    // heap relative offsets, stable across mappings
+    inline uint64_t ToOffset(const void* ptr) const;
+    inline void* FromOffset(uint64_t offset) const;
+
+    inline _ALLOCATOR& Heap();
+
+private:
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t clean;
+        uint64_t heapSize;
+        uint64_t root;
+        AllocatorPersistentState state;
+    };
+
+    bool _map(size_t fileSize, void* base);
+    bool _verify();
+    void _format();
+    inline void _dirty();
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    Header* m_header;
+    void* m_heapStart;
+    size_t m_heapSize;
+    _ALLOCATOR* m_heap;
+    STATUS m_status;
+
+    static constexpr uint64_t MAGIC = 0x5041454854534550;  // "PERSHEAP"
+    static constexpr uint32_t VERSION = 1;
+    // the heap starts a page into the file
+    static constexpr size_t HEADER_SIZE = 4096;
+    static constexpr uint64_t NIL = AllocatorPersistentState::NIL;
+};
+
+template <typename _ALLOCATOR>
+PersistentHeap<_ALLOCATOR>::PersistentHeap(const char* path, size_t sz) :
+    m_file(INVALID_HANDLE_VALUE), m_mapping(NULL), m_header(NULL), m_heapStart(NULL), m_heapSize(0), m_heap(NULL), m_status(FAILED)
+{
+    m_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return;
+
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+    Header saved;
+    bool valid = false;
+    if (existed) {
+        LARGE_INTEGER fileSize;
+        DWORD nRead = 0;
+        if (!GetFileSizeEx(m_file, &fileSize)) {
+            Release();
+            return;
+        }
+
+        // only an empty file or one of ours is (re)built, anything else (a mistyped path) is left as it is
+        bool ours = ReadFile(m_file, &saved, sizeof(saved), &nRead, NULL) && nRead == sizeof(saved) && saved.magic == MAGIC;
+        if (fileSize.QuadPart && !ours) {
+            Release();
+            return;
+        }
+        existed = fileSize.QuadPart != 0;
+
+        valid = ours && saved.version == VERSION && saved.heapSize + HEADER_SIZE == (uint64_t)fileSize.QuadPart &&
+            (saved.state.head == NIL || saved.state.head < saved.heapSize) &&
+            (saved.state.tail == NIL || saved.state.tail < saved.heapSize) &&
+            (saved.root == NIL || saved.root < saved.heapSize);
+    }
+
+    size_t heapSize = valid ? (size_t)saved.heapSize : sz;
+
+    // the address the heap was saved at first, the free list of a Sequential List allocator doesn't need rebasing then
+    if (!_map(HEADER_SIZE + heapSize, valid ? (void*)((uintptr_t)saved.state.base - HEADER_SIZE) : NULL))
+        return;
+
+    if (valid && saved.clean) {
+        // adopting rebases the Sequential List links in the file when it mapped elsewhere,
+        // unclean until the new base is checkpointed, so a crash in between doesn't rebase them twice
+        _dirty();
+        m_heap = new _ALLOCATOR(m_heapStart, m_heapSize, m_header->state);
+        if (_verify()) {
+            Checkpoint();
+            m_status = RESTORED;
+            return;
+        }
+        delete m_heap;
+        m_heap = NULL;
+    }
+
+    _format();
+    m_status = existed ? REBUILT : CREATED;
+}
+
+template <typename _ALLOCATOR>
+PersistentHeap<_ALLOCATOR>::~PersistentHeap() {
+    Release();
+}
+
+template <typename _ALLOCATOR>
+bool PersistentHeap<_ALLOCATOR>::_map(size_t fileSize, void* base) {
+    LARGE_INTEGER size;
+    size.QuadPart = (int64_t)fileSize;
+    if (!SetFilePointerEx(m_file, size, NULL, FILE_BEGIN) || !SetEndOfFile(m_file))
+        return false;
+
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)fileSize >> 32), (DWORD)fileSize, NULL);
+    if (!m_mapping)
+        return false;
+
+    void* view = base ? MapViewOfFileEx(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0, base) : NULL;
+    if (!view)
+        view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view)
+        return false;
+
+    m_header = (Header*)view;
+    m_heapStart = (void*)((uintptr_t)view + HEADER_SIZE);
+    m_heapSize = fileSize - HEADER_SIZE;
+    return true;
+}
+
+template <typename _ALLOCATOR>
+bool PersistentHeap<_ALLOCATOR>::_verify() {
+    uint64_t nFreeBlocks;
+    return HeapWalkTiles(*m_heap, m_heapSize, nFreeBlocks);
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::_format() {
+    memset(m_header, 0, sizeof(Header));
+    m_header->magic = MAGIC;
+    m_header->version = VERSION;
+    m_header->heapSize = m_heapSize;
+    m_header->root = NIL;
+
+    m_heap = new _ALLOCATOR(m_heapStart, m_heapSize);
+    Checkpoint();
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::_dirty() {
+    // written through before the heap changes, a crash from here on leaves an unclean file
+    if (m_header->clean) {
+        m_header->clean = 0;
+        FlushViewOfFile(m_header, sizeof(Header));
+    }
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::Checkpoint() {
+    if (!m_heap)
+        return;
+
+    m_header->state = m_heap->SaveState();
+
+    // the heap & the state reach the file before the flag does
+    FlushViewOfFile(m_header, 0);
+    FlushFileBuffers(m_file);
+
+    m_header->clean = 1;
+    FlushViewOfFile(m_header, sizeof(Header));
+    FlushFileBuffers(m_file);
+}
+
+template <typename _ALLOCATOR>
+void* PersistentHeap<_ALLOCATOR>::Alloc(size_t sz, size_t alignment) {
+    if (!m_heap)
+        return NULL;
+    _dirty();
+    return m_heap->Alloc(sz, alignment);
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::Free(void*& ptr) {
+    if (!m_heap)
+        return;
+    _dirty();
+    m_heap->Free(ptr);
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::Release() {
+    if (m_heap) {
+        Checkpoint();
+        delete m_heap;
+        m_heap = NULL;
+    }
+    if (m_header) {
+        UnmapViewOfFile(m_header);
+        m_header = NULL;
+        m_heapStart = NULL;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = NULL;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_status = FAILED;
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::Reset() {
+    if (!m_heap)
+        return;
+    _dirty();
+    m_header->root = NIL;
+    m_heap->Reset();
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::ZeroMem() {
+    if (!m_heap)
+        return;
+    _dirty();
+    m_heap->ZeroMem();
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::Layout() {
+    if (m_heap)
+        m_heap->Layout();
+}
+
+template <typename _ALLOCATOR>
+AllocatorStats PersistentHeap<_ALLOCATOR>::GetStats() {
+    return m_heap ? m_heap->GetStats() : AllocatorStats();
+}
+
+template <typename _ALLOCATOR>
+bool PersistentHeap<_ALLOCATOR>::Walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    return m_heap ? m_heap->Walk(cursor, block) : false;
+}
+
+template <typename _ALLOCATOR>
+HeapReport PersistentHeap<_ALLOCATOR>::Report() {
+    return m_heap ? m_heap->Report() : HeapReport();
+}
+
+template <typename _ALLOCATOR>
+bool PersistentHeap<_ALLOCATOR>::Owns(const void* ptr) {
+    return m_heap ? m_heap->Owns(ptr) : false;
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::RegisterPages(Allocator* owner) {
+    if (m_heap)
+        m_heap->RegisterPages(owner ? owner : this);
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::UnregisterPages() {
+    if (m_heap)
+        m_heap->UnregisterPages();
+}
+
+template <typename _ALLOCATOR>
+typename PersistentHeap<_ALLOCATOR>::STATUS PersistentHeap<_ALLOCATOR>::Status() const {
+    return m_status;
+}
+
+template <typename _ALLOCATOR>
+void* PersistentHeap<_ALLOCATOR>::Root() {
+    return m_header ? FromOffset(m_header->root) : NULL;
+}
+
+template <typename _ALLOCATOR>
+void PersistentHeap<_ALLOCATOR>::SetRoot(void* ptr) {
+    if (!m_header)
+        return;
+    _dirty();
+    m_header->root = ToOffset(ptr);
+}
+
+template <typename _ALLOCATOR>
+uint64_t PersistentHeap<_ALLOCATOR>::ToOffset(const void* ptr) const {
+    return ptr ? (uint64_t)((uintptr_t)ptr - (uintptr_t)m_heapStart) : NIL;
+}
+
+template <typename _ALLOCATOR>
+void* PersistentHeap<_ALLOCATOR>::FromOffset(uint64_t offset) const {
+    return offset == NIL ? NULL : (void*)((uintptr_t)m_heapStart + offset);
+}
+
+template <typename _ALLOCATOR>
+_ALLOCATOR& PersistentHeap<_ALLOCATOR>::Heap() {
+    return *m_heap;
+}
@@ -1,21 +1,30 @@
 #include "PoolAllocator.h"
 #include <iostream>
 
-PoolAllocator::PoolAllocator(size_t sz, size_t pgSz) :
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::PoolAllocator(size_t sz, size_t pgSz, bool largePages) :
     m_size(sz), m_pgSize(pgSz),
-    m_preAlloc(false), m_initialized(false)
+    m_preAlloc(false), m_initialized(false), m_largePages(false), m_generations(NULL), m_nSlots(0)
 {
     assert(m_size % m_pgSize == 0);
 
-    m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
+    if (largePages) {
+        m_start = VMLinearAllocator::AllocLargePages(m_size * sizeof(uint8_t));
+        m_largePages = m_start != NULL;
+    }
+    if (!m_largePages)
+        m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
     m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
 
     buildLinkedList();
+    buildGenerations();
 
     m_initialized = true;
 }
 
-void PoolAllocator::Layout() {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Layout() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     for (uintptr_t ptr = (uintptr_t)m_llStart; ptr < (uintptr_t)m_end; ) {
         void* fPgPtr = ((FreePageHeader*)ptr)->ptr;
         std::cout << "Free Page: [" << ptr - (uintptr_t)m_start << " "
@@ -30,9 +39,10 @@ void PoolAllocator::Layout() {
     std::cout << std::endl;
 }
 
-PoolAllocator::PoolAllocator(void* buffer, size_t sz, size_t pgSz) :
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::PoolAllocator(void* buffer, size_t sz, size_t pgSz) :
     m_size(sz), m_pgSize(pgSz),
-    m_preAlloc(true), m_initialized(true)
+    m_preAlloc(true), m_initialized(true), m_largePages(false), m_generations(NULL), m_nSlots(0)
 {
     assert(m_size % m_pgSize == 0);
 
@@ -40,15 +50,22 @@ PoolAllocator::PoolAllocator(void* buffer, size_t sz, size_t pgSz) :
     m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
 
     buildLinkedList();
+    buildGenerations();
 }
 
-PoolAllocator::~PoolAllocator() {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::~PoolAllocator() {
+    free(m_generations);
     if (m_preAlloc || !m_initialized)
         return;
-    free(m_start);
+    if (m_largePages)
+        VMLinearAllocator::FreeLargePages(m_start);
+    else
+        free(m_start);
 }
 
-void PoolAllocator::buildLinkedList() {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::buildLinkedList() {
     FreePageHeader header;
 
     for (uintptr_t ptr = (uintptr_t)m_start; ptr <= (uintptr_t)m_end - 2*m_pgSize; ) {
@@ -64,16 +81,44 @@ void PoolAllocator::buildLinkedList() {
     m_llStart = m_start;
 }
 
-void* PoolAllocator::Alloc(size_t sz, size_t alignment) {
-    if (!m_initialized || !m_llStart)
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::buildGenerations() {
+    if constexpr(std::is_same<_HANDLE_POLICY, ALLOC_HANDLES_GENERATIONAL>::value) {
+        // the slots past the index range have no generation, AllocHandle & ToHandle refuse them
+        m_nSlots = m_size / m_pgSize;
+        if (m_nSlots > (size_t)INDEX_MASK + 1)
+            m_nSlots = (size_t)INDEX_MASK + 1;
+
+        // generation 1, 0 is left out so no handle is 0
+        m_generations = (uint16_t*)malloc(m_nSlots * sizeof(uint16_t));
+        for (size_t i = 0; i < m_nSlots; ++i)
+            m_generations[i] = 1;
+    }
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void* PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Alloc(size_t sz, size_t alignment) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    return _alloc(sz, alignment);
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void* PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::_alloc(size_t sz, size_t alignment) {
+    if (!m_initialized || !m_llStart) {
+        _statsFail(sz);
         return nullptr;
+    }
 
     assert((alignment & (alignment - 1)) == 0);
     
     // If you need to MALLOC_N multiple pages,
     // Use SequentialListAllocator where every allocation is an integer multiple of some page size.
     // This allocator is designed for low overhead and simplicity.
-    assert(sz <= m_pgSize); 
+    // Fails rather than asserts, so a FallbackAllocator can hand the request to its secondary.
+    if (sz > m_pgSize) {
+        _statsFail(sz);
+        return nullptr;
+    }
 
     void* ptr = std::align(alignment, sz, m_llStart, m_pgSize);
 
@@ -84,35 +129,117 @@ void* PoolAllocator::Alloc(size_t sz, size_t alignment) {
 
     m_llStart = ((FreePageHeader*)m_llStart)->ptr;
 
+    _statsAlloc(sz, m_pgSize);
+
     return ptr;
 }
 
-void PoolAllocator::Free(void*& ptr) {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Free(void*& ptr) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     if (!ptr)
         return;
+    _free(ptr);
+    ptr = NULL;
+}
 
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::_free(void* ptr) {
     // shift the ptr back to the page boundary
     if (((uintptr_t)ptr - (uintptr_t)m_start) % m_pgSize > 0) {
         ptr = (void*) ((((uintptr_t)ptr - (uintptr_t)m_start) / m_pgSize) * m_pgSize + (uintptr_t)m_start);
     }
 
+    if constexpr(std::is_same<_HANDLE_POLICY, ALLOC_HANDLES_GENERATIONAL>::value) {
+        size_t index = ((uintptr_t)ptr - (uintptr_t)m_start) / m_pgSize;
+        if (index < m_nSlots)
+            _bumpGeneration(index);
+    }
+
     FreePageHeader* header = new(ptr) FreePageHeader;
     header->ptr = m_llStart;
     m_llStart = ptr;
-    ptr = NULL;
+
+    _statsFree(m_pgSize);
 }
 
-void PoolAllocator::Release() {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+PoolHandle PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::AllocHandle() {
+    assert(m_generations && "HANDLES NEED ALLOC_HANDLES_GENERATIONAL");
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+
+    // the slot on top of the free list is the one _alloc hands out, it has to fit in the index
+    if (m_llStart && ((uintptr_t)m_llStart - (uintptr_t)m_start) / m_pgSize >= m_nSlots) {
+        _statsFail(m_pgSize);
+        return 0;
+    }
+    return ToHandle(_alloc(m_pgSize, 1));
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+bool PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::FreeHandle(PoolHandle handle) {
+    // the compare, the bump & the push under one lock, of two threads freeing the same handle only one gets the slot back
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    void* ptr = Resolve(handle);
+    if (!ptr)
+        return false;
+    _free(ptr);
+    return true;
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Release() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
+    free(m_generations);
+    m_generations = NULL;
+    m_nSlots = 0;
     if (m_preAlloc)
         return;
-    free(m_start);
+    if (m_largePages)
+        VMLinearAllocator::FreeLargePages(m_start);
+    else
+        free(m_start);
     m_initialized = false;
 }
 
-void PoolAllocator::Reset() {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Reset() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
     buildLinkedList();
+
+    // every slot is free again, the handles to them go stale
+    for (size_t i = 0; i < m_nSlots; ++i)
+        _bumpGeneration(i);
 }
 
-void PoolAllocator::ZeroMem() {
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::ZeroMem() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     memset(m_start, 0, m_size);
 }
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+bool PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::RegisterPages(Allocator* owner) {
+    AllocatorPageMap::Register(m_start, m_size, owner ? owner : this);
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_start, m_size);
+}
+
+template class PoolAllocator<ALLOC_LOCK_NONE>;
+template class PoolAllocator<ALLOC_LOCK_SPIN>;
+template class PoolAllocator<ALLOC_LOCK_MUTEX>;
+template class PoolAllocator<ALLOC_LOCK_TICKET>;
+template class PoolAllocator<ALLOC_LOCK_NONE, ALLOC_HANDLES_GENERATIONAL>;
+template class PoolAllocator<ALLOC_LOCK_SPIN, ALLOC_HANDLES_GENERATIONAL>;
+template class PoolAllocator<ALLOC_LOCK_MUTEX, ALLOC_HANDLES_GENERATIONAL>;
+template class PoolAllocator<ALLOC_LOCK_TICKET, ALLOC_HANDLES_GENERATIONAL>;
@@ -1,15 +1,33 @@
 #pragma once
 
 #include "Allocator.h"
+#include "VMLinearAllocator.h"
+#include "LockPolicy.h"
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <memory>
 
-class PoolAllocator : public Allocator {
+/*
+ALLOC_HANDLES_GENERATIONAL: besides pointers the pool hands out 32 bit handles, a slot index and the generation of the slot,
+
+    PoolHandle h = pool.AllocHandle();
+    Particle* p = (Particle*)pool.Resolve(h);       // NULL once the slot was freed, even if it was handed out again
+
+every free of a slot (pointer or handle) bumps its generation, so a stale handle fails one compare instead of reading a recycled slot.
+Generations live in a side table, 2 bytes per slot, the slots keep their whole size. The index takes the low 20 bits,
+in a larger pool only the first million slots get handles (the others are for Alloc, AllocHandle returns 0 when one is next), the generation the high 12 bits, it skips 0 when it wraps, so 0 is never a valid handle and a handle only aliases after 4095 frees of its slot.
+ALLOC_HANDLES_NONE (default): pointers only, no table.
+*/
+
+typedef uint32_t PoolHandle;
+
+template <typename _LOCK_POLICY = ALLOC_LOCK_NONE, typename _HANDLE_POLICY = ALLOC_HANDLES_NONE>
+class PoolAllocator : public Allocator, protected AllocatorLock<_LOCK_POLICY> {
 public:
-    PoolAllocator(size_t sz, size_t pgSz);
+    // largePages: back the buffer with large pages when the process is allowed to, malloc otherwise
+    PoolAllocator(size_t sz, size_t pgSz, bool largePages = false);
     PoolAllocator(void* buffer, size_t sz, size_t pgSz);
     ~PoolAllocator();
 
@@ -20,6 +38,26 @@ public:
     inline void ZeroMem() final;
     inline void Layout() final;
 
+    // ptr lies in the buffer
+    bool Owns(const void* ptr) final;
+    // maps the buffer in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    // a whole slot, aligned as the slots are, 0 when the pool is full or the next free slot is past the handle index range
+    PoolHandle AllocHandle();
+    // false for a stale handle, nothing is freed
+    bool FreeHandle(PoolHandle handle);
+
+    // the slot, NULL for a stale handle, doesn't take the lock
+    inline void* Resolve(PoolHandle handle) const;
+    inline bool IsValid(PoolHandle handle) const;
+    // handle of the live slot ptr lies in, 0 past the handle index range
+    inline PoolHandle ToHandle(const void* ptr) const;
+
+    static constexpr uint32_t INDEX_BITS = 20;
+    static constexpr uint32_t GENERATION_BITS = 32 - INDEX_BITS;
+
 protected:
     struct FreePageHeader {
         void* ptr;
@@ -27,6 +65,12 @@ protected:
 
 private:
     void buildLinkedList();
+    void buildGenerations();
+    // Alloc & Free without the lock
+    void* _alloc(size_t sz, size_t alignment);
+    void _free(void* ptr);
+    // every handle to the slot goes stale
+    inline void _bumpGeneration(size_t index);
 
     void* m_start;
     void* m_end;
@@ -35,4 +79,42 @@ private:
     size_t m_pgSize;
     bool m_initialized;
     bool m_preAlloc;
+    bool m_largePages;
+
+    // generation of every slot, ALLOC_HANDLES_GENERATIONAL only, NULL & 0 slots otherwise so every handle is stale
+    uint16_t* m_generations;
+    size_t m_nSlots;
+
+    static constexpr uint32_t INDEX_MASK = ((uint32_t)1 << INDEX_BITS) - 1;
+    static constexpr uint32_t GENERATION_MASK = ((uint32_t)1 << GENERATION_BITS) - 1;
 };
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void* PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::Resolve(PoolHandle handle) const {
+    size_t index = handle & INDEX_MASK;
+    if (index >= m_nSlots || m_generations[index] != handle >> INDEX_BITS)
+        return NULL;
+    return (void*)((uintptr_t)m_start + index * m_pgSize);
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+bool PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::IsValid(PoolHandle handle) const {
+    return Resolve(handle) != NULL;
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+PoolHandle PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::ToHandle(const void* ptr) const {
+    // no table, ALLOC_HANDLES_NONE
+    if (!ptr || !m_nSlots)
+        return 0;
+    size_t index = ((uintptr_t)ptr - (uintptr_t)m_start) / m_pgSize;
+    if (index >= m_nSlots)
+        return 0;
+    return ((PoolHandle)m_generations[index] << INDEX_BITS) | (PoolHandle)index;
+}
+
+template <typename _LOCK_POLICY, typename _HANDLE_POLICY>
+void PoolAllocator<_LOCK_POLICY, _HANDLE_POLICY>::_bumpGeneration(size_t index) {
+    uint16_t generation = (m_generations[index] + 1) & GENERATION_MASK;
+    m_generations[index] = generation ? generation : 1;
+}
@@ -1,47 +1,109 @@
 #include "RBTreeAllocator.h"
 
-RBTreeAllocator::Node* RBTreeAllocator::Node::sibling() {
-    if (this->parent) {
-        if (this->parent->left == this)
-            return this->parent->right;
-        else
-            return this->parent->left;
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::RBTreeAllocator(size_t sz) :
+    m_size(sz), m_initialized(false), m_root(NULL), m_start(NULL), m_end(NULL),
+    m_vmAllocator(NULL), m_nVMPages(0)
+{
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
+        m_size &= ~(GRANULE - 1);
+        m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        m_initialized = true;
+        build();
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        m_vmAllocator = new VMLinearAllocator(RESERVE_VIRTUAL_ADDRESS_SPACE);
+
+        uint32_t vmPageSize = m_vmAllocator->PageSize();
+        uint32_t n = (uint32_t)ceil((double)sz / vmPageSize);
+        size_t vmAllocSize = (size_t)n * vmPageSize;
+
+        m_start = m_vmAllocator->Alloc(n);
+        m_end = (void*)((uintptr_t)m_start + vmAllocSize);
+        m_size = vmAllocSize;
+        m_nVMPages = n;
+        m_initialized = true;
+        build();
+    }
+    else {
+        assert(false && "BUFFER WASN'T PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
     }
-    return NULL;
 }
 
-RBTreeAllocator::RBTreeAllocator(size_t sz): m_size(sz), m_initialized(false), m_root(NULL), m_start(NULL), m_end(NULL)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::RBTreeAllocator(void* buffer, size_t sz) :
+    m_size(sz), m_initialized(true), m_root(NULL), m_start(NULL), m_end(NULL),
+    m_vmAllocator(NULL), m_nVMPages(0)
 {
-    // only STATIC mode for now,
-    // once the data structure is working, it's quite easy to port PREALLOC & VMDYNAMIC modes
-    m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
-    m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
-    m_initialized = true;
-    build();
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+        assert((uintptr_t)buffer % GRANULE == 0);
+        m_size &= ~(GRANULE - 1);
+        m_start = buffer;
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        build();
+    }
+    else {
+        assert(false && "BUFFER PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
 }
 
-RBTreeAllocator::~RBTreeAllocator()
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::RBTreeAllocator(void* buffer, size_t sz, const AllocatorPersistentState& state) :
+    m_size(sz), m_initialized(true), m_root(NULL), m_start(NULL), m_end(NULL),
+    m_vmAllocator(NULL), m_nVMPages(0)
 {
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+        assert((uintptr_t)buffer % GRANULE == 0);
+        m_size &= ~(GRANULE - 1);
+        m_start = buffer;
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        LoadState(state);
+    }
+    else {
+        assert(false && "BUFFER PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
 }
 
-void RBTreeAllocator::build() {
-    m_root = new(m_start) Node{NULL, NULL, NULL, COLOR::BLACK, m_size, NULL, NULL};
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::~RBTreeAllocator()
+{
+    if (m_initialized)
+        Release();
+    if (m_vmAllocator)
+        delete m_vmAllocator;
 }
 
-size_t RBTreeAllocator::_splitBlock(void* block, void* ptr, size_t sz) {
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::build() {
+    assert(m_size <= MAX_ARENA_SIZE);
+
+    m_root = new(m_start) Node{NIL, NIL, NIL, 0};
+    _setSize(m_root, m_size);
+    _setColor(m_root, COLOR::BLACK);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+size_t RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_splitBlock(void* block, void* ptr, size_t sz) {
     Node* blockHeader = (Node*)block;
 
-    ptrdiff_t remainingSpace = (uintptr_t)block + blockHeader->sz - (uintptr_t)ptr - sz;
+    size_t blockSize = _size(blockHeader);
+    ptrdiff_t remainingSpace = (uintptr_t)block + blockSize - (uintptr_t)ptr - sz;
 
     _deleteNode((Node*)block);
 
-    if (remainingSpace >= freeHeaderSize) {
+    if (remainingSpace >= (ptrdiff_t)minBlockSize) {
         // create a new free block
         void* newBlock = (void*)((uintptr_t)ptr + sz);
 
         Node* newNode = new(newBlock) Node;
-        size_t freeBlockSize = blockHeader->sz - ((uintptr_t)ptr - (uintptr_t)block + sz);
-        newNode->sz = freeBlockSize;
+        size_t freeBlockSize = blockSize - ((uintptr_t)ptr - (uintptr_t)block + sz);
 
         _rbtreeInsert(m_root, newNode, freeBlockSize);
 
@@ -49,13 +111,14 @@ size_t RBTreeAllocator::_splitBlock(void* block, void* ptr, size_t sz) {
     }
     else {
         // cant create a new free block because remaining space is not large enough for header
-        return (uintptr_t)blockHeader->sz - (uintptr_t)ptr + (uintptr_t)block;
+        return blockSize - (uintptr_t)ptr + (uintptr_t)block;
     }
 
     return 0;
 }
 
-void RBTreeAllocator::_fitPadding(ptrdiff_t& padding, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_fitPadding(ptrdiff_t& padding, size_t alignment) {
     // if can't fit header into the padding
     if (padding < allocHeaderSize) {
         if ((allocHeaderSize - padding) % alignment == 0) {
@@ -67,39 +130,98 @@ void RBTreeAllocator::_fitPadding(ptrdiff_t& padding, size_t alignment) {
     }
 }
 
-void* RBTreeAllocator::_fitToBlock(
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_fitToBlock(
     void* block, size_t sz, size_t alignment, ptrdiff_t& leftover, ptrdiff_t& padding)
 {
     void* ptr = (void*)(((uintptr_t)block + alignment - 1) & ~(alignment - 1));
     padding = (uintptr_t)ptr - (uintptr_t)block;
     _fitPadding(padding, alignment);
     ptr = (void*)((uintptr_t)block + padding);
-    leftover = (ptrdiff_t)((Node*)block)->sz - (padding + sz);
+    leftover = (ptrdiff_t)_size((Node*)block) - (padding + sz);
     return ptr;
 }
 
-void * RBTreeAllocator::Alloc(size_t sz, size_t alignment)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void * RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Alloc(size_t sz, size_t alignment)
 {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     assert((alignment & (alignment - 1)) == 0);
 
+    // no block is larger than the arena, this also keeps the rounding below from wrapping
+    if (sz > MAX_ARENA_SIZE) {
+        _statsFail(sz);
+        return NULL;
+    }
+
+    // keep the blocks granule aligned
+    sz = (sz + GRANULE - 1) & ~(GRANULE - 1);
+
     Node* block = NULL;
     ptrdiff_t padding;
 
     void* ptr = _rbtreeStrictBestFit(m_root, sz, alignment, block, padding);
 
+    if (!ptr) {
+        if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+            ptr = _VMDYNAMIC_VMEXPAND(sz, alignment, block, padding);
+        }
+        if (!ptr) {
+            _statsFail(sz);
+            return NULL;
+        }
+    }
+
     AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)ptr - allocHeaderSize)) AllocatedBlockHeader;
     allocHeader->sz = _splitBlock(block, ptr, sz);
     allocHeader->padding = padding;
+    *(size_t*)block = padding;
+
+    _statsAlloc(sz, allocHeader->sz);
 
     return ptr;
 }
 
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_VMDYNAMIC_VMEXPAND(size_t sz, size_t alignment, Node*& block, ptrdiff_t& padding)
+{
+    // no free block was large enough
+    // commit new pages at the end of the arena and insert them to the tree as a new free block
+    uint32_t vmPageSize = m_vmAllocator->PageSize();
+
+    void* ptr = (void*)(((uintptr_t)m_end + alignment - 1) & ~(alignment - 1));
+    padding = (uintptr_t)ptr - (uintptr_t)m_end;
+    _fitPadding(padding, alignment);
+
+    uint32_t n = (uint32_t)ceil((double)(padding + sz) / vmPageSize);
+    size_t vmAllocSize = (size_t)n * vmPageSize;
+
+    void* vmAlloc = m_vmAllocator->Alloc(n);
+    // out of address space, or the pages didn't land right after the arena
+    if (vmAlloc != m_end) {
+        if (vmAlloc)
+            m_vmAllocator->Shrink(n);
+        return NULL;
+    }
+
+    block = new(vmAlloc) Node;
+    _rbtreeInsert(m_root, block, vmAllocSize);
+
+    m_end = (void*)((uintptr_t)m_end + vmAllocSize);
+    m_size += vmAllocSize;
+    m_nVMPages += n;
+
+    return (void*)((uintptr_t)block + padding);
+}
+
 /*
 * Currently, we don't coalesce the free blocks
 */
 
-void RBTreeAllocator::Free(void*& ptr)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Free(void*& ptr)
 {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     if (!ptr)
         return;
 
@@ -107,166 +229,364 @@ void RBTreeAllocator::Free(void*& ptr)
     size_t allocSize = allocHeader->sz;
     size_t allocPadding = allocHeader->padding;
 
+    _statsFree(allocSize);
+
     void* freeHeaderPtr = (void*)((uintptr_t)ptr - allocPadding);
 
     Node* newNode = new(freeHeaderPtr) Node;
     size_t freeBlockSize = allocSize + allocPadding;
-    newNode->sz = freeBlockSize;
 
     _rbtreeInsert(m_root, newNode, freeBlockSize);
 }
 
-inline void RBTreeAllocator::Release()
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+inline void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Release()
 {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        m_vmAllocator->Release();
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
+        free(m_start);
+    }
+    m_initialized = false;
+    m_root = NULL;
 }
 
-inline void RBTreeAllocator::Reset()
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+inline void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Reset()
 {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
+    build();
 }
 
-inline void RBTreeAllocator::ZeroMem()
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+inline void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::ZeroMem()
 {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    memset(m_start, 0, m_size);
 }
 
-void RBTreeAllocator::Layout()
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+bool RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Owns(const void* ptr)
 {
-    int i = 0, l;
-    GPCL::pair<Node*, int> stack[64];
-    stack[0] = GPCL::make_pair(m_root, 0);
-
-    Node* cur;
-    Node* temp;
-
-    while (i >= 0) {
-        cur = stack[i].first;
-        l = stack[i--].second;
-        if (!cur)
-            continue;
-        for (int j = 0; j < l; ++j)
-            std::cout << " ";
-        std::cout << cur->sz << " | " << (void*)cur << " | ";
-        //printf("%d | %p | ", cur->key, (void*)cur);
-
-        temp = cur->llNext;
-        while (temp) {
-            std::cout << cur->sz << " | " << (void*)cur << " | ";
-            //printf("%d | %p | ", cur->key, (void*)cur);
-            temp = temp->llNext;
-        }
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::RegisterPages(Allocator* owner)
+{
+    // VMDYNAMIC: the whole reservation, pages committed later are covered too
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Register(m_start, sz, owner ? owner : this);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::UnregisterPages()
+{
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Unregister(m_start, sz);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Layout()
+{
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    std::cout << ((uintptr_t)m_end - (uintptr_t)m_start) << "\nNum of committed VM pages: " << m_nVMPages << "\n";
+
+    while (_walk(cursor, block)) {
+        _layoutBlock(block);
+        report.Add(block);
+    }
+
+    _layoutReport(report);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+bool RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Walk(HeapWalkCursor& cursor, HeapBlock& block)
+{
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    return _walk(cursor, block);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+HeapReport RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Report()
+{
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
 
-        std::cout << "\n";
+    while (_walk(cursor, block))
+        report.Add(block);
 
-        stack[++i] = GPCL::make_pair(cur->left, l + 1);
-        stack[++i] = GPCL::make_pair(cur->right, l + 1);
+    return report;
+}
+
+/*
+* Blocks tile the arena (free blocks aren't coalesced, neighbours can both be free).
+* A block is free if the tree has a node at its address, looked up with the size the node would hold,
+* a used block has its padding in the first word and the header behind it has the size.
+*/
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+AllocatorPersistentState RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::SaveState() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+
+    AllocatorPersistentState state;
+    state.base = (uint64_t)(uintptr_t)m_start;
+    state.head = m_root ? (uint64_t)((uintptr_t)m_root - (uintptr_t)m_start) : AllocatorPersistentState::NIL;
+    state.tail = AllocatorPersistentState::NIL;
+    return state;
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::LoadState(const AllocatorPersistentState& state) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    m_root = state.head == AllocatorPersistentState::NIL ? NULL : (Node*)((uintptr_t)m_start + state.head);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+bool RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::VerifyTree(uint64_t& nNodes) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    nNodes = 0;
+    if (m_root && _color(m_root) != BLACK)
+        return false;
+    return _rbtreeVerify(m_root, NULL, NULL, NULL, 0, nNodes) >= 0;
+}
+
+// black height of the subtree, -1 if it's broken,
+// lo & hi bound the keys of the subtree, a loop can't keep inside them, the depth & node count bound the rest
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+int32_t RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeVerify(Node* node, Node* parent, Node* lo, Node* hi, uint32_t depth, uint64_t& nNodes) {
+    if (!node)
+        return 1;
+
+    // checked before the node is read
+    uintptr_t addr = (uintptr_t)node;
+    if (addr < (uintptr_t)m_start || addr + sizeof(Node) > (uintptr_t)m_end || (addr - (uintptr_t)m_start) % GRANULE ||
+        depth > MAX_DEPTH || ++nNodes > m_size / minBlockSize)
+        return -1;
+
+    size_t sz = _size(node);
+    if (sz < minBlockSize || sz > (uintptr_t)m_end - addr || _parent(node) != parent)
+        return -1;
+    if ((lo && !_rbtreeKeyLess(_size(lo), lo, node)) || (hi && !_rbtreeKeyLess(sz, node, hi)))
+        return -1;
+    if (parent && _color(parent) == RED && _color(node) == RED)
+        return -1;
+
+    int32_t leftHeight = _rbtreeVerify(_left(node), node, lo, node, depth + 1, nNodes);
+    int32_t rightHeight = leftHeight < 0 ? -1 : _rbtreeVerify(_right(node), node, node, hi, depth + 1, nNodes);
+    if (rightHeight < 0 || leftHeight != rightHeight)
+        return -1;
+
+    return leftHeight + (_color(node) == BLACK ? 1 : 0);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+bool RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_walk(HeapWalkCursor& cursor, HeapBlock& block)
+{
+    if (!m_initialized)
+        return false;
+
+    if (!cursor.block)
+        cursor.block = m_start;
+
+    uintptr_t cur = (uintptr_t)cursor.block;
+    if (cur >= (uintptr_t)m_end)
+        return false;
+
+    if (_rbtreeContains((Node*)cur)) {
+        block.size = _size((Node*)cur);
+        block.free = true;
+        block.padding = 0;
+    }
+    else {
+        size_t padding = *(size_t*)cur;
+        block.size = padding + ((AllocatedBlockHeader*)(cur + padding - allocHeaderSize))->sz;
+        block.free = false;
+        block.padding = padding;
     }
 
-    std::cout << std::endl;
+    block.offset = cur - (uintptr_t)m_start;
+    cursor.block = (void*)(cur + block.size);
+    return true;
 }
 
-RBTreeAllocator::Node* RBTreeAllocator::_rbtreeInsert(Node*& root, Node* node, size_t key) {
-    node->sz = key;
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_node(uint32_t offset) {
+    if (offset == NIL)
+        return NULL;
+    return (Node*)((uintptr_t)m_start + ((uintptr_t)offset << GRANULE_SHIFT));
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+uint32_t RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_offset(Node* node) {
+    if (!node)
+        return NIL;
+    return (uint32_t)(((uintptr_t)node - (uintptr_t)m_start) >> GRANULE_SHIFT);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_parent(Node* node) {
+    return _node(node->parent);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_left(Node* node) {
+    return _node(node->left);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_right(Node* node) {
+    return _node(node->right);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_sibling(Node* node) {
+    Node* parent = _parent(node);
+    if (parent) {
+        if (_left(parent) == node)
+            return _right(parent);
+        else
+            return _left(parent);
+    }
+    return NULL;
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_setParent(Node* node, Node* parent) {
+    node->parent = _offset(parent);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_setLeft(Node* node, Node* left) {
+    node->left = _offset(left);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_setRight(Node* node, Node* right) {
+    node->right = _offset(right);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::COLOR RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_color(Node* node) {
+    return (COLOR)(node->szColor & 1);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_setColor(Node* node, COLOR color) {
+    node->szColor = (node->szColor & ~1u) | (uint32_t)color;
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+size_t RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_size(const Node* node) {
+    return (size_t)(node->szColor >> 1) << GRANULE_SHIFT;
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_setSize(Node* node, size_t sz) {
+    assert(sz % GRANULE == 0);
+    node->szColor = (uint32_t)((sz >> GRANULE_SHIFT) << 1) | (node->szColor & 1);
+}
+
+// free blocks are ordered by (size, address),
+// so among the blocks of the same size, best fit returns the one with the lowest address
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+bool RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeKeyLess(size_t key, const Node* node, const Node* cur) {
+    size_t curKey = _size(cur);
+    return key < curKey || (key == curKey && node < cur);
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeInsert(Node*& root, Node* node, size_t key) {
+    node->szColor = 0;
+    _setSize(node, key);
 
     Node* cur = root;
     Node* parent = NULL;
 
     while (cur) {
         parent = cur;
-        if (key > cur->sz) {
-            cur = cur->right;
-        }
-        else if (key < cur->sz) {
-            cur = cur->left;
-        }
-        else {
-            node->parent = cur->parent;
-            node->left = cur->left;
-            node->right = cur->right;
-            node->color = cur->color;
-            node->llPrev = NULL;
-            node->llNext = cur;
-            cur->llPrev = node;
-
-            if (cur->parent) {
-                if (cur == cur->parent->left)
-                    cur->parent->left = node;
-                else
-                    cur->parent->right = node;
-            }
-
-            if (cur->left)
-                cur->left->parent = node;
-            if (cur->right)
-                cur->right->parent = node;
-
-            return node;
-        }
+        if (_rbtreeKeyLess(key, node, cur))
+            cur = _left(cur);
+        else
+            cur = _right(cur);
     }
 
-    node->parent = parent;
-    node->left = NULL;
-    node->right = NULL;
-    node->llPrev = NULL;
-    node->llNext = NULL;
+    _setParent(node, parent);
+    node->left = NIL;
+    node->right = NIL;
 
     if (!parent) {
         root = node;
-        node->color = COLOR::BLACK;
+        _setColor(node, COLOR::BLACK);
         return node;
     }
 
-    node->color = COLOR::RED;
+    _setColor(node, COLOR::RED);
 
-    if (key > parent->sz) {
-        parent->right = node;
+    if (_rbtreeKeyLess(key, node, parent)) {
+        _setLeft(parent, node);
     }
     else {
-        parent->left = node;
+        _setRight(parent, node);
     }
 
-    if (parent->parent)
+    if (_parent(parent))
         _rbtreeFixup(root, node);
 
     return node;
 }
 
-void RBTreeAllocator::_rbtreeFixup(Node *&root, Node *&pt)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeFixup(Node *&root, Node *&pt)
 {
     Node *parent_pt = NULL;
     Node *grand_parent_pt = NULL;
 
-    while ((pt != root) && (pt->color != COLOR::BLACK) &&
-        (pt->parent->color == COLOR::RED))
+    while ((pt != root) && (_color(pt) != COLOR::BLACK) &&
+        (_color(_parent(pt)) == COLOR::RED))
     {
-        parent_pt = pt->parent;
-        grand_parent_pt = pt->parent->parent;
+        parent_pt = _parent(pt);
+        grand_parent_pt = _parent(parent_pt);
 
-        if (parent_pt == grand_parent_pt->left)
+        if (parent_pt == _left(grand_parent_pt))
         {
 
-            Node *uncle_pt = grand_parent_pt->right;
+            Node *uncle_pt = _right(grand_parent_pt);
 
-            if (uncle_pt != NULL && uncle_pt->color == COLOR::RED)
+            if (uncle_pt != NULL && _color(uncle_pt) == COLOR::RED)
             {
-                grand_parent_pt->color = COLOR::RED;
-                parent_pt->color = COLOR::BLACK;
-                uncle_pt->color = COLOR::BLACK;
+                _setColor(grand_parent_pt, COLOR::RED);
+                _setColor(parent_pt, COLOR::BLACK);
+                _setColor(uncle_pt, COLOR::BLACK);
                 pt = grand_parent_pt;
             }
 
             else
             {
-                if (pt == parent_pt->right)
+                if (pt == _right(parent_pt))
                 {
                     _rbtreeRotateLeft(root, parent_pt);
                     pt = parent_pt;
-                    parent_pt = pt->parent;
+                    parent_pt = _parent(pt);
                 }
 
                 _rbtreeRotateRight(root, grand_parent_pt);
 
-                COLOR t = parent_pt->color;
-                parent_pt->color = grand_parent_pt->color;
-                grand_parent_pt->color = t;
+                COLOR t = _color(parent_pt);
+                _setColor(parent_pt, _color(grand_parent_pt));
+                _setColor(grand_parent_pt, t);
 
                 pt = parent_pt;
             }
@@ -274,157 +594,152 @@ void RBTreeAllocator::_rbtreeFixup(Node *&root, Node *&pt)
 
         else
         {
-            Node *uncle_pt = grand_parent_pt->left;
+            Node *uncle_pt = _left(grand_parent_pt);
 
-            if ((uncle_pt != NULL) && (uncle_pt->color == COLOR::RED))
+            if ((uncle_pt != NULL) && (_color(uncle_pt) == COLOR::RED))
             {
-                grand_parent_pt->color = COLOR::RED;
-                parent_pt->color = COLOR::BLACK;
-                uncle_pt->color = COLOR::BLACK;
+                _setColor(grand_parent_pt, COLOR::RED);
+                _setColor(parent_pt, COLOR::BLACK);
+                _setColor(uncle_pt, COLOR::BLACK);
                 pt = grand_parent_pt;
             }
             else
             {
-                if (pt == parent_pt->left)
+                if (pt == _left(parent_pt))
                 {
                     _rbtreeRotateRight(root, parent_pt);
                     pt = parent_pt;
-                    parent_pt = pt->parent;
+                    parent_pt = _parent(pt);
                 }
 
                 _rbtreeRotateLeft(root, grand_parent_pt);
 
-                COLOR t = parent_pt->color;
-                parent_pt->color = grand_parent_pt->color;
-                grand_parent_pt->color = t;
+                COLOR t = _color(parent_pt);
+                _setColor(parent_pt, _color(grand_parent_pt));
+                _setColor(grand_parent_pt, t);
 
                 pt = parent_pt;
             }
         }
     }
 
-    root->color = COLOR::BLACK;
+    _setColor(root, COLOR::BLACK);
 }
 
-void RBTreeAllocator::_rbtreeRotateLeft(Node *&root, Node *&pt)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeRotateLeft(Node *&root, Node *&pt)
 {
-    Node *pt_right = pt->right;
+    Node *pt_right = _right(pt);
+    Node *pt_parent = _parent(pt);
 
     pt->right = pt_right->left;
 
-    if (pt->right != NULL)
-        pt->right->parent = pt;
+    if (pt->right != NIL)
+        _setParent(_right(pt), pt);
 
     pt_right->parent = pt->parent;
 
-    if (pt->parent == NULL)
+    if (pt_parent == NULL)
         root = pt_right;
 
-    else if (pt == pt->parent->left)
-        pt->parent->left = pt_right;
+    else if (pt == _left(pt_parent))
+        _setLeft(pt_parent, pt_right);
 
     else
-        pt->parent->right = pt_right;
+        _setRight(pt_parent, pt_right);
 
-    pt_right->left = pt;
-    pt->parent = pt_right;
+    _setLeft(pt_right, pt);
+    _setParent(pt, pt_right);
 }
 
-void RBTreeAllocator::_rbtreeRotateRight(Node *&root, Node *&pt)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeRotateRight(Node *&root, Node *&pt)
 {
-    Node *pt_left = pt->left;
+    Node *pt_left = _left(pt);
+    Node *pt_parent = _parent(pt);
 
     pt->left = pt_left->right;
 
-    if (pt->left != NULL)
-        pt->left->parent = pt;
+    if (pt->left != NIL)
+        _setParent(_left(pt), pt);
 
     pt_left->parent = pt->parent;
 
-    if (pt->parent == NULL)
+    if (pt_parent == NULL)
         root = pt_left;
 
-    else if (pt == pt->parent->left)
-        pt->parent->left = pt_left;
+    else if (pt == _left(pt_parent))
+        _setLeft(pt_parent, pt_left);
 
     else
-        pt->parent->right = pt_left;
+        _setRight(pt_parent, pt_left);
 
-    pt_left->right = pt;
-    pt->parent = pt_left;
+    _setRight(pt_left, pt);
+    _setParent(pt, pt_left);
 }
 
-void RBTreeAllocator::_deleteNode(Node* node)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_deleteNode(Node* node)
 {
-    // node is the head of LL, as all links from adjacent nodes are to the top of the LL
-    // if multiple nodes exist in the LL, just remove the head
-    Node* nextNode = node->llNext;
-    if (nextNode) {
-        // NOTE that in any tree operation, only the head of the LL changes,
-        // thus we'll need to propogate changes to the next node
-        nextNode->llPrev = NULL;
-        nextNode->color = node->color;
-        nextNode->left = node->left;
-        nextNode->right = node->right;
-        nextNode->parent = node->parent;
-
-        // update the parent s.t. it holds a link to the new head
-        if (node->parent) {
-            if (node == node->parent->left)
-                node->parent->left = nextNode;
-            else
-                node->parent->right = nextNode;
-        }
-
-        // update the children
-        if (node->left)
-            node->left->parent = nextNode;
-        if (node->right)
-            node->right->parent = nextNode;
-
-        return;
-    }
-
-    // if cur is the only node with the given key, do a tree deletion
+    // every free block is a tree node of its own, keys are unique
     _rbtreeDelete(node);
-
-    return;
 }
 
-RBTreeAllocator::Node* RBTreeAllocator::_smallestInSubtree(Node* node) {
-    while (node->left)
-        node = node->left;
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_smallestInSubtree(Node* node) {
+    while (node->left != NIL)
+        node = _left(node);
     return node;
 }
 
-RBTreeAllocator::Node* RBTreeAllocator::_BSTSubst(Node* node) {
-    if (node->left && node->right)
-        return _smallestInSubtree(node->right);
-    if (!node->left && !node->right)
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeSuccessor(Node* node) {
+    if (node->right != NIL)
+        return _smallestInSubtree(_right(node));
+
+    Node* parent = _parent(node);
+    while (parent && node == _right(parent)) {
+        node = parent;
+        parent = _parent(parent);
+    }
+    return parent;
+}
+
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+typename RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::Node* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_BSTSubst(Node* node) {
+    Node* left = _left(node);
+    Node* right = _right(node);
+
+    if (left && right)
+        return _smallestInSubtree(right);
+    if (!left && !right)
         return NULL;
 
-    if (node->left)
-        return node->left;
+    if (left)
+        return left;
     else
-        return node->right;
+        return right;
 }
 
-void RBTreeAllocator::_rbtreeFixDoubleBlack(Node* node) {
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeFixDoubleBlack(Node* node) {
     if (node == m_root)
         return;
 
-    Node* parent = node->parent;
-    Node* sibling = node->sibling();
+    Node* parent = _parent(node);
+    Node* sibling = _sibling(node);
 
     if (!sibling) {
         _rbtreeFixDoubleBlack(parent);
     }
     else {
-        bool siblingOnLeft = sibling->parent->left == sibling;
+        bool siblingOnLeft = _left(parent) == sibling;
+        Node* siblingLeft = _left(sibling);
+        Node* siblingRight = _right(sibling);
 
-        if (sibling->color == COLOR::RED) {
-            parent->color = COLOR::RED;
-            sibling->color = COLOR::BLACK;
+        if (_color(sibling) == COLOR::RED) {
+            _setColor(parent, COLOR::RED);
+            _setColor(sibling, COLOR::BLACK);
             if (siblingOnLeft) {
                 _rbtreeRotateRight(m_root, parent);
             }
@@ -434,50 +749,51 @@ void RBTreeAllocator::_rbtreeFixDoubleBlack(Node* node) {
             _rbtreeFixDoubleBlack(node);
         }
         else {
-            if ((sibling->left && sibling->left->color == COLOR::RED) ||
-                (sibling->right && sibling->right->color == COLOR::RED)) {
+            if ((siblingLeft && _color(siblingLeft) == COLOR::RED) ||
+                (siblingRight && _color(siblingRight) == COLOR::RED)) {
 
-                if (!sibling->left && sibling->left->color == COLOR::RED) {
+                if (siblingLeft && _color(siblingLeft) == COLOR::RED) {
                     if (siblingOnLeft) {
-                        sibling->left->color = sibling->color;
-                        sibling->color = parent->color;
+                        _setColor(siblingLeft, _color(sibling));
+                        _setColor(sibling, _color(parent));
                         _rbtreeRotateRight(m_root, parent);
                     }
                     else {
-                        sibling->left->color = parent->color;
+                        _setColor(siblingLeft, _color(parent));
                         _rbtreeRotateRight(m_root, sibling);
                         _rbtreeRotateLeft(m_root, parent);
                     }
                 }
                 else {
                     if (siblingOnLeft) {
-                        sibling->right->color = parent->color;
+                        _setColor(siblingRight, _color(parent));
                         _rbtreeRotateLeft(m_root, sibling);
                         _rbtreeRotateRight(m_root, parent);
                     }
                     else {
-                        sibling->right->color = sibling->color;
-                        sibling->color = parent->color;
+                        _setColor(siblingRight, _color(sibling));
+                        _setColor(sibling, _color(parent));
                         _rbtreeRotateLeft(m_root, parent);
                     }
                 }
-                parent->color = COLOR::BLACK;
+                _setColor(parent, COLOR::BLACK);
             }
             else {
-                sibling->color = COLOR::RED;
-                if (parent->color == COLOR::BLACK)
+                _setColor(sibling, COLOR::RED);
+                if (_color(parent) == COLOR::BLACK)
                     _rbtreeFixDoubleBlack(parent);
                 else
-                    parent->color = COLOR::BLACK;
+                    _setColor(parent, COLOR::BLACK);
             }
         }
     }
 }
 
-void RBTreeAllocator::_rbtreeDelete(Node* node) {
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeDelete(Node* node) {
     Node* subst = _BSTSubst(node);
-    bool bothBlack = ((!subst || subst->color == COLOR::BLACK) && node->color == COLOR::BLACK);
-    Node* parent = node->parent;
+    bool bothBlack = ((!subst || _color(subst) == COLOR::BLACK) && _color(node) == COLOR::BLACK);
+    Node* parent = _parent(node);
 
     if (!subst) {
         // subst NULL => node must be leaf
@@ -489,37 +805,39 @@ void RBTreeAllocator::_rbtreeDelete(Node* node) {
                 _rbtreeFixDoubleBlack(node);
             }
             else {
-                Node* sibling = node->sibling();
+                Node* sibling = _sibling(node);
                 if (sibling)
-                    sibling->color = COLOR::RED;
+                    _setColor(sibling, COLOR::RED);
             }
 
-            if (parent->left == node)
-                parent->left = NULL;
+            if (_left(parent) == node)
+                parent->left = NIL;
             else
-                parent->right = NULL;
+                parent->right = NIL;
         }
         return;
     }
 
-    if (!node->left || !node->right) {
+    if (node->left == NIL || node->right == NIL) {
         // node has 1 child
         if (node == m_root) {
             m_root = subst;
+            subst->parent = NIL;
+            _setColor(subst, COLOR::BLACK);
         }
         else {
             // Detach v from tree and move u up 
-            if (parent->left == node)
-                parent->left = subst;
+            if (_left(parent) == node)
+                _setLeft(parent, subst);
             else
-                parent->right = subst;
+                _setRight(parent, subst);
 
-            subst->parent = parent;
+            _setParent(subst, parent);
 
             if (bothBlack)
                 _rbtreeFixDoubleBlack(subst);
             else
-                subst->color = COLOR::BLACK;
+                _setColor(subst, COLOR::BLACK);
         }
         return;
     }
@@ -530,58 +848,58 @@ void RBTreeAllocator::_rbtreeDelete(Node* node) {
 }
 
 // swap the positions of the nodes in the graph while keeping their addresses consistent
-void RBTreeAllocator::_rbtreeSwapNodes(Node* node, Node* subst) {
-    Node* parent = node->parent;
-
-    Node temp;
-    memcpy(&temp, node, sizeof(Node));
-
-    if (parent->left == node)
-        parent->left = subst;
+// subst is the in-order successor of node, thus it's in the right subtree and has no left child
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeSwapNodes(Node* node, Node* subst) {
+    Node* parent = _parent(node);
+    Node* substParent = _parent(subst);
+    Node* substRight = _right(subst);
+
+    COLOR t = _color(node);
+    _setColor(node, _color(subst));
+    _setColor(subst, t);
+
+    _setParent(subst, parent);
+    if (!parent)
+        m_root = subst;
+    else if (_left(parent) == node)
+        _setLeft(parent, subst);
     else
-        parent->right = subst;
-
-    if (subst->left)
-        subst->left->parent = node;
-    if (subst->right)
-        subst->right->parent = node;
+        _setRight(parent, subst);
 
-    node->parent = subst;
-    node->left = subst->left;
-    node->right = subst->right;
+    subst->left = node->left;
+    _setParent(_left(subst), subst);
 
-
-    subst->parent = temp.parent;
-    if (temp.left == subst) {
-        subst->left = node;
-        subst->right = temp.right;
-        temp.right->parent = subst;
+    if (substParent == node) {
+        _setRight(subst, node);
+        _setParent(node, subst);
     }
     else {
-        subst->right = node;
-        subst->left = temp.left;
-        temp.left->parent = subst;
+        subst->right = node->right;
+        _setParent(_right(subst), subst);
+        _setLeft(substParent, node);
+        _setParent(node, substParent);
     }
+
+    node->left = NIL;
+    _setRight(node, substRight);
+    if (substRight)
+        _setParent(substRight, node);
 }
 
-RBTreeAllocator::Node* RBTreeAllocator::_rbtreeFindKey(size_t key) {
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+bool RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeContains(Node* node) {
+    // node may be any address in the arena, it's only compared, the size it would have is the key
+    size_t key = _size(node);
     Node* cur = m_root;
-    Node* parent = NULL;
 
     while (cur) {
-        parent = cur;
-        if (key > cur->sz) {
-            cur = cur->right;
-        }
-        else if (key < cur->sz) {
-            cur = cur->left;
-        }
-        else {
-            return cur;
-        }
+        if (cur == node)
+            return true;
+        cur = _rbtreeKeyLess(key, node, cur) ? _left(cur) : _right(cur);
     }
 
-    return NULL;
+    return false;
 }
 
 /*
@@ -595,53 +913,55 @@ RBTreeAllocator::Node* RBTreeAllocator::_rbtreeFindKey(size_t key) {
 * Fortunetely, in a real world application, we know the maximum possible alignment that can be requested.
 * Unless you want to waste memory for no reason, the maximum alignment can be set to 8 bytes.
 * So, we can GUARANTEE O(log(N)) operation, with minimal to no amount of wasted space
+*
+* The first candidate is the lower bound of (sz + header, 0), i.e. the smallest block that can fit,
+* and the lowest address among the blocks of that size. If alignment doesn't let it fit,
+* the candidates are visited in (size, address) order.
 */
 
-void* RBTreeAllocator::_rbtreeStrictBestFit(Node* node, size_t sz, size_t alignment, Node*& block, ptrdiff_t& padding) {
-    printf("Current node at %p > %d\n", node, node->sz);
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY>
+void* RBTreeAllocator<_ALLOC_BUFFER, _LOCK_POLICY>::_rbtreeStrictBestFit(Node* node, size_t sz, size_t alignment, Node*& block, ptrdiff_t& padding) {
+    size_t key = sz + allocHeaderSize;
+    Node* candidate = NULL;
 
-    if (!node || (!node->left && !node->right && node->sz < sz))
-        return NULL;
+    while (node) {
+        if (_size(node) >= key) {
+            candidate = node;
+            node = _left(node);
+        }
+        else {
+            node = _right(node);
+        }
+    }
 
     void* ptr;
     ptrdiff_t leftover;
 
-    if (node->sz >= sz && (!node->left || node->left->sz < sz)) {
-        // node has key gt sz, and left child has key lt sz, eliminate the left branch
-        ptr = _fitToBlock(node, sz, alignment, leftover, padding);
-        if (leftover > 0) {
+    while (candidate) {
+        ptr = _fitToBlock(candidate, sz, alignment, leftover, padding);
+        if (leftover >= 0) {
             // node can accomodate for the padding and the header
-            block = node;
+            block = candidate;
             return ptr;
         }
-        else {
-            // if not, search right branch
-            return _rbtreeStrictBestFit(node->right, sz, alignment, block, padding);
-        }
+        candidate = _rbtreeSuccessor(candidate);
     }
 
-    if (node->sz <= sz) {
-        return _rbtreeStrictBestFit(node->right, sz, alignment, block, padding);
-    }
-    else {
-        // both node and the left child have keys greater than sz
-        ptr = _rbtreeStrictBestFit(node->left, sz, alignment, block, padding);
-        if (!ptr) {
-            // despite having a key greater than sz, left child can't account for the padding & header
-            ptr = _fitToBlock(node, sz, alignment, leftover, padding);
-            if (leftover > 0) {
-                // we fall back to this node again,
-                block = node;
-                return ptr;
-            }
-            else {
-                // the worst case, we continue searching the right branch
-                return _rbtreeStrictBestFit(node->right, sz, alignment, block, padding);
-            }
-        }
-        else {
-            return ptr;
-        }
-    }
+    return NULL;
+}
+
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC>;
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>;
+template class RBTreeAllocator<ALLOC_BUFFER_VMDYNAMIC>;
+
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC, ALLOC_LOCK_SPIN>;
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_LOCK_SPIN>;
+template class RBTreeAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_LOCK_SPIN>;
+
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC, ALLOC_LOCK_MUTEX>;
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_LOCK_MUTEX>;
+template class RBTreeAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_LOCK_MUTEX>;
 
-}
\ No newline at end of file
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC, ALLOC_LOCK_TICKET>;
+template class RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_LOCK_TICKET>;
+template class RBTreeAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_LOCK_TICKET>;
@@ -3,6 +3,7 @@
 #include "Allocator.h"
 #include "Util.h"
 #include "VMLinearAllocator.h"
+#include "LockPolicy.h"
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
@@ -12,14 +13,25 @@
 /*
 * TODO
 * Share functionality between classes using compile-time code generation
-* Right now, it follows STATIC mode
-* Since the mechanism is working, port the STATIC_PREALLOC and VMDYNAMIC modes
+*
+* Buffer modes follow SequentialListAllocator:
+* STATIC and VMDYNAMIC take the size, STATIC_PREALLOC takes the buffer as well.
+* In VMDYNAMIC mode, pages are committed at the end of the arena whenever the tree has no fitting block.
 */
 
-class RBTreeAllocator : public Allocator
+template <typename _ALLOC_BUFFER, typename _LOCK_POLICY = ALLOC_LOCK_NONE>
+class RBTreeAllocator : public Allocator, protected AllocatorLock<_LOCK_POLICY>
 {
 public:
+    // STATIC & VMDYNAMIC
     RBTreeAllocator(size_t sz);
+
+    // STATIC PREALLOC
+    RBTreeAllocator(void* buffer, size_t sz);
+    // STATIC PREALLOC, adopts the heap an earlier allocator left in the buffer instead of building a new one,
+    // state is what SaveState() returned then, the tree links are offsets already so the buffer may have moved
+    RBTreeAllocator(void* buffer, size_t sz, const AllocatorPersistentState& state);
+
     ~RBTreeAllocator();
 
     void* Alloc(size_t sz, size_t alignment) final;
@@ -31,51 +43,80 @@ public:
 
     void Layout() final;
 
+    // ptr lies in the arena
+    bool Owns(const void* ptr) final;
+    // maps the arena (the whole reservation in VMDYNAMIC mode) in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    // blocks in address order, see HeapWalk.h
+    bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    HeapReport Report() final;
+
+    // STATIC PREALLOC, the root of the tree as an offset from the buffer
+    AllocatorPersistentState SaveState();
+    // STATIC PREALLOC, adopts the root another allocator over the same heap saved (another process mapping it, see SharedHeap.h)
+    void LoadState(const AllocatorPersistentState& state);
+    // STATIC PREALLOC, checks a tree another process may have left half updated: every node lies on a granule of the arena
+    // and points back to its parent, the (size, address) order and the red black rules hold, nNodes: nodes in the tree
+    bool VerifyTree(uint64_t& nNodes);
+
 protected:
     enum COLOR : uint8_t {
         BLACK,
         RED
     };
 
+    // links are 32-bit granule offsets from m_start (NIL for NULL),
+    // the size is stored in granules, shifted left by one to make room for the color bit
     class Node {
     public:
-        Node* parent;
-        Node* left;
-        Node* right;
-        COLOR color;
-
-        uintptr_t sz;
-
-        Node* llPrev;
-        Node* llNext;
-
-        Node* sibling();
-    };
-
-    struct FreeBlockHeader {
-        Node rbtreeNode;
-        size_t sz;
+        uint32_t parent;
+        uint32_t left;
+        uint32_t right;
+        uint32_t szColor;
     };
 
+    // the padding comes first, with the minimum padding it's the first word of the block,
+    // larger paddings are repeated there, so a heap walk finds the header from the start of the block
     struct AllocatedBlockHeader {
-        size_t sz;
         size_t padding;
+        size_t sz;
     };
 
 private:
     void build();
 
-    static Node* _rbtreeInsert(Node*& root, Node* node, size_t key);
-    static void _rbtreeFixup(Node *&root, Node *&pt);
-    static void _rbtreeRotateLeft(Node *&root, Node *&pt);
-    static void _rbtreeRotateRight(Node *&root, Node *&pt);
+    void* _VMDYNAMIC_VMEXPAND(size_t sz, size_t alignment, Node*& block, ptrdiff_t& padding);
+
+    inline Node* _node(uint32_t offset);
+    inline uint32_t _offset(Node* node);
+    inline Node* _parent(Node* node);
+    inline Node* _left(Node* node);
+    inline Node* _right(Node* node);
+    inline Node* _sibling(Node* node);
+    inline void _setParent(Node* node, Node* parent);
+    inline void _setLeft(Node* node, Node* left);
+    inline void _setRight(Node* node, Node* right);
+    static inline COLOR _color(Node* node);
+    static inline void _setColor(Node* node, COLOR color);
+    static inline size_t _size(const Node* node);
+    static inline void _setSize(Node* node, size_t sz);
+
+    Node* _rbtreeInsert(Node*& root, Node* node, size_t key);
+    void _rbtreeFixup(Node *&root, Node *&pt);
+    void _rbtreeRotateLeft(Node *&root, Node *&pt);
+    void _rbtreeRotateRight(Node *&root, Node *&pt);
     Node* _smallestInSubtree(Node* node);
+    Node* _rbtreeSuccessor(Node* node);
     Node* _BSTSubst(Node* node);
     void _rbtreeFixDoubleBlack(Node* node);
     void _rbtreeDelete(Node* node);
     void _rbtreeSwapNodes(Node* node, Node* subst);
 
-    Node* _rbtreeFindKey(size_t key);
+    static inline bool _rbtreeKeyLess(size_t key, const Node* node, const Node* cur);
+    bool _rbtreeContains(Node* node);
+    int32_t _rbtreeVerify(Node* node, Node* parent, Node* lo, Node* hi, uint32_t depth, uint64_t& nNodes);
     void* _rbtreeStrictBestFit(Node* node, size_t key, size_t alignment, Node*& block, ptrdiff_t& padding);
     
     void _deleteNode(Node* node);
@@ -84,6 +125,8 @@ private:
     inline size_t _splitBlock(void* block, void* ptr, size_t sz);
     inline void* _fitToBlock(void* block, size_t sz, size_t alignment, ptrdiff_t& leftover, ptrdiff_t& padding);
 
+    bool _walk(HeapWalkCursor& cursor, HeapBlock& block);
+
     size_t m_size;
 
     Node* m_root = NULL;
@@ -92,9 +135,25 @@ private:
 
     bool m_initialized;
 
+    VMLinearAllocator* m_vmAllocator;
+    uint32_t m_nVMPages;
+
     /* CONSTEXPRS */
 
+    static constexpr size_t RESERVE_VIRTUAL_ADDRESS_SPACE = 1024 * 1024 * 1024;
     static constexpr size_t allocHeaderSize = sizeof(AllocatedBlockHeader);
-    static constexpr size_t freeHeaderSize = sizeof(FreeBlockHeader);
-};
-
+    // every block has to be able to hold a node once it's freed,
+    // the padding in front of an allocation always can
+    static constexpr size_t minBlockSize = sizeof(Node);
+    static_assert(minBlockSize <= allocHeaderSize, "node doesn't fit in the padding");
+
+    // blocks start and end on granule boundaries, so nodes can be addressed with 32-bit offsets
+    static constexpr size_t GRANULE_SHIFT = 3;
+    static constexpr size_t GRANULE = (size_t)1 << GRANULE_SHIFT;
+    static constexpr uint32_t NIL = UINT32_MAX;
+    // the size field keeps 31 bits of granules next to the color bit, which caps a block, and so the arena, just under 16GB
+    static constexpr size_t MAX_ARENA_SIZE = ((size_t)UINT32_MAX >> 1) << GRANULE_SHIFT;
+    static_assert(RESERVE_VIRTUAL_ADDRESS_SPACE <= MAX_ARENA_SIZE, "the VMDYNAMIC reservation doesn't fit in the size field");
+    // a red black tree of 2^64 nodes is at most twice as high
+    static constexpr uint32_t MAX_DEPTH = 2 * 64;
+};
\ No newline at end of file
@@ -0,0 +1,450 @@
+#include "RelocatableAllocator.h"
+#include <iostream>
+
+template <typename _LOCK_POLICY>
+RelocatableAllocator<_LOCK_POLICY>::RelocatableAllocator(size_t sz, uint32_t maxHandles) :
+    m_size(sz & ~(GRANULE - 1)), m_freeList(NIL), m_passActive(false), m_table(NULL), m_maxHandles(maxHandles),
+    m_initialized(false), m_preAlloc(false)
+{
+    m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
+    if (!m_start)
+        return;
+    m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+    m_table = new uint32_t[m_maxHandles];
+
+    build();
+
+    m_initialized = true;
+}
+
+template <typename _LOCK_POLICY>
+RelocatableAllocator<_LOCK_POLICY>::RelocatableAllocator(void* buffer, size_t sz, uint32_t maxHandles) :
+    m_size(sz & ~(GRANULE - 1)), m_maxHandles(maxHandles),
+    m_initialized(true), m_preAlloc(true)
+{
+    assert((uintptr_t)buffer % GRANULE == 0);
+
+    m_start = buffer;
+    m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+    m_table = new uint32_t[m_maxHandles];
+
+    build();
+}
+
+template <typename _LOCK_POLICY>
+RelocatableAllocator<_LOCK_POLICY>::~RelocatableAllocator() {
+    if (m_initialized)
+        Release();
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::build() {
+    assert((m_size >> GRANULE_SHIFT) < NIL && m_maxHandles < TABLE_FREE);
+
+    m_top = (uintptr_t)m_start;
+    m_freeList = NIL;
+    m_passActive = false;
+    m_passDest = m_passCursor = (uintptr_t)m_start;
+
+    // every entry is free, chained in index order, m_maxHandles ends the chain
+    for (uint32_t i = 0; i < m_maxHandles; ++i)
+        m_table[i] = TABLE_FREE | (i + 1);
+    m_freeHandle = 0;
+}
+
+template <typename _LOCK_POLICY>
+void* RelocatableAllocator<_LOCK_POLICY>::Alloc(size_t sz, size_t alignment) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    assert((alignment & (alignment - 1)) == 0);
+
+    // moves would break a wider alignment, pinned or not, blocks are placed the same way
+    if (alignment > GRANULE) {
+        _statsFail(sz);
+        return NULL;
+    }
+
+    RelocHandle handle = _allocHandle(sz, 1);
+    return handle ? Resolve(handle) : NULL;
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::Free(void*& ptr) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    if (!ptr)
+        return;
+
+    _freeHandle(((AllocatedBlockHeader*)((uintptr_t)ptr - headerSize))->handle);
+    ptr = NULL;
+}
+
+template <typename _LOCK_POLICY>
+RelocHandle RelocatableAllocator<_LOCK_POLICY>::AllocHandle(size_t sz) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    return _allocHandle(sz, 0);
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::FreeHandle(RelocHandle handle) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    if (handle)
+        _freeHandle(handle);
+}
+
+template <typename _LOCK_POLICY>
+RelocHandle RelocatableAllocator<_LOCK_POLICY>::_allocHandle(size_t sz, uint32_t pins) {
+    // larger than the arena, this also keeps the rounding below from wrapping
+    if (!m_initialized || m_freeHandle == m_maxHandles || sz > m_size - headerSize) {
+        _statsFail(sz);
+        return 0;
+    }
+
+    size_t need = (sz + headerSize + GRANULE - 1) & ~(GRANULE - 1);
+    uintptr_t block = 0;
+
+    if (m_passActive && m_passCursor - m_passDest >= need) {
+        // packed right away, behind the pass
+        block = m_passDest;
+        m_passDest += need;
+    }
+    else {
+        for (uint32_t g = m_freeList; g != NIL; g = ((FreeBlockHeader*)_block(g))->next) {
+            FreeBlockHeader* freeBlock = (FreeBlockHeader*)_block(g);
+            size_t size = freeBlock->tag & ~TAG_FREE;
+            if (size < need)
+                continue;
+
+            _unlink(freeBlock);
+            if (size > need) {
+                FreeBlockHeader* rest = (FreeBlockHeader*)((uintptr_t)freeBlock + need);
+                rest->tag = (size - need) | TAG_FREE;
+                _push(rest);
+            }
+            block = (uintptr_t)freeBlock;
+            break;
+        }
+
+        if (!block && (uintptr_t)m_end - m_top >= need) {
+            block = m_top;
+            m_top += need;
+        }
+    }
+
+    if (!block) {
+        _statsFail(sz);
+        return 0;
+    }
+
+    uint32_t index = m_freeHandle;
+    m_freeHandle = m_table[index] & ~TABLE_FREE;
+    m_table[index] = _granule((void*)block);
+
+    AllocatedBlockHeader* header = (AllocatedBlockHeader*)block;
+    header->tag = need;
+    header->handle = index + 1;
+    header->pins = pins;
+
+    _statsAlloc(sz, need);
+    return index + 1;
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::_freeHandle(RelocHandle handle) {
+    uint32_t index = handle - 1;
+    assert(index < m_maxHandles && !(m_table[index] & TABLE_FREE));
+
+    uintptr_t block = (uintptr_t)_block(m_table[index]);
+    size_t size = ((AllocatedBlockHeader*)block)->tag;
+    uintptr_t end = block + size;
+
+    _statsFree(size);
+
+    m_table[index] = TABLE_FREE | m_freeHandle;
+    m_freeHandle = index;
+
+    // right in front of the gap or the top, it joins them
+    if (m_passActive && end == m_passDest) {
+        m_passDest = block;
+        return;
+    }
+    if (end == m_top) {
+        m_top = block;
+        return;
+    }
+
+    FreeBlockHeader* next = (FreeBlockHeader*)end;
+    if (next->tag & TAG_FREE) {
+        _unlink(next);
+        size += next->tag & ~TAG_FREE;
+    }
+
+    ((FreeBlockHeader*)block)->tag = size | TAG_FREE;
+    _push((void*)block);
+}
+
+template <typename _LOCK_POLICY>
+void* RelocatableAllocator<_LOCK_POLICY>::Pin(RelocHandle handle) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    if (!handle)
+        return NULL;
+
+    ++((AllocatedBlockHeader*)_block(m_table[handle - 1]))->pins;
+    return Resolve(handle);
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::Unpin(RelocHandle handle) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    if (!handle)
+        return;
+
+    AllocatedBlockHeader* header = (AllocatedBlockHeader*)_block(m_table[handle - 1]);
+    assert(header->pins);
+    --header->pins;
+}
+
+template <typename _LOCK_POLICY>
+size_t RelocatableAllocator<_LOCK_POLICY>::Compact(double budgetMs) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+
+    // no hole under the top, nothing to move
+    if (!m_passActive && m_freeList == NIL)
+        return 0;
+
+    __int64 now = 0, QPCfreq = 0;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&QPCfreq);
+    QueryPerformanceCounter((LARGE_INTEGER*)&now);
+
+    // at least one block per call, however small the budget
+    return _compact(now + (__int64)(budgetMs * QPCfreq / 1000.0));
+}
+
+template <typename _LOCK_POLICY>
+size_t RelocatableAllocator<_LOCK_POLICY>::Defragment() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+
+    size_t moved = 0;
+    // the pass in progress, then one from the start, the first one may have started behind blocks freed since
+    if (m_passActive)
+        moved += _compact(0);
+    moved += _compact(0);
+    return moved;
+}
+
+template <typename _LOCK_POLICY>
+size_t RelocatableAllocator<_LOCK_POLICY>::_compact(__int64 deadline) {
+    size_t moved = 0;
+    __int64 now = 0;
+
+    if (!m_passActive) {
+        m_passActive = true;
+        m_passDest = m_passCursor = (uintptr_t)m_start;
+    }
+
+    while (m_passCursor < m_top) {
+        AllocatedBlockHeader* header = (AllocatedBlockHeader*)m_passCursor;
+        size_t size = header->tag & ~TAG_FREE;
+
+        if (header->tag & TAG_FREE) {
+            // squeezed into the gap
+            _unlink(header);
+            m_passCursor += size;
+        }
+        else if (header->pins) {
+            // the gap stays behind the pinned block as a free block, the pass packs on after it
+            if (m_passDest < m_passCursor) {
+                FreeBlockHeader* gap = (FreeBlockHeader*)m_passDest;
+                gap->tag = (m_passCursor - m_passDest) | TAG_FREE;
+                _push(gap);
+            }
+            m_passCursor += size;
+            m_passDest = m_passCursor;
+        }
+        else {
+            if (m_passDest != m_passCursor) {
+                memmove((void*)m_passDest, header, size);
+                m_table[((AllocatedBlockHeader*)m_passDest)->handle - 1] = _granule((void*)m_passDest);
+                moved += size;
+            }
+            m_passDest += size;
+            m_passCursor += size;
+        }
+
+        if (deadline) {
+            QueryPerformanceCounter((LARGE_INTEGER*)&now);
+            if (now >= deadline)
+                break;
+        }
+    }
+
+    // the gap joins the free space above the top
+    if (m_passCursor >= m_top) {
+        m_top = m_passDest;
+        m_passActive = false;
+    }
+
+    return moved;
+}
+
+template <typename _LOCK_POLICY>
+void* RelocatableAllocator<_LOCK_POLICY>::_block(uint32_t granule) {
+    return (void*)((uintptr_t)m_start + ((uintptr_t)granule << GRANULE_SHIFT));
+}
+
+template <typename _LOCK_POLICY>
+uint32_t RelocatableAllocator<_LOCK_POLICY>::_granule(void* block) {
+    return (uint32_t)(((uintptr_t)block - (uintptr_t)m_start) >> GRANULE_SHIFT);
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::_push(void* block) {
+    FreeBlockHeader* header = (FreeBlockHeader*)block;
+    uint32_t g = _granule(block);
+
+    header->prev = NIL;
+    header->next = m_freeList;
+    if (m_freeList != NIL)
+        ((FreeBlockHeader*)_block(m_freeList))->prev = g;
+    m_freeList = g;
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::_unlink(void* block) {
+    FreeBlockHeader* header = (FreeBlockHeader*)block;
+
+    if (header->prev != NIL)
+        ((FreeBlockHeader*)_block(header->prev))->next = header->next;
+    else
+        m_freeList = header->next;
+
+    if (header->next != NIL)
+        ((FreeBlockHeader*)_block(header->next))->prev = header->prev;
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::Release() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
+    if (!m_preAlloc)
+        free(m_start);
+    delete[] m_table;
+    m_table = NULL;
+    m_initialized = false;
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::Reset() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
+    if (m_initialized)
+        build();
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::ZeroMem() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    if (!m_initialized)
+        return;
+
+    for (uint32_t g = m_freeList; g != NIL; g = ((FreeBlockHeader*)_block(g))->next) {
+        FreeBlockHeader* freeBlock = (FreeBlockHeader*)_block(g);
+        memset((void*)((uintptr_t)freeBlock + headerSize), 0, (freeBlock->tag & ~TAG_FREE) - headerSize);
+    }
+    if (m_passActive)
+        memset((void*)m_passDest, 0, m_passCursor - m_passDest);
+    memset((void*)m_top, 0, (uintptr_t)m_end - m_top);
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::Layout() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    std::cout << m_size << "\nCompaction pass: " << (m_passActive ? "in progress" : "idle") << "\n";
+
+    while (_walk(cursor, block)) {
+        _layoutBlock(block);
+        report.Add(block);
+    }
+
+    _layoutReport(report);
+}
+
+template <typename _LOCK_POLICY>
+bool RelocatableAllocator<_LOCK_POLICY>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::RegisterPages(Allocator* owner) {
+    AllocatorPageMap::Register(m_start, m_size, owner ? owner : this);
+}
+
+template <typename _LOCK_POLICY>
+void RelocatableAllocator<_LOCK_POLICY>::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_start, m_size);
+}
+
+template <typename _LOCK_POLICY>
+bool RelocatableAllocator<_LOCK_POLICY>::Walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    return _walk(cursor, block);
+}
+
+template <typename _LOCK_POLICY>
+HeapReport RelocatableAllocator<_LOCK_POLICY>::Report() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    while (_walk(cursor, block))
+        report.Add(block);
+
+    return report;
+}
+
+/*
+* Headers tile [m_start, m_top) but for the gap of a pass in progress, reported as one free block,
+* [m_top, m_end) is one free block.
+*/
+template <typename _LOCK_POLICY>
+bool RelocatableAllocator<_LOCK_POLICY>::_walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    if (!m_initialized)
+        return false;
+
+    uintptr_t cur = cursor.block ? (uintptr_t)cursor.block : (uintptr_t)m_start;
+    uintptr_t next;
+
+    if (m_passActive && cur == m_passDest && m_passDest < m_passCursor) {
+        block.size = m_passCursor - m_passDest;
+        block.free = true;
+        block.padding = 0;
+        next = m_passCursor;
+    }
+    else if (cur < m_top) {
+        size_t tag = ((AllocatedBlockHeader*)cur)->tag;
+        block.size = tag & ~TAG_FREE;
+        block.free = (tag & TAG_FREE) != 0;
+        block.padding = block.free ? 0 : headerSize;
+        next = cur + block.size;
+    }
+    else if (cur < (uintptr_t)m_end) {
+        block.size = (uintptr_t)m_end - cur;
+        block.free = true;
+        block.padding = 0;
+        next = (uintptr_t)m_end;
+    }
+    else
+        return false;
+
+    block.offset = cur - (uintptr_t)m_start;
+    cursor.block = (void*)next;
+    return true;
+}
+
+template class RelocatableAllocator<ALLOC_LOCK_NONE>;
+template class RelocatableAllocator<ALLOC_LOCK_SPIN>;
+template class RelocatableAllocator<ALLOC_LOCK_MUTEX>;
+template class RelocatableAllocator<ALLOC_LOCK_TICKET>;
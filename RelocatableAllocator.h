@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Allocator.h"
+#include "LockPolicy.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+Clients hold handles instead of pointers, a handle indirects through a table to the current place of its block,
+so the allocator may move blocks and fragmentation never builds up over a long session.
+
+    RelocHandle h = allocator.AllocHandle(sz);
+    Mesh* mesh = (Mesh*)allocator.Resolve(h);      // valid until the next Compact()
+    ...
+    allocator.Compact(0.5);                         // once per frame, at most half a millisecond
+
+Compact() is incremental, a pass slides the live blocks toward the start of the arena one at a time
+until the time budget runs out, and resumes from there on the next call.
+Behind the pass the arena is packed, the free space it squeezed out is one gap in front of its cursor
+(allocations are placed in that gap first), when the cursor reaches the top the gap joins the free space above the top.
+Pinned blocks (Pin(), and every block handed out through the Allocator interface, Alloc()) don't move,
+a pass leaves the gap in front of them as a free block and carries on behind them.
+
+Alloc takes the gap of a pass in progress, then the first fitting free block, then the top (a freed block merges with a free block right after it).
+Blocks are multiples of 16 bytes and start on 16 bytes, a move keeps that alignment only: alignment is at most 16.
+*/
+
+typedef uint32_t RelocHandle;
+
+template <typename _LOCK_POLICY = ALLOC_LOCK_NONE>
+class RelocatableAllocator : public Allocator, protected AllocatorLock<_LOCK_POLICY> {
+public:
+    // maxHandles: blocks alive at the same time at most, the table is allocated up front
+    RelocatableAllocator(size_t sz, uint32_t maxHandles);
+    RelocatableAllocator(void* buffer, size_t sz, uint32_t maxHandles);
+    ~RelocatableAllocator();
+
+    // pinned block, for callers that need a stable pointer, freed with Free()
+    void* Alloc(size_t sz, size_t alignment) final;
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    // zeroes the free space, the blocks & the table stay
+    inline void ZeroMem() final;
+    void Layout() final;
+
+    // ptr lies in the arena
+    bool Owns(const void* ptr) final;
+    // maps the arena in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    // blocks in address order, see HeapWalk.h, the gap of a pass in progress is one free block
+    bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    HeapReport Report() final;
+
+    // 0 when the arena or the table is full, or the arena couldn't be allocated
+    RelocHandle AllocHandle(size_t sz);
+    void FreeHandle(RelocHandle handle);
+
+    // the block now, the pointer is valid until the next Compact() unless the block is pinned
+    inline void* Resolve(RelocHandle handle);
+    // the block doesn't move until as many Unpin() calls
+    void* Pin(RelocHandle handle);
+    void Unpin(RelocHandle handle);
+
+    // moves blocks for budgetMs at most (checked after every block), returns the bytes moved
+    size_t Compact(double budgetMs);
+    // completes the pass in progress and runs a full one, stop the world
+    size_t Defragment();
+
+protected:
+    // every block starts with a header, the tag is the size of the block (header included) and TAG_FREE
+    struct AllocatedBlockHeader {
+        size_t tag;
+        RelocHandle handle;
+        uint32_t pins;
+    };
+
+    // free list links are granule offsets from m_start, NIL for NULL
+    struct FreeBlockHeader {
+        size_t tag;
+        uint32_t next;
+        uint32_t prev;
+    };
+
+private:
+    void build();
+
+    RelocHandle _allocHandle(size_t sz, uint32_t pins);
+    void _freeHandle(RelocHandle handle);
+    size_t _compact(__int64 deadline);
+
+    inline void* _block(uint32_t granule);
+    inline uint32_t _granule(void* block);
+    inline void _push(void* block);
+    inline void _unlink(void* block);
+
+    bool _walk(HeapWalkCursor& cursor, HeapBlock& block);
+
+    void* m_start;
+    void* m_end;
+    size_t m_size;
+
+    // [m_start, m_top) is tiled with blocks, [m_top, m_end) is free
+    uintptr_t m_top;
+    uint32_t m_freeList;
+
+    // while a pass is in progress,
+    // [m_start, m_passDest) is packed, [m_passDest, m_passCursor) is the gap, the blocks from m_passCursor on are untouched
+    bool m_passActive;
+    uintptr_t m_passDest;
+    uintptr_t m_passCursor;
+
+    // granule offset of every live block, free entries chain their next free index with TABLE_FREE set
+    uint32_t* m_table;
+    uint32_t m_maxHandles;
+    uint32_t m_freeHandle;
+
+    bool m_initialized;
+    bool m_preAlloc;
+
+    /* CONSTEXPRS */
+
+    static constexpr size_t GRANULE_SHIFT = 4;
+    static constexpr size_t GRANULE = (size_t)1 << GRANULE_SHIFT;
+    static constexpr size_t headerSize = sizeof(AllocatedBlockHeader);
+    static_assert(sizeof(FreeBlockHeader) == headerSize && headerSize == GRANULE, "a header is one granule");
+
+    static constexpr size_t TAG_FREE = 1;
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr uint32_t TABLE_FREE = 0x80000000;
+};
+
+template <typename _LOCK_POLICY>
+void* RelocatableAllocator<_LOCK_POLICY>::Resolve(RelocHandle handle) {
+    if (!handle)
+        return NULL;
+    return (void*)((uintptr_t)_block(m_table[handle - 1]) + headerSize);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Allocator.h"
+#include <tuple>
+#include <stdint.h>
+
+/*
+Routes every request by size: up to _THRESHOLD bytes to _SMALL_ALLOCATOR, above it to _LARGE_ALLOCATOR.
+Free goes to the small side when it owns the pointer (Owns(), an address range check), to the large side otherwise.
+
+Both allocators are members of their concrete type, every call into them is resolved at compile time
+(no virtual dispatch, the compiler inlines through), Segregators, FallbackAllocators and Bucketizers nest freely.
+Header only, it's a template over any allocator.
+The combinator takes no lock of its own, pick the lock policy of the allocators it's built from.
+
+Each allocator is constructed in place from a tuple of its constructor arguments:
+    Segregator<256, Bucketizer<16, 256, 16>, RBTreeAllocator<ALLOC_BUFFER_STATIC>>
+        allocator(std::make_tuple(1 * MB), std::make_tuple(64 * MB));
+*/
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+class Segregator : public Allocator {
+public:
+    template <typename... _SMALL_ARGS, typename... _LARGE_ARGS>
+    Segregator(std::tuple<_SMALL_ARGS...> smallArgs, std::tuple<_LARGE_ARGS...> largeArgs);
+
+    inline void* Alloc(size_t sz, size_t alignment) final;
+    inline void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    inline void Layout() final;
+    inline AllocatorStats GetStats() final;
+    // merged reports of both allocators
+    inline HeapReport Report() final;
+
+    // ptr lies in either allocator
+    inline bool Owns(const void* ptr) final;
+    // maps both allocators in AllocatorPageMap, each to itself unless an owner is given
+    inline void RegisterPages(Allocator* owner = NULL) final;
+    inline void UnregisterPages() final;
+
+    inline _SMALL_ALLOCATOR& Small();
+    inline _LARGE_ALLOCATOR& Large();
+
+private:
+    _SMALL_ALLOCATOR m_small;
+    _LARGE_ALLOCATOR m_large;
+};
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+template <typename... _SMALL_ARGS, typename... _LARGE_ARGS>
+Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Segregator(std::tuple<_SMALL_ARGS...> smallArgs, std::tuple<_LARGE_ARGS...> largeArgs) :
+    // guaranteed copy elision, the allocators are built in place
+    m_small(std::make_from_tuple<_SMALL_ALLOCATOR>(smallArgs)),
+    m_large(std::make_from_tuple<_LARGE_ALLOCATOR>(largeArgs))
+{}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void* Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Alloc(size_t sz, size_t alignment) {
+    if (sz <= _THRESHOLD)
+        return m_small.Alloc(sz, alignment);
+    return m_large.Alloc(sz, alignment);
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    if (m_small.Owns(ptr))
+        m_small.Free(ptr);
+    else
+        m_large.Free(ptr);
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Release() {
+    m_small.Release();
+    m_large.Release();
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Reset() {
+    m_small.Reset();
+    m_large.Reset();
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::ZeroMem() {
+    m_small.ZeroMem();
+    m_large.ZeroMem();
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Layout() {
+    std::cout << "Segregator, <= " << _THRESHOLD << " bytes\n";
+    m_small.Layout();
+    std::cout << "Segregator, > " << _THRESHOLD << " bytes\n";
+    m_large.Layout();
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+AllocatorStats Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::GetStats() {
+    AllocatorStats stats = m_small.GetStats();
+    stats.Accumulate(m_large.GetStats());
+    return stats;
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+HeapReport Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Report() {
+    HeapReport report = m_small.Report();
+    report.Merge(m_large.Report());
+    return report;
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+bool Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Owns(const void* ptr) {
+    return m_small.Owns(ptr) || m_large.Owns(ptr);
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::RegisterPages(Allocator* owner) {
+    m_small.RegisterPages(owner);
+    m_large.RegisterPages(owner);
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+void Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::UnregisterPages() {
+    m_small.UnregisterPages();
+    m_large.UnregisterPages();
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+_SMALL_ALLOCATOR& Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Small() {
+    return m_small;
+}
+
+template <size_t _THRESHOLD, typename _SMALL_ALLOCATOR, typename _LARGE_ALLOCATOR>
+_LARGE_ALLOCATOR& Segregator<_THRESHOLD, _SMALL_ALLOCATOR, _LARGE_ALLOCATOR>::Large() {
+    return m_large;
+}
@@ -1,9 +1,9 @@
 #include "SequentialListAllocator.h"
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::SequentialListAllocator(size_t sz) :
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::SequentialListAllocator(size_t sz, bool largePages, DWORD numaNode) :
     m_size(sz), m_initialized(false),
-    m_vmAllocator(NULL), m_nVMPages(0)
+    m_vmAllocator(NULL), m_nVMPages(0), m_nMinVMPages(0)
 {
     if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
         std::cout << "successfully constructed! STATIC\n";
@@ -15,7 +15,7 @@ SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::SequentialListAllocator(
     else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
         std::cout << "successfully constructed! VMDYNAMIC\n";
 
-        m_vmAllocator = new VMLinearAllocator(RESERVE_VIRTUAL_ADDRESS_SPACE);
+        m_vmAllocator = new VMLinearAllocator(RESERVE_VIRTUAL_ADDRESS_SPACE, largePages, numaNode);
 
         uint32_t vmPageSize = m_vmAllocator->PageSize();
         uint32_t n = (uint32_t)ceil((double)sz / vmPageSize);
@@ -25,6 +25,7 @@ SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::SequentialListAllocator(
         m_end = (void*)((uintptr_t)m_start + vmAllocSize);
         m_size = vmAllocSize;
         m_nVMPages = n;
+        m_nMinVMPages = n;
         m_initialized = true;
         build();
     }
@@ -35,10 +36,10 @@ SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::SequentialListAllocator(
     }
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::SequentialListAllocator(void* buffer, size_t sz) :
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::SequentialListAllocator(void* buffer, size_t sz) :
     m_size(sz), m_initialized(true),
-    m_vmAllocator(NULL), m_nVMPages(0)
+    m_vmAllocator(NULL), m_nVMPages(0), m_nMinVMPages(0)
 {
     if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
         std::cout << "successfully constructed! STATIC PREALLOC\n";
@@ -53,16 +54,54 @@ SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::SequentialListAllocator(
     }
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::~SequentialListAllocator() {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::SequentialListAllocator(void* buffer, size_t sz, const AllocatorPersistentState& state) :
+    m_size(sz), m_initialized(true),
+    m_vmAllocator(NULL), m_nVMPages(0), m_nMinVMPages(0)
+{
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+        m_start = buffer;
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        m_llStart = state.head == AllocatorPersistentState::NIL ? NULL : (void*)((uintptr_t)m_start + state.head);
+        m_llEnd = state.tail == AllocatorPersistentState::NIL ? NULL : (void*)((uintptr_t)m_start + state.tail);
+
+        // the links inside the free blocks are pointers into the old mapping
+        ptrdiff_t delta = (uintptr_t)m_start - (uintptr_t)state.base;
+        if (!delta)
+            return;
+
+        for (void* block = m_llStart; block; ) {
+            void*& next = isBoundaryTagged ? ((TaggedFreeBlockHeader*)block)->next : ((FreeBlockHeader*)block)->next;
+            void*& prev = isBoundaryTagged ? ((TaggedFreeBlockHeader*)block)->prev : ((FreeBlockHeader*)block)->prev;
+            if (next)
+                next = (void*)((uintptr_t)next + delta);
+            if (prev)
+                prev = (void*)((uintptr_t)prev + delta);
+            block = next;
+        }
+    }
+    else {
+        assert(false && "BUFFER PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::~SequentialListAllocator() {
     if (m_initialized)
         Release();
     if (m_vmAllocator)
         delete m_vmAllocator;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::build() {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::build() {
+    if constexpr(isBoundaryTagged) {
+        buildBTAG();
+        return;
+    }
+
     FreeBlockHeader* header = new(m_start) FreeBlockHeader;
 
     header->sz = m_size;
@@ -73,15 +112,23 @@ void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::build() {
     m_llEnd = m_start;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Alloc(size_t sz, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Alloc(size_t sz, size_t alignment) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     assert((alignment & (alignment - 1)) == 0);
 
-    return ALLOC<_ALLOC_BUFFER, _ALLOC_PATTERN>(sz, alignment);
+    void* ptr = ALLOC<_ALLOC_BUFFER, _ALLOC_PATTERN>(sz, alignment);
+
+    if (ptr)
+        _statsAlloc(sz, ((AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize))->sz);
+    else
+        _statsFail(sz);
+
+    return ptr;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-size_t SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::_splitBlock(void* block, void* prevBlock, void* ptr, size_t sz) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+size_t SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_splitBlock(void* block, void* prevBlock, void* ptr, size_t sz) {
     FreeBlockHeader* blockHeader = (FreeBlockHeader*)block;
 
     ptrdiff_t remainingSpace = (uintptr_t)block + blockHeader->sz - (uintptr_t)ptr - sz;
@@ -125,21 +172,27 @@ size_t SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::_splitBlock(void*
     return 0;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::_fitPadding(ptrdiff_t& padding, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_fitPadding(ptrdiff_t& padding, size_t alignment) {
     // if can't fit header into the padding
-    if (padding < allocHeaderSize) {
-        if ((allocHeaderSize - padding) % alignment == 0) {
-            padding = allocHeaderSize;
+    if (padding < minPadding) {
+        if ((minPadding - padding) % alignment == 0) {
+            padding = minPadding;
         }
         else {
-            padding += alignment * (1 + (allocHeaderSize - padding) / alignment);
+            padding += alignment * (1 + (minPadding - padding) / alignment);
         }
     }
+
+    // blocks of the address ordered list aren't word aligned, keep the padding word at the start of the block clear of the header
+    if constexpr(!isBoundaryTagged) {
+        while (padding != (ptrdiff_t)minPadding && padding < (ptrdiff_t)(minPadding + sizeof(size_t)))
+            padding += alignment;
+    }
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::_fitToBlock(
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_fitToBlock(
     void* block, size_t sz, size_t alignment, ptrdiff_t& leftover, ptrdiff_t& padding)
 {
     void* ptr = (void*)(((uintptr_t)block + alignment - 1) & ~(alignment - 1));
@@ -150,8 +203,8 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::_fitToBlock(
     return ptr;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_STATIC_FIRST_FIT(size_t sz, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_STATIC_FIRST_FIT(size_t sz, size_t alignment) {
     void* ptr = NULL;
     void* block = NULL;
     void* S_block = m_llStart;
@@ -189,12 +242,13 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_STATIC_FIRST
     AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)ptr - allocHeaderSize)) AllocatedBlockHeader;
     allocHeader->sz = _splitBlock(block, ((FreeBlockHeader*)block)->prev, ptr, sz);
     allocHeader->padding = padding;
+    *(size_t*)block = padding;
 
     return ptr;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_STATIC_BEST_FIT(size_t sz, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_STATIC_BEST_FIT(size_t sz, size_t alignment) {
     void* block = NULL;
     void* cache_block = NULL;
 
@@ -241,12 +295,13 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_STATIC_BEST_
     AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)cache_ptr - allocHeaderSize)) AllocatedBlockHeader;
     allocHeader->sz = _splitBlock(cache_block, ((FreeBlockHeader*)cache_block)->prev, cache_ptr, sz);
     allocHeader->padding = cache_padding;
+    *(size_t*)cache_block = cache_padding;
 
     return cache_ptr;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_FIRST_FIT(size_t sz, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_VMDYNAMIC_FIRST_FIT(size_t sz, size_t alignment) {
     void* ptr = alloc_STATIC_FIRST_FIT(sz, alignment);
     if (ptr)
         return ptr;
@@ -254,8 +309,8 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_FI
     return alloc_VMDYNAMIC_VMEXPAND(sz, alignment);
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_BEST_FIT(size_t sz, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_VMDYNAMIC_BEST_FIT(size_t sz, size_t alignment) {
     void* ptr = alloc_STATIC_BEST_FIT(sz, alignment);
     if (ptr)
         return ptr;
@@ -263,8 +318,8 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_BE
     return alloc_VMDYNAMIC_VMEXPAND(sz, alignment);
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_VMEXPAND(size_t sz, size_t alignment) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_VMDYNAMIC_VMEXPAND(size_t sz, size_t alignment) {
     // no free block was large enough
     // request new page
 
@@ -298,19 +353,25 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_VM
 
         n = ceil((double)(sz + padding) / vmPageSize);
         prevBlock = m_llEnd;
-        if (prevBlock) {
-            ((FreeBlockHeader*)prevBlock)->next = block;
-        }
     }
 
     // to be safe, allocate one more page than needed
     //n++;
-    m_nVMPages += n;
     vmAllocSize = (size_t)n * vmPageSize;
 
     // every allocation is made from the end of the address space
     void* vmAlloc = m_vmAllocator->Alloc(n);
-    assert(vmAlloc == m_end && "ERR VMALLOC IS NOT CONTIGUOUS");
+    // out of address space, or the pages didn't land right after the arena, the free list is untouched so far
+    if (vmAlloc != m_end) {
+        if (vmAlloc)
+            m_vmAllocator->Shrink(n);
+        return NULL;
+    }
+    m_nVMPages += n;
+
+    if (block == m_end && prevBlock) {
+        ((FreeBlockHeader*)prevBlock)->next = block;
+    }
 
     FreeBlockHeader* freeHeader = new(block) FreeBlockHeader;
     freeHeader->sz = (uintptr_t)m_end - (uintptr_t)block + vmAllocSize;
@@ -330,19 +391,28 @@ void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::alloc_VMDYNAMIC_VM
     AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)ptr - allocHeaderSize)) AllocatedBlockHeader;
     allocHeader->sz = _splitBlock(block, prevBlock, ptr, sz);
     allocHeader->padding = padding;
+    *(size_t*)block = padding;
 
     return ptr;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Free(void*& ptr) {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Free(void*& ptr) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     if (!ptr)
         return;
 
+    if constexpr(isBoundaryTagged) {
+        free_BTAG(ptr);
+        return;
+    }
+
     AllocatedBlockHeader* allocHeader = (AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize);
     size_t allocSize = allocHeader->sz;
     size_t allocPadding = allocHeader->padding;
 
+    _statsFree(allocSize);
+
     void* freeHeaderPtr = (void*)((uintptr_t)ptr - allocPadding);
 
     if (!m_llStart) {
@@ -362,8 +432,13 @@ void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Free(void*& ptr) {
 
         if ((uintptr_t)m_llStart == (uintptr_t)ptr + allocSize) {
             // merge free blocks
-            freeHeader->next = ((FreeBlockHeader*)m_llStart)->next;
-            freeHeader->sz = allocSize + allocPadding + ((FreeBlockHeader*)m_llStart)->sz;
+            FreeBlockHeader* startHeader = (FreeBlockHeader*)m_llStart;
+            freeHeader->next = startHeader->next;
+            freeHeader->sz = allocSize + allocPadding + startHeader->sz;
+            if (startHeader->next)
+                ((FreeBlockHeader*)startHeader->next)->prev = freeHeaderPtr;
+            if (m_llEnd == m_llStart)
+                m_llEnd = freeHeaderPtr;
         }
         else {
             ((FreeBlockHeader*)m_llStart)->prev = freeHeaderPtr;
@@ -382,7 +457,7 @@ void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Free(void*& ptr) {
         }
         else {
             FreeBlockHeader* freeHeader = new(freeHeaderPtr) FreeBlockHeader;
-            ((FreeBlockHeader*)m_llEnd)->next = ptr;
+            ((FreeBlockHeader*)m_llEnd)->next = freeHeaderPtr;
             freeHeader->next = NULL;
             freeHeader->prev = m_llEnd;
             freeHeader->sz = allocSize + allocPadding;
@@ -464,33 +539,395 @@ void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Free(void*& ptr) {
     else {
         return;
     }
+
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        _VMDYNAMIC_VMSHRINK();
+    }
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_VMDYNAMIC_VMSHRINK() {
+    // only the trailing free block can be given back, as pages are committed linearly from the end
+    void* block;
+    uintptr_t keepEnd;
+    uint32_t vmPageSize = m_vmAllocator->PageSize();
+
+    if constexpr(isBoundaryTagged) {
+        // the epilogue tag knows whether the last block is free
+        size_t* epilogue = (size_t*)((uintptr_t)m_end - tagSize);
+        if (!(*epilogue & TAG_PREV_FREE))
+            return;
+        block = (void*)((uintptr_t)epilogue - *(size_t*)((uintptr_t)epilogue - tagSize));
+        keepEnd = (uintptr_t)block + minTaggedBlockSize + tagSize;
+    }
+    else {
+        if (!m_llEnd || (uintptr_t)m_llEnd + ((FreeBlockHeader*)m_llEnd)->sz != (uintptr_t)m_end)
+            return;
+        block = m_llEnd;
+        keepEnd = (uintptr_t)block + freeHeaderSize;
+    }
+
+    // the header of the trailing block must stay in committed memory
+    keepEnd = (keepEnd + vmPageSize - 1) & ~((uintptr_t)vmPageSize - 1);
+    uint32_t nFreePages = (uint32_t)(((uintptr_t)m_end - keepEnd) / vmPageSize);
+
+    if (nFreePages <= VM_SHRINK_THRESHOLD)
+        return;
+
+    uint32_t n = nFreePages - VM_SHRINK_RETAIN;
+
+    // never go below the size requested at construction
+    if (m_nVMPages - n < m_nMinVMPages)
+        n = m_nVMPages - m_nMinVMPages;
+
+    if (n == 0)
+        return;
+
+    size_t vmFreeSize = (size_t)n * vmPageSize;
+
+    m_vmAllocator->Shrink(n);
+    m_nVMPages -= n;
+    m_end = (void*)((uintptr_t)m_end - vmFreeSize);
+    m_size -= vmFreeSize;
+
+    if constexpr(isBoundaryTagged) {
+        *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+        _btagMarkFree(block, (*(size_t*)block & ~TAG_MASK) - vmFreeSize);
+    }
+    else {
+        ((FreeBlockHeader*)block)->sz -= vmFreeSize;
+    }
+}
+
+/*
+* BOUNDARY_TAG mode
+* [tag|next|prev ... footer] free block
+* [tag ... AllocatedBlockHeader|user data] allocated block
+* The last word of the arena is an epilogue tag of size 0 that is never free,
+* so merging with the right neighbour never runs past m_end.
+*/
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::buildBTAG() {
+    assert(m_size % tagSize == 0 && m_size >= minTaggedBlockSize + tagSize);
+
+    *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+
+    m_llStart = NULL;
+    m_llEnd = NULL;
+
+    _btagMarkFree(m_start, m_size - tagSize);
+    _btagPush(m_start);
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_btagMarkFree(void* block, size_t sz) {
+    // a free block never has a free left neighbour, they would have been merged
+    ((TaggedFreeBlockHeader*)block)->tag = sz | TAG_FREE;
+    *(size_t*)((uintptr_t)block + sz - tagSize) = sz;
+    *(size_t*)((uintptr_t)block + sz) |= TAG_PREV_FREE;
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_btagPush(void* block) {
+    TaggedFreeBlockHeader* header = (TaggedFreeBlockHeader*)block;
+    header->prev = NULL;
+    header->next = m_llStart;
+    if (m_llStart)
+        ((TaggedFreeBlockHeader*)m_llStart)->prev = block;
+    m_llStart = block;
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_btagUnlink(void* block) {
+    TaggedFreeBlockHeader* header = (TaggedFreeBlockHeader*)block;
+    if (header->prev)
+        ((TaggedFreeBlockHeader*)header->prev)->next = header->next;
+    else
+        m_llStart = header->next;
+    if (header->next)
+        ((TaggedFreeBlockHeader*)header->next)->prev = header->prev;
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_btagCarve(void* block, void* ptr, size_t sz, ptrdiff_t padding) {
+    size_t blockSize = ((TaggedFreeBlockHeader*)block)->tag & ~TAG_MASK;
+    size_t usedSize = (padding + sz + TAG_MASK) & ~TAG_MASK;
+
+    _btagUnlink(block);
+
+    if (blockSize - usedSize >= minTaggedBlockSize) {
+        // the remainder is a new free block
+        void* newBlock = (void*)((uintptr_t)block + usedSize);
+        _btagMarkFree(newBlock, blockSize - usedSize);
+        _btagPush(newBlock);
+        blockSize = usedSize;
+    }
+    else {
+        *(size_t*)((uintptr_t)block + blockSize) &= ~TAG_PREV_FREE;
+    }
+
+    ((TaggedFreeBlockHeader*)block)->tag = blockSize;
+
+    AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)ptr - allocHeaderSize)) AllocatedBlockHeader;
+    allocHeader->sz = blockSize - padding;
+    allocHeader->padding = padding;
+    *(size_t*)((uintptr_t)block + tagSize) = padding;
+
+    return ptr;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Layout() {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_BTAG(size_t sz, size_t alignment) {
     void* block = m_llStart;
+    void* cache_block = NULL;
+
+    void* ptr = NULL;
+    void* cache_ptr = NULL;
 
-    std::cout << ((uintptr_t)m_end - (uintptr_t)m_start) << "\nNum of committed VM pages: " << m_nVMPages << " " << allocHeaderSize << "\nFree blocks at: ";
+    ptrdiff_t leftover, min_leftover = PTRDIFF_MAX;
+    ptrdiff_t padding, cache_padding = 0;
 
+    // the list is unordered, so first fit simply takes the most recently freed block that fits
     while (block) {
-        uintptr_t next = 0, prev = 0;
-        if (((FreeBlockHeader*)block)->next != NULL)
-            next = (uintptr_t)(((FreeBlockHeader*)block)->next) - (uintptr_t)m_start;
+        ptr = (void*)(((uintptr_t)block + alignment - 1) & ~(alignment - 1));
+        padding = (uintptr_t)ptr - (uintptr_t)block;
+        _fitPadding(padding, alignment);
+        ptr = (void*)((uintptr_t)block + padding);
+        leftover = (ptrdiff_t)(((TaggedFreeBlockHeader*)block)->tag & ~TAG_MASK) - (ptrdiff_t)((padding + sz + TAG_MASK) & ~TAG_MASK);
+
+        if (leftover >= 0 && leftover < min_leftover) {
+            min_leftover = leftover;
+            cache_block = block;
+            cache_ptr = ptr;
+            cache_padding = padding;
+
+            if constexpr(std::is_same<_ALLOC_PATTERN, ALLOC_PATTERN_FIRST_FIT>::value) {
+                break;
+            }
+        }
+
+        block = ((TaggedFreeBlockHeader*)block)->next;
+    }
+
+    if (!cache_block)
+        return NULL;
+
+    return _btagCarve(cache_block, cache_ptr, sz, cache_padding);
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void* SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::alloc_VMDYNAMIC_BTAG_VMEXPAND(size_t sz, size_t alignment) {
+    // no free block was large enough
+    // grow the arena from the epilogue, absorbing the last block if it is free
+
+    uint32_t vmPageSize = m_vmAllocator->PageSize();
+    size_t* epilogue = (size_t*)((uintptr_t)m_end - tagSize);
+    void* block;
+    size_t blockSize;
+
+    if (*epilogue & TAG_PREV_FREE) {
+        blockSize = *(size_t*)((uintptr_t)epilogue - tagSize);
+        block = (void*)((uintptr_t)epilogue - blockSize);
+        _btagUnlink(block);
+    }
+    else {
+        block = epilogue;
+        blockSize = 0;
+    }
+
+    void* ptr = (void*)(((uintptr_t)block + alignment - 1) & ~(alignment - 1));
+    ptrdiff_t padding = (uintptr_t)ptr - (uintptr_t)block;
+    _fitPadding(padding, alignment);
 
-        if (((FreeBlockHeader*)block)->prev != NULL)
-            prev = (uintptr_t)(((FreeBlockHeader*)block)->prev) - (uintptr_t)m_start;
+    // the new epilogue takes a word from the new pages
+    size_t usedSize = ((padding + sz + TAG_MASK) & ~TAG_MASK) + tagSize;
+    uint32_t n = (uint32_t)ceil((double)(usedSize - blockSize) / vmPageSize);
+    size_t vmAllocSize = (size_t)n * vmPageSize;
 
-        std::cout << " [" << prev << ", " << (uintptr_t)block - (uintptr_t)m_start << ", "
-            << (uintptr_t)block - (uintptr_t)m_start + ((FreeBlockHeader*)block)->sz << ", "
-            << next << "] ";
-        block = ((FreeBlockHeader*)block)->next;
+    void* vmAlloc = m_vmAllocator->Alloc(n);
+    // out of address space, or the pages didn't land right after the arena
+    if (vmAlloc != m_end) {
+        if (vmAlloc)
+            m_vmAllocator->Shrink(n);
+        if (blockSize)
+            _btagPush(block);
+        return NULL;
     }
 
-    std::cout << std::endl;
+    m_nVMPages += n;
+    m_end = (void*)((uintptr_t)m_end + vmAllocSize);
+    m_size += vmAllocSize;
+
+    *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+
+    _btagMarkFree(block, blockSize + vmAllocSize);
+    _btagPush(block);
+
+    return _btagCarve(block, (void*)((uintptr_t)block + padding), sz, padding);
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Release() {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::free_BTAG(void* ptr) {
+    AllocatedBlockHeader* allocHeader = (AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize);
+
+    void* block = (void*)((uintptr_t)ptr - allocHeader->padding);
+    size_t tag = *(size_t*)block;
+
+    if (tag & TAG_FREE)
+        return;
+
+    _statsFree(allocHeader->sz);
+
+    size_t blockSize = tag & ~TAG_MASK;
+    void* next = (void*)((uintptr_t)block + blockSize);
+    size_t nextTag = *(size_t*)next;
+
+    // merge with the left neighbour, its footer sits right before our tag
+    if (tag & TAG_PREV_FREE) {
+        size_t prevSize = *(size_t*)((uintptr_t)block - tagSize);
+        block = (void*)((uintptr_t)block - prevSize);
+        blockSize += prevSize;
+        _btagUnlink(block);
+    }
+
+    // merge with the right neighbour
+    if (nextTag & TAG_FREE) {
+        blockSize += nextTag & ~TAG_MASK;
+        _btagUnlink(next);
+    }
+
+    _btagMarkFree(block, blockSize);
+    _btagPush(block);
+
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        _VMDYNAMIC_VMSHRINK();
+    }
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Layout() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    std::cout << ((uintptr_t)m_end - (uintptr_t)m_start) << "\nNum of committed VM pages: " << m_nVMPages << "\n";
+
+    while (_walk(cursor, block)) {
+        _layoutBlock(block);
+        report.Add(block);
+    }
+
+    _layoutReport(report);
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+bool SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    return _walk(cursor, block);
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+HeapReport SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Report() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    while (_walk(cursor, block))
+        report.Add(block);
+
+    return report;
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+AllocatorPersistentState SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::SaveState() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+
+    AllocatorPersistentState state;
+    state.base = (uint64_t)(uintptr_t)m_start;
+    state.head = m_llStart ? (uint64_t)((uintptr_t)m_llStart - (uintptr_t)m_start) : AllocatorPersistentState::NIL;
+    state.tail = m_llEnd ? (uint64_t)((uintptr_t)m_llEnd - (uintptr_t)m_start) : AllocatorPersistentState::NIL;
+    return state;
+}
+
+/*
+* Blocks tile the arena, the walk goes from one block to the next by its size.
+* BOUNDARY_TAG: the tag tells the size and whether the block is free, the epilogue (size 0) ends the walk.
+* ADDRESS_ORDERED: cursor.aux is the next free block of the list, a block that isn't it is used,
+* its first word is the padding, the header behind it has the size.
+*/
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+bool SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::_walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    if (!m_initialized)
+        return false;
+
+    if (!cursor.block) {
+        cursor.block = m_start;
+        cursor.aux = m_llStart;
+    }
+
+    uintptr_t cur = (uintptr_t)cursor.block;
+
+    if constexpr(isBoundaryTagged) {
+        if (cur >= (uintptr_t)m_end - tagSize)
+            return false;
+
+        size_t tag = *(size_t*)cur;
+        if (!(tag & ~TAG_MASK))
+            return false;
+
+        block.size = tag & ~TAG_MASK;
+        block.free = (tag & TAG_FREE) != 0;
+        block.padding = block.free ? 0 : *(size_t*)(cur + tagSize);
+    }
+    else {
+        if (cur >= (uintptr_t)m_end)
+            return false;
+
+        if (cur == (uintptr_t)cursor.aux) {
+            block.size = ((FreeBlockHeader*)cur)->sz;
+            block.free = true;
+            block.padding = 0;
+            cursor.aux = ((FreeBlockHeader*)cur)->next;
+        }
+        else {
+            size_t padding = *(size_t*)cur;
+            block.size = padding + ((AllocatedBlockHeader*)(cur + padding - allocHeaderSize))->sz;
+            block.free = false;
+            block.padding = padding;
+        }
+    }
+
+    block.offset = cur - (uintptr_t)m_start;
+    cursor.block = (void*)(cur + block.size);
+    return true;
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+bool SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::RegisterPages(Allocator* owner) {
+    // VMDYNAMIC: the whole reservation, pages committed later are covered too
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Register(m_start, sz, owner ? owner : this);
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::UnregisterPages() {
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Unregister(m_start, sz);
+}
+
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Release() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
     if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
     }
     else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
@@ -503,14 +940,17 @@ void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Release() {
     return;
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::Reset() {
-    ZeroMem();
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::Reset() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
+    memset(m_start, 0, m_size);
     build();
 }
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN>::ZeroMem() {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST, typename _LOCK_POLICY>
+void SequentialListAllocator<_ALLOC_BUFFER, _ALLOC_PATTERN, _ALLOC_FREELIST, _LOCK_POLICY>::ZeroMem() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     memset(m_start, 0, m_size);
 }
 
@@ -519,4 +959,49 @@ template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_
 template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT>;
 template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT>;
 template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT>;
-template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT>;
\ No newline at end of file
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>;
+
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN>;
+
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX>;
+
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
+template class SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET>;
@@ -2,6 +2,7 @@
 
 #include "Allocator.h"
 #include "VMLinearAllocator.h"
+#include "LockPolicy.h"
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
@@ -23,17 +24,28 @@ Note:
 2-6X faster allocations (unless a new page is committed)
 2-10X faster free in a LIFO or FIFO order
 10-20X slower free in a random order
+
+Free list modes:
+ALLOC_FREELIST_ADDRESS_ORDERED keeps the free blocks sorted by address, 
+first fit then favours the start of the arena, but Free has to walk the list.
+ALLOC_FREELIST_BOUNDARY_TAG tags both ends of every free block (and the start of every allocated block),
+so Free merges with its physical neighbours in O(1) and pushes the result to the front of an unordered list.
 */
 
-template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
-class SequentialListAllocator : public Allocator {
+template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN, typename _ALLOC_FREELIST = ALLOC_FREELIST_ADDRESS_ORDERED, typename _LOCK_POLICY = ALLOC_LOCK_NONE>
+class SequentialListAllocator : public Allocator, protected AllocatorLock<_LOCK_POLICY> {
 
 public:
     // STATIC & VMDYNAMIC
-    SequentialListAllocator(size_t sz);
+    // largePages: VMDYNAMIC only, back the arena with large pages when the process is allowed to
+    // numaNode: VMDYNAMIC only, commit the arena on this NUMA node
+    SequentialListAllocator(size_t sz, bool largePages = false, DWORD numaNode = NUMA_NO_PREFERRED_NODE);
 
     // STATIC PREALLOC
     SequentialListAllocator(void* buffer, size_t sz);
+    // STATIC PREALLOC, adopts the heap an earlier allocator left in the buffer instead of building a new one,
+    // state is what SaveState() returned then, the free list links are rebased when the buffer moved
+    SequentialListAllocator(void* buffer, size_t sz, const AllocatorPersistentState& state);
 
     ~SequentialListAllocator();
 
@@ -45,6 +57,19 @@ public:
     inline void ZeroMem() final;
 
     void Layout() final;
+
+    // ptr lies in the arena
+    bool Owns(const void* ptr) final;
+    // maps the arena (the whole reservation in VMDYNAMIC mode) in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    // blocks in address order, see HeapWalk.h
+    bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    HeapReport Report() final;
+
+    // STATIC PREALLOC, the free list ends as offsets from the buffer
+    AllocatorPersistentState SaveState();
     
 protected:
     struct FreeBlockHeader {
@@ -53,9 +78,20 @@ protected:
         size_t sz;
     };
 
+    // the padding comes first, with the minimum padding it's the first word of the block (the word after the tag in BOUNDARY_TAG mode),
+    // larger paddings are repeated there, so a heap walk finds the header from the start of the block
     struct AllocatedBlockHeader {
-        size_t sz;
         size_t padding;
+        size_t sz;
+    };
+
+    // BOUNDARY_TAG mode only
+    // every block starts with a tag holding its size and the TAG_FREE / TAG_PREV_FREE bits,
+    // free blocks repeat the size in their last word (footer)
+    struct TaggedFreeBlockHeader {
+        size_t tag;
+        void* next;
+        void* prev;
     };
 
 private:
@@ -63,7 +99,15 @@ private:
 
     template <typename _ALLOC_BUFFER, typename _ALLOC_PATTERN>
     constexpr inline void* ALLOC(size_t sz, size_t alignment) {
-        if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        if constexpr(std::is_same<_ALLOC_FREELIST, ALLOC_FREELIST_BOUNDARY_TAG>::value) {
+            void* ptr = alloc_BTAG(sz, alignment);
+            if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+                if (!ptr)
+                    ptr = alloc_VMDYNAMIC_BTAG_VMEXPAND(sz, alignment);
+            }
+            return ptr;
+        }
+        else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
             if constexpr(std::is_same<_ALLOC_PATTERN, ALLOC_PATTERN_FIRST_FIT>::value) {
                 return alloc_VMDYNAMIC_FIRST_FIT(sz, alignment);
             }
@@ -87,12 +131,25 @@ private:
     void* alloc_VMDYNAMIC_BEST_FIT(size_t sz, size_t alignment);
 
     void* alloc_VMDYNAMIC_VMEXPAND(size_t sz, size_t alignment);
+    inline void _VMDYNAMIC_VMSHRINK();
+
+    void* alloc_BTAG(size_t sz, size_t alignment);
+    void* alloc_VMDYNAMIC_BTAG_VMEXPAND(size_t sz, size_t alignment);
+    void free_BTAG(void* ptr);
+
+    inline void* _btagCarve(void* block, void* ptr, size_t sz, ptrdiff_t padding);
+    inline void _btagMarkFree(void* block, size_t sz);
+    inline void _btagPush(void* block);
+    inline void _btagUnlink(void* block);
 
     inline void _fitPadding(ptrdiff_t& padding, size_t alignment);
     inline size_t _splitBlock(void* block, void* prevBlock, void* ptr, size_t sz);
     inline void* _fitToBlock(void* block, size_t sz, size_t alignment, ptrdiff_t& leftover, ptrdiff_t& padding);
 
     inline void build();
+    inline void buildBTAG();
+
+    bool _walk(HeapWalkCursor& cursor, HeapBlock& block);
     
     /* VARIABLES */
 
@@ -107,10 +164,27 @@ private:
 
     VMLinearAllocator* m_vmAllocator;
     uint32_t m_nVMPages;
+    uint32_t m_nMinVMPages;
 
     /* CONSTEXPRS */
 
     static constexpr size_t RESERVE_VIRTUAL_ADDRESS_SPACE = 1024 * 1024 * 1024;
+    // hysteresis for VMDYNAMIC: the trailing free block is only decommitted once it spans
+    // more than VM_SHRINK_THRESHOLD pages, and VM_SHRINK_RETAIN pages are kept committed for the next expansion
+    static constexpr uint32_t VM_SHRINK_THRESHOLD = 64;
+    static constexpr uint32_t VM_SHRINK_RETAIN = 16;
     static constexpr size_t allocHeaderSize = sizeof(AllocatedBlockHeader);
     static constexpr size_t freeHeaderSize = sizeof(FreeBlockHeader);
+
+    static constexpr bool isBoundaryTagged = std::is_same<_ALLOC_FREELIST, ALLOC_FREELIST_BOUNDARY_TAG>::value;
+
+    static constexpr size_t tagSize = sizeof(size_t);
+    static constexpr size_t TAG_FREE = 1;
+    static constexpr size_t TAG_PREV_FREE = 2;
+    static constexpr size_t TAG_MASK = tagSize - 1;
+    // header + footer
+    static constexpr size_t minTaggedBlockSize = sizeof(TaggedFreeBlockHeader) + tagSize;
+
+    // allocated blocks need their tag in front of the padding in BOUNDARY_TAG mode
+    static constexpr size_t minPadding = isBoundaryTagged ? tagSize + allocHeaderSize : allocHeaderSize;
 };
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "ShardedAllocator.h"
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::ShardedAllocator(size_t shardSize, uint32_t nShards) {
+    SYSTEM_INFO sSysInfo;
+    GetSystemInfo(&sSysInfo);
+
+    if (!nShards)
+        nShards = sSysInfo.dwNumberOfProcessors;
+    m_nShards = nShards < MAX_SHARDS ? nShards : MAX_SHARDS;
+
+    // page aligned slices
+    m_shardSize = (shardSize + sSysInfo.dwPageSize - 1) & ~((size_t)sSysInfo.dwPageSize - 1);
+
+    m_start = VirtualAlloc(NULL, m_shardSize * m_nShards, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    assert(m_start && "ERR VIRTUALALLOC");
+    m_end = (void*)((uintptr_t)m_start + m_shardSize * m_nShards);
+
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        InitializeSRWLock(&m_shards[i].lock);
+        m_shards[i].allocator = new _SHARD_ALLOCATOR((void*)((uintptr_t)m_start + i * m_shardSize), m_shardSize);
+    }
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::~ShardedAllocator() {
+    for (uint32_t i = 0; i < m_nShards; ++i)
+        delete m_shards[i].allocator;
+
+    VirtualFree(m_start, 0, MEM_RELEASE);
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+uint32_t ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::ShardCount() {
+    return m_nShards;
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+uint32_t ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::_selectShard() {
+    if constexpr(std::is_same<_SHARD_SELECT, ALLOC_SHARD_CPU>::value) {
+        return GetCurrentProcessorNumber() % m_nShards;
+    }
+    else if constexpr(std::is_same<_SHARD_SELECT, ALLOC_SHARD_THREAD>::value) {
+        // fibonacci hashing, consecutive thread ids land far apart
+        return (uint32_t)(((uint64_t)GetCurrentThreadId() * 0x9E3779B97F4A7C15ull) >> 32) % m_nShards;
+    }
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void* ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Alloc(size_t sz, size_t alignment) {
+    uint32_t first = _selectShard();
+
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        Shard& shard = m_shards[(first + i) % m_nShards];
+
+        AcquireSRWLockExclusive(&shard.lock);
+        void* ptr = shard.allocator->Alloc(sz, alignment);
+        ReleaseSRWLockExclusive(&shard.lock);
+
+        if (ptr)
+            return ptr;
+    }
+
+    return NULL;
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    assert((uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end && "PTR ISN'T OWNED BY ANY SHARD");
+    Shard& shard = m_shards[((uintptr_t)ptr - (uintptr_t)m_start) / m_shardSize];
+
+    AcquireSRWLockExclusive(&shard.lock);
+    shard.allocator->Free(ptr);
+    ReleaseSRWLockExclusive(&shard.lock);
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Release() {
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        AcquireSRWLockExclusive(&m_shards[i].lock);
+        m_shards[i].allocator->Release();
+        ReleaseSRWLockExclusive(&m_shards[i].lock);
+    }
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Reset() {
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        AcquireSRWLockExclusive(&m_shards[i].lock);
+        m_shards[i].allocator->Reset();
+        ReleaseSRWLockExclusive(&m_shards[i].lock);
+    }
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::ZeroMem() {
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        AcquireSRWLockExclusive(&m_shards[i].lock);
+        m_shards[i].allocator->ZeroMem();
+        ReleaseSRWLockExclusive(&m_shards[i].lock);
+    }
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Layout() {
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        AcquireSRWLockExclusive(&m_shards[i].lock);
+        std::cout << "Shard " << i << "\n";
+        m_shards[i].allocator->Layout();
+        ReleaseSRWLockExclusive(&m_shards[i].lock);
+    }
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+AllocatorStats ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::GetStats() {
+    AllocatorStats stats = m_shards[0].allocator->GetStats();
+
+    for (uint32_t i = 1; i < m_nShards; ++i)
+        stats.Accumulate(m_shards[i].allocator->GetStats());
+
+    return stats;
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+HeapReport ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Report() {
+    HeapReport report;
+
+    // the shards have no lock of their own, each walk runs under the shard lock
+    for (uint32_t i = 0; i < m_nShards; ++i) {
+        AcquireSRWLockExclusive(&m_shards[i].lock);
+        report.Merge(m_shards[i].allocator->Report());
+        ReleaseSRWLockExclusive(&m_shards[i].lock);
+    }
+
+    return report;
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+bool ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::RegisterPages(Allocator* owner) {
+    AllocatorPageMap::Register(m_start, m_shardSize * m_nShards, owner ? owner : this);
+}
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT>
+void ShardedAllocator<_SHARD_ALLOCATOR, _SHARD_SELECT>::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_start, m_shardSize * m_nShards);
+}
+
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT>>;
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT>>;
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>>;
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>>;
+template class ShardedAllocator<RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>>;
+
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT>, ALLOC_SHARD_THREAD>;
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT>, ALLOC_SHARD_THREAD>;
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>, ALLOC_SHARD_THREAD>;
+template class ShardedAllocator<SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_BEST_FIT, ALLOC_FREELIST_BOUNDARY_TAG>, ALLOC_SHARD_THREAD>;
+template class ShardedAllocator<RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>, ALLOC_SHARD_THREAD>;
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Allocator.h"
+#include "SequentialListAllocator.h"
+#include "RBTreeAllocator.h"
+#include <stdint.h>
+#include <assert.h>
+
+struct ALLOC_SHARD_CPU {};
+struct ALLOC_SHARD_THREAD {};
+
+/*
+K shards of a STATIC_PREALLOC allocator over disjoint, equally sized slices of one reservation, one lock per shard.
+
+Alloc picks a shard by the processor the calling thread runs on (ALLOC_SHARD_CPU)
+or by a hash of its thread id (ALLOC_SHARD_THREAD), and falls through to the next shards when it's full.
+Free finds the owning shard from the address, (ptr - m_start) / m_shardSize, whichever thread frees it.
+With K = number of processors, threads on different cores rarely meet on a lock, contention scales down with the core count.
+
+_SHARD_ALLOCATOR is any allocator taking (void* buffer, size_t sz),
+e.g. SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ...> or RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>.
+*/
+
+template <typename _SHARD_ALLOCATOR, typename _SHARD_SELECT = ALLOC_SHARD_CPU>
+class ShardedAllocator : public Allocator {
+public:
+    // shardSize: arena of every shard, nShards: 0 for one shard per processor
+    ShardedAllocator(size_t shardSize, uint32_t nShards = 0);
+    ~ShardedAllocator();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    void Layout() final;
+
+    // sum of the shards
+    AllocatorStats GetStats() final;
+    // merged reports of the shards
+    HeapReport Report() final;
+
+    // ptr lies in the reservation
+    bool Owns(const void* ptr) final;
+    // maps the reservation in AllocatorPageMap, pointers come back through the shard locks
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    uint32_t ShardCount();
+
+private:
+    // a cache line per shard, the locks of neighbouring shards don't share a line
+    struct alignas(64) Shard {
+        SRWLOCK lock;
+        _SHARD_ALLOCATOR* allocator;
+    };
+
+    inline uint32_t _selectShard();
+
+    static constexpr uint32_t MAX_SHARDS = 64;
+
+    Shard m_shards[MAX_SHARDS];
+    uint32_t m_nShards;
+
+    size_t m_shardSize;
+    void* m_start;
+    void* m_end;
+};
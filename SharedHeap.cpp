@@ -0,0 +1,221 @@
+#include "SharedHeap.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Constructors */
+
+SharedHeap::SharedHeap(const char* name, size_t sz) :
+    m_mutex(NULL), m_mapping(NULL), m_header(NULL), m_heapStart(NULL), m_heapSize(0), m_heap(NULL), m_status(FAILED)
+{
+    char lockName[MAX_NAME];
+    snprintf(lockName, sizeof(lockName), "%s_lock", name);
+
+    // held from before the section exists until its header is written, an opener never sees a half built heap
+    m_mutex = CreateMutexA(NULL, FALSE, lockName);
+    if (!m_mutex)
+        return;
+    DWORD wait = WaitForSingleObject(m_mutex, INFINITE);
+    // WAIT_FAILED, FAILED rather than build or open the heap without the lock
+    if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+        return;
+
+    uint64_t sectionSize = HEADER_SIZE + (uint64_t)sz;
+    m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(sectionSize >> 32), (DWORD)sectionSize, name);
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+    // the whole section, whoever created it
+    void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+    if (!view) {
+        ReleaseMutex(m_mutex);
+        return;
+    }
+
+    m_header = (Header*)view;
+    m_heapStart = (void*)((uintptr_t)view + HEADER_SIZE);
+
+    if (!existed) {
+        memset(m_header, 0, sizeof(Header));
+        m_header->magic = MAGIC;
+        m_header->version = VERSION;
+        m_header->heapSize = sz;
+        m_header->root = NULL_HANDLE;
+
+        m_heapSize = sz;
+        m_heap = new RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>(m_heapStart, m_heapSize);
+        m_header->state = m_heap->SaveState();
+        m_status = CREATED;
+    }
+    else if (m_header->magic == MAGIC && m_header->version == VERSION) {
+        m_heapSize = (size_t)m_header->heapSize;
+        m_heap = new RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>(m_heapStart, m_heapSize, m_header->state);
+        // as in Guard, the previous owner died inside a call
+        if (wait == WAIT_ABANDONED && !m_header->corrupt && !_verify())
+            m_header->corrupt = 1;
+        m_status = m_header->corrupt ? CORRUPT : OPENED;
+    }
+
+    ReleaseMutex(m_mutex);
+}
+
+/* Destructor */
+
+SharedHeap::~SharedHeap() {
+    Release();
+    if (m_mutex)
+        CloseHandle(m_mutex);
+}
+
+SharedHeap::Guard::Guard(SharedHeap& heap) : m_heap(heap), m_locked(false) {
+    DWORD wait = WaitForSingleObject(m_heap.m_mutex, INFINITE);
+    // WAIT_FAILED, the call fails rather than run without the lock
+    if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+        return;
+    m_locked = true;
+
+    m_heap.m_heap->LoadState(m_heap.m_header->state);
+    // the previous owner died inside a call, the blocks or the tree may be half updated
+    if (wait == WAIT_ABANDONED && !m_heap.m_header->corrupt && !m_heap._verify())
+        m_heap.m_header->corrupt = 1;
+}
+
+SharedHeap::Guard::~Guard() {
+    if (!m_locked)
+        return;
+    m_heap.m_header->state = m_heap.m_heap->SaveState();
+    ReleaseMutex(m_heap.m_mutex);
+}
+
+bool SharedHeap::Guard::Locked() const {
+    return m_locked;
+}
+
+bool SharedHeap::_verify() {
+    // the tree first, the walk looks the free blocks up in it
+    uint64_t nNodes, nFreeBlocks;
+    return m_heap->VerifyTree(nNodes) && HeapWalkTiles(*m_heap, m_heapSize, nFreeBlocks) && nFreeBlocks == nNodes;
+}
+
+void* SharedHeap::Alloc(size_t sz, size_t alignment) {
+    if (!m_heap)
+        return NULL;
+
+    Guard guard(*this);
+    if (!guard.Locked() || m_header->corrupt) {
+        _statsFail(sz);
+        return NULL;
+    }
+    return m_heap->Alloc(sz, alignment);
+}
+
+void SharedHeap::Free(void*& ptr) {
+    if (!m_heap || !ptr)
+        return;
+
+    Guard guard(*this);
+    if (!guard.Locked() || m_header->corrupt)
+        return;
+    m_heap->Free(ptr);
+}
+
+SharedHandle SharedHeap::AllocHandle(size_t sz, size_t alignment) {
+    return ToHandle(Alloc(sz, alignment));
+}
+
+void SharedHeap::FreeHandle(SharedHandle handle) {
+    void* ptr = Resolve(handle);
+    Free(ptr);
+}
+
+void SharedHeap::Release() {
+    if (m_heap) {
+        delete m_heap;
+        m_heap = NULL;
+    }
+    if (m_header) {
+        UnmapViewOfFile(m_header);
+        m_header = NULL;
+        m_heapStart = NULL;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = NULL;
+    }
+    m_status = FAILED;
+}
+
+void SharedHeap::Reset() {
+    if (!m_heap)
+        return;
+
+    Guard guard(*this);
+    if (!guard.Locked())
+        return;
+    m_heap->Reset();
+    m_header->root = NULL_HANDLE;
+    m_header->corrupt = 0;
+}
+
+void SharedHeap::ZeroMem() {
+    if (!m_heap)
+        return;
+
+    Guard guard(*this);
+    if (!guard.Locked() || m_header->corrupt)
+        return;
+    m_heap->ZeroMem();
+}
+
+void SharedHeap::Layout() {
+    if (!m_heap)
+        return;
+
+    Guard guard(*this);
+    if (!guard.Locked() || m_header->corrupt)
+        return;
+    m_heap->Layout();
+}
+
+bool SharedHeap::Walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    if (!m_heap)
+        return false;
+
+    Guard guard(*this);
+    // a corrupt tree would send the walk after garbage offsets
+    return guard.Locked() && !m_header->corrupt && m_heap->Walk(cursor, block);
+}
+
+HeapReport SharedHeap::Report() {
+    if (!m_heap)
+        return HeapReport();
+
+    Guard guard(*this);
+    return guard.Locked() && !m_header->corrupt ? m_heap->Report() : HeapReport();
+}
+
+bool SharedHeap::Owns(const void* ptr) {
+    return m_heap && (uintptr_t)ptr >= (uintptr_t)m_heapStart && (uintptr_t)ptr < (uintptr_t)m_heapStart + m_heapSize;
+}
+
+SharedHandle SharedHeap::Root() {
+    if (!m_heap)
+        return NULL_HANDLE;
+
+    Guard guard(*this);
+    return guard.Locked() ? m_header->root : NULL_HANDLE;
+}
+
+void SharedHeap::SetRoot(SharedHandle handle) {
+    if (!m_heap)
+        return;
+
+    Guard guard(*this);
+    if (!guard.Locked())
+        return;
+    m_header->root = handle;
+}
+
+SharedHeap::STATUS SharedHeap::Status() {
+    if (m_header && m_header->corrupt)
+        return CORRUPT;
+    return m_status;
+}
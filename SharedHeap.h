@@ -0,0 +1,127 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "Allocator.h"
+#include "RBTreeAllocator.h"
+#include <stdint.h>
+
+/*
+A heap in a named shared memory section (pagefile backed file mapping), mapped by several processes at once,
+a producer allocates a buffer in place and passes its handle, the consumer resolves the handle and reads it without a copy.
+
+    // ingest                                           // render
+    SharedHeap heap("frames", 256 * MB);                SharedHeap heap("frames", 0);
+    SharedHandle h = heap.AllocHandle(sz, 64);          uint8_t* frame = (uint8_t*)heap.Resolve(h);
+    fill(heap.Resolve(h));                              ...
+    send(socket, &h, sizeof(h));                        heap.FreeHandle(h);
+
+The first process to open a name creates the section with a heap of sz bytes, the others map it as it is (sz is ignored).
+Processes map the section at different addresses, so nothing in it is a pointer:
+the heap is a STATIC_PREALLOC Red Black Tree allocator, its tree links are granule offsets,
+and the root of the tree lives in the header of the section, every call reloads it and saves it back under the lock.
+A handle is the offset of the block from the start of the heap, the same in every process.
+
+The lock is a named mutex, process shared and robust: when a process dies holding it the next owner (a call or a constructor opening the section) is told (WAIT_ABANDONED),
+checks the tree (links, order, red black rules) and walks the heap, if the tree is broken, the blocks don't tile the heap any more
+or the free blocks walked aren't the nodes of the tree, it marks the heap corrupt, every Alloc fails from then on (Status() == CORRUPT).
+Allocations & frees from any process, threads included, serialize on that one lock, a call fails when the wait for it fails.
+*/
+
+typedef uint64_t SharedHandle;
+
+class SharedHeap : public Allocator {
+public:
+    enum STATUS {
+        // this process created the section
+        CREATED,
+        // mapped a section another process created
+        OPENED,
+        // a process died holding the lock and left the heap inconsistent
+        CORRUPT,
+        // the section or the lock couldn't be created or mapped, or the wait for the lock failed
+        FAILED
+    };
+
+    static constexpr SharedHandle NULL_HANDLE = AllocatorPersistentState::NIL;
+
+    // creates or opens the section called name, sz is the heap size when it's created
+    SharedHeap(const char* name, size_t sz);
+    ~SharedHeap();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+    void Free(void*& ptr) final;
+    // unmaps the section, the heap lives on while another process has it mapped
+    void Release() final;
+    // empties the heap for every process, the handles they hold dangle
+    void Reset() final;
+    void ZeroMem() final;
+    void Layout() final;
+    bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    HeapReport Report() final;
+
+    // ptr lies in this process' mapping of the heap
+    bool Owns(const void* ptr) final;
+
+    SharedHandle AllocHandle(size_t sz, size_t alignment);
+    void FreeHandle(SharedHandle handle);
+
+    // the block in this process' mapping, NULL for NULL_HANDLE
+    inline void* Resolve(SharedHandle handle) const;
+    inline SharedHandle ToHandle(const void* ptr) const;
+
+    // a handle every process can find, a directory of the buffers for example, NULL_HANDLE until set
+    SharedHandle Root();
+    void SetRoot(SharedHandle handle);
+
+    STATUS Status();
+
+private:
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t corrupt;
+        uint64_t heapSize;
+        uint64_t root;
+        // the tree root, valid between two calls
+        AllocatorPersistentState state;
+    };
+
+    // holds the named mutex, reloads the tree root, and saves it back when it goes out of scope
+    class Guard {
+    public:
+        Guard(SharedHeap& heap);
+        ~Guard();
+
+        // false when the wait failed, the call has to fail
+        bool Locked() const;
+
+    private:
+        SharedHeap& m_heap;
+        bool m_locked;
+    };
+
+    bool _verify();
+
+    HANDLE m_mutex;
+    HANDLE m_mapping;
+    Header* m_header;
+    void* m_heapStart;
+    size_t m_heapSize;
+    RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>* m_heap;
+    STATUS m_status;
+
+    static constexpr uint64_t MAGIC = 0x5041454844524853;  // "SHRDHEAP"
+    static constexpr uint32_t VERSION = 1;
+    // the heap starts a page into the section
+    static constexpr size_t HEADER_SIZE = 4096;
+    static constexpr size_t MAX_NAME = 256;
+};
+
+void* SharedHeap::Resolve(SharedHandle handle) const {
+    return handle == NULL_HANDLE ? NULL : (void*)((uintptr_t)m_heapStart + handle);
+}
+
+SharedHandle SharedHeap::ToHandle(const void* ptr) const {
+    return ptr ? (SharedHandle)((uintptr_t)ptr - (uintptr_t)m_heapStart) : NULL_HANDLE;
+}
@@ -0,0 +1,238 @@
+#include "SlabAllocator.h"
+#include <iostream>
+
+constexpr size_t SlabAllocator::classSizes[N_SIZE_CLASSES];
+
+SlabAllocator::SlabAllocator(size_t sz) : m_vmAllocator(sz)
+{
+    assert(SLAB_SIZE % m_vmAllocator.PageSize() == 0);
+    m_nVMPagesPerSlab = SLAB_SIZE / m_vmAllocator.PageSize();
+
+    uint32_t c = 0;
+    for (size_t i = 0; i <= MAX_SIZE / MAX_ALIGNMENT; ++i) {
+        while (classSizes[c] < i * MAX_ALIGNMENT)
+            ++c;
+        m_classIndex[i] = (uint8_t)c;
+    }
+
+    for (c = 0; c < N_SIZE_CLASSES; ++c) {
+        SizeClass& sizeClass = m_classes[c];
+        sizeClass.objSize = classSizes[c];
+        sizeClass.objsPerSlab = (uint32_t)((SLAB_SIZE - slabHeaderSize) / sizeClass.objSize);
+
+        // every cache line of the leftover space is one more color
+        size_t leftover = SLAB_SIZE - slabHeaderSize - sizeClass.objsPerSlab * sizeClass.objSize;
+        sizeClass.nColors = (uint32_t)(leftover / CACHE_LINE_SIZE) + 1;
+    }
+
+    build();
+}
+
+SlabAllocator::~SlabAllocator() {
+}
+
+void SlabAllocator::build() {
+    for (uint32_t c = 0; c < N_SIZE_CLASSES; ++c) {
+        SizeClass& sizeClass = m_classes[c];
+        sizeClass.nextColor = 0;
+        sizeClass.nEmpty = 0;
+        sizeClass.partial = NULL;
+        sizeClass.full = NULL;
+        sizeClass.empty = NULL;
+    }
+}
+
+void SlabAllocator::_pushSlab(SlabHeader*& list, SlabHeader* slab) {
+    slab->prev = NULL;
+    slab->next = list;
+    if (list)
+        list->prev = slab;
+    list = slab;
+}
+
+void SlabAllocator::_removeSlab(SlabHeader*& list, SlabHeader* slab) {
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        list = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+}
+
+SlabAllocator::SlabHeader* SlabAllocator::_newSlab(uint32_t c) {
+    SizeClass& sizeClass = m_classes[c];
+
+    void* mem = m_vmAllocator.Alloc((uint32_t)m_nVMPagesPerSlab);
+    if (!mem)
+        return NULL;
+
+    assert(((uintptr_t)mem & (SLAB_SIZE - 1)) == 0 && "SLAB IS NOT ALIGNED");
+
+    SlabHeader* slab = new(mem) SlabHeader;
+    slab->nUsed = 0;
+    slab->sizeClass = c;
+    slab->color = (uint32_t)(sizeClass.nextColor * CACHE_LINE_SIZE);
+    sizeClass.nextColor = (sizeClass.nextColor + 1) % sizeClass.nColors;
+
+    // thread the slots into a free list
+    uintptr_t slot = (uintptr_t)mem + slabHeaderSize + slab->color;
+    FreeSlotHeader header;
+
+    for (uint32_t i = 0; i < sizeClass.objsPerSlab - 1; ++i) {
+        header.ptr = (void*)(slot + sizeClass.objSize);
+        memcpy((void*)slot, &header, sizeof(FreeSlotHeader));
+        slot += sizeClass.objSize;
+    }
+
+    header.ptr = NULL;
+    memcpy((void*)slot, &header, sizeof(FreeSlotHeader));
+
+    slab->llStart = (void*)((uintptr_t)mem + slabHeaderSize + slab->color);
+
+    return slab;
+}
+
+void* SlabAllocator::Alloc(size_t sz, size_t alignment) {
+    assert((alignment & (alignment - 1)) == 0);
+
+    // slots are MAX_ALIGNMENT aligned, larger requests should go to a general purpose allocator,
+    // fails rather than asserts, so a Segregator or FallbackAllocator can hand them on
+    if (sz > MAX_SIZE || alignment > MAX_ALIGNMENT) {
+        _statsFail(sz);
+        return NULL;
+    }
+
+    uint32_t c = m_classIndex[(sz + MAX_ALIGNMENT - 1) / MAX_ALIGNMENT];
+    SizeClass& sizeClass = m_classes[c];
+
+    SlabHeader* slab = sizeClass.partial;
+
+    if (!slab) {
+        slab = sizeClass.empty;
+        if (slab) {
+            _removeSlab(sizeClass.empty, slab);
+            --sizeClass.nEmpty;
+        }
+        else {
+            slab = _newSlab(c);
+            if (!slab) {
+                _statsFail(sz);
+                return NULL;
+            }
+        }
+        _pushSlab(sizeClass.partial, slab);
+    }
+
+    void* ptr = slab->llStart;
+    slab->llStart = ((FreeSlotHeader*)ptr)->ptr;
+
+    if (++slab->nUsed == sizeClass.objsPerSlab) {
+        _removeSlab(sizeClass.partial, slab);
+        _pushSlab(sizeClass.full, slab);
+    }
+
+    _statsAlloc(sz, sizeClass.objSize);
+
+    return ptr;
+}
+
+void SlabAllocator::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    SlabHeader* slab = (SlabHeader*)((uintptr_t)ptr & ~(SLAB_SIZE - 1));
+    SizeClass& sizeClass = m_classes[slab->sizeClass];
+
+    FreeSlotHeader* header = new(ptr) FreeSlotHeader;
+    header->ptr = slab->llStart;
+    slab->llStart = ptr;
+    ptr = NULL;
+
+    _statsFree(sizeClass.objSize);
+
+    if (slab->nUsed-- == sizeClass.objsPerSlab) {
+        _removeSlab(sizeClass.full, slab);
+        _pushSlab(sizeClass.partial, slab);
+    }
+
+    if (slab->nUsed == 0) {
+        _removeSlab(sizeClass.partial, slab);
+
+        if (sizeClass.nEmpty < MAX_EMPTY_SLABS) {
+            _pushSlab(sizeClass.empty, slab);
+            ++sizeClass.nEmpty;
+        }
+        else {
+            m_vmAllocator.Free(slab);
+        }
+    }
+}
+
+bool SlabAllocator::Owns(const void* ptr) {
+    return m_vmAllocator.Owns(ptr);
+}
+
+void SlabAllocator::RegisterPages(Allocator* owner) {
+    RegisterPages(owner, 0);
+}
+
+void SlabAllocator::RegisterPages(Allocator* owner, uint32_t sizeClass) {
+    AllocatorPageMap::Register(m_vmAllocator.Start(), m_vmAllocator.Size(), owner ? owner : this, sizeClass);
+}
+
+void SlabAllocator::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_vmAllocator.Start(), m_vmAllocator.Size());
+}
+
+size_t SlabAllocator::UsableSize(void* ptr) {
+    SlabHeader* slab = (SlabHeader*)((uintptr_t)ptr & ~(SLAB_SIZE - 1));
+    return m_classes[slab->sizeClass].objSize;
+}
+
+void SlabAllocator::Release() {
+    _statsReset();
+    m_vmAllocator.Release();
+    build();
+}
+
+void SlabAllocator::Reset() {
+    _statsReset();
+    Release();
+}
+
+// zeroes the free slots (but their links), allocated objects are left untouched
+void SlabAllocator::ZeroMem() {
+    for (uint32_t c = 0; c < N_SIZE_CLASSES; ++c) {
+        SizeClass& sizeClass = m_classes[c];
+        SlabHeader* lists[2] = { sizeClass.partial, sizeClass.empty };
+
+        for (int i = 0; i < 2; ++i) {
+            for (SlabHeader* slab = lists[i]; slab; slab = slab->next) {
+                for (void* slot = slab->llStart; slot; slot = ((FreeSlotHeader*)slot)->ptr)
+                    memset((void*)((uintptr_t)slot + sizeof(FreeSlotHeader)), 0, sizeClass.objSize - sizeof(FreeSlotHeader));
+            }
+        }
+    }
+}
+
+void SlabAllocator::Layout() {
+    for (uint32_t c = 0; c < N_SIZE_CLASSES; ++c) {
+        SizeClass& sizeClass = m_classes[c];
+        uint32_t nPartial = 0, nFull = 0, nEmpty = 0;
+
+        for (SlabHeader* slab = sizeClass.partial; slab; slab = slab->next)
+            ++nPartial;
+        for (SlabHeader* slab = sizeClass.full; slab; slab = slab->next)
+            ++nFull;
+        for (SlabHeader* slab = sizeClass.empty; slab; slab = slab->next)
+            ++nEmpty;
+
+        if (!nPartial && !nFull && !nEmpty)
+            continue;
+
+        std::cout << "Class " << sizeClass.objSize << " (" << sizeClass.objsPerSlab << " objs, "
+            << sizeClass.nColors << " colors): partial " << nPartial << " full " << nFull
+            << " empty " << nEmpty << "\n";
+    }
+    std::cout << std::endl;
+}
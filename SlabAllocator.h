@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Allocator.h"
+#include "VMAllocator.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <memory>
+
+/*
+Slab allocator (Bonwick)
+
+Every size class owns three lists of slabs: partial, full and empty.
+A slab is a SLAB_SIZE run of pages from the buddy VMAllocator, cut into equal slots
+that are threaded into a free list, just like PoolAllocator pages.
+Slabs are SLAB_SIZE aligned (the VM reservation is aligned to the 64KB allocation granularity),
+so the slab header of any object is found by masking the pointer.
+
+Slab coloring: the space left over at the end of a slab is used to shift the first object
+by a different multiple of the cache line in consecutive slabs,
+so that the same slot in different slabs doesn't map to the same cache sets.
+
+Up to MAX_EMPTY_SLABS empty slabs are cached per class before they are given back to the VM.
+*/
+
+class SlabAllocator : public Allocator {
+public:
+    // sz: virtual address space to reserve for slabs
+    SlabAllocator(size_t sz);
+    ~SlabAllocator();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    void Layout() final;
+
+    // ptr lies in the slab reservation
+    bool Owns(const void* ptr) final;
+    // maps the slab reservation in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void RegisterPages(Allocator* owner, uint32_t sizeClass);
+    void UnregisterPages() final;
+    // size of the slot holding ptr
+    size_t UsableSize(void* ptr);
+
+protected:
+    struct FreeSlotHeader {
+        void* ptr;
+    };
+
+    struct SlabHeader {
+        SlabHeader* next;
+        SlabHeader* prev;
+        void* llStart;
+        uint32_t nUsed;
+        uint32_t color;
+        uint32_t sizeClass;
+    };
+
+    struct SizeClass {
+        size_t objSize;
+        uint32_t objsPerSlab;
+        uint32_t nColors;
+        uint32_t nextColor;
+        uint32_t nEmpty;
+
+        SlabHeader* partial;
+        SlabHeader* full;
+        SlabHeader* empty;
+    };
+
+private:
+    void build();
+
+    SlabHeader* _newSlab(uint32_t sizeClass);
+    inline void _pushSlab(SlabHeader*& list, SlabHeader* slab);
+    inline void _removeSlab(SlabHeader*& list, SlabHeader* slab);
+
+    VMAllocator m_vmAllocator;
+
+    /* CONSTEXPRS */
+
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t MAX_ALIGNMENT = 16;
+    static constexpr uint32_t MAX_EMPTY_SLABS = 2;
+    static constexpr uint32_t N_SIZE_CLASSES = 14;
+    static constexpr size_t MAX_SIZE = 2048;
+    static constexpr size_t slabHeaderSize = (sizeof(SlabHeader) + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+
+    static constexpr size_t classSizes[N_SIZE_CLASSES] = {
+        16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+    };
+
+    /* VARIABLES */
+
+    SizeClass m_classes[N_SIZE_CLASSES];
+    // size class of every MAX_ALIGNMENT step up to MAX_SIZE
+    uint8_t m_classIndex[MAX_SIZE / MAX_ALIGNMENT + 1];
+
+    size_t m_nVMPagesPerSlab;
+};
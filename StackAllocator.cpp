@@ -1,28 +1,36 @@
 #include "StackAllocator.h"
 
-StackAllocator::StackAllocator(size_t sz) : m_size(sz), m_free(sz), m_preAlloc(false), m_initialized(false) {
+template <typename _LOCK_POLICY>
+StackAllocator<_LOCK_POLICY>::StackAllocator(size_t sz) : m_size(sz), m_free(sz), m_preAlloc(false), m_initialized(false) {
     m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
     m_end = (void*) ((uintptr_t)m_start + m_size * sizeof(uint8_t));
     m_cur = m_start;
     m_initialized = true;
 }
 
-StackAllocator::StackAllocator(void* buffer, size_t sz) : m_size(sz), m_free(sz), m_preAlloc(true), m_initialized(true) {
+template <typename _LOCK_POLICY>
+StackAllocator<_LOCK_POLICY>::StackAllocator(void* buffer, size_t sz) : m_size(sz), m_free(sz), m_preAlloc(true), m_initialized(true) {
     m_start = buffer;
     m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+    m_cur = m_start;
 }
 
-StackAllocator::~StackAllocator() {
+template <typename _LOCK_POLICY>
+StackAllocator<_LOCK_POLICY>::~StackAllocator() {
     if (m_preAlloc || !m_initialized)
         return;
     free(m_start);
 }
 
-void StackAllocator::Layout() {
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::Layout() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     std::cout << ((uintptr_t)m_end - (uintptr_t)m_start) << std::endl;
 }
 
-void* StackAllocator::Alloc(size_t sz, size_t alignment) {
+template <typename _LOCK_POLICY>
+void* StackAllocator<_LOCK_POLICY>::Alloc(size_t sz, size_t alignment) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     if (!m_initialized)
         return nullptr;
 
@@ -46,10 +54,13 @@ void* StackAllocator::Alloc(size_t sz, size_t alignment) {
     uintptr_t blockEnd = ptr + sz;
 
     if (blockEnd > (uintptr_t)m_end) {
-        assert(false && "Stack allocator full!");
+        // no assert, a FallbackAllocator hands the request to its secondary
+        _statsFail(sz);
         return nullptr;
     }
 
+    _statsAlloc(sz, padding + sz);
+
     void* headerPtr = (void*)((uintptr_t)ptr - headerSize);
     AllocHeader* header = new(headerPtr) AllocHeader;
     header->padding = padding;
@@ -64,26 +75,58 @@ void* StackAllocator::Alloc(size_t sz, size_t alignment) {
     return (void*)ptr;
 }
 
-void StackAllocator::Free(void*& ptr) {
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::Free(void*& ptr) {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     if (!ptr)
         return;
 
     AllocHeader* header = (AllocHeader*) ((uintptr_t)ptr - sizeof(AllocHeader));
+    void* prevCur = m_cur;
     m_cur = (void*) ((uintptr_t)ptr - header->padding);
+    _statsFree((uintptr_t)prevCur - (uintptr_t)m_cur);
     ptr = NULL;
 }
 
-void StackAllocator::Release() {
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::Release() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
     if (m_preAlloc)
         return;
     free(m_start);
     m_initialized = false;
 }
 
-void StackAllocator::Reset() {
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::Reset() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
+    _statsReset();
     m_cur = m_start;
 }
 
-void StackAllocator::ZeroMem() {
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::ZeroMem() {
+    AllocatorLockGuard<_LOCK_POLICY> guard(*this);
     memset(m_start, 0, m_size);
 }
+
+template <typename _LOCK_POLICY>
+bool StackAllocator<_LOCK_POLICY>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::RegisterPages(Allocator* owner) {
+    AllocatorPageMap::Register(m_start, m_size, owner ? owner : this);
+}
+
+template <typename _LOCK_POLICY>
+void StackAllocator<_LOCK_POLICY>::UnregisterPages() {
+    AllocatorPageMap::Unregister(m_start, m_size);
+}
+
+template class StackAllocator<ALLOC_LOCK_NONE>;
+template class StackAllocator<ALLOC_LOCK_SPIN>;
+template class StackAllocator<ALLOC_LOCK_MUTEX>;
+template class StackAllocator<ALLOC_LOCK_TICKET>;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Allocator.h"
+#include "LockPolicy.h"
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
@@ -8,7 +9,8 @@
 #include <stddef.h>
 #include <memory>
 
-class StackAllocator : public Allocator {
+template <typename _LOCK_POLICY = ALLOC_LOCK_NONE>
+class StackAllocator : public Allocator, protected AllocatorLock<_LOCK_POLICY> {
 public:
     StackAllocator(size_t sz);
     StackAllocator(void* buffer, size_t sz);
@@ -21,6 +23,12 @@ public:
     inline void ZeroMem() final;
     inline void Layout() final;
 
+    // ptr lies in the buffer
+    bool Owns(const void* ptr) final;
+    // maps the buffer in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
 protected:
 
     struct AllocHeader {
@@ -10,11 +10,21 @@ SystemAllocator::SystemAllocator(){
 SystemAllocator::~SystemAllocator() {
 }
 
+// the block size isn't known on free, only the counts and the histogram are kept
 void* SystemAllocator::Alloc(size_t sz, size_t alignment) {
-    return _aligned_malloc(alignment, sz);
+    void* p = _aligned_malloc(sz, alignment);
+
+    if (p)
+        _statsAlloc(sz, 0);
+    else
+        _statsFail(sz);
+
+    return p;
 }
 
 void SystemAllocator::Free(void*& p) {
+    if (p)
+        _statsFree(0);
     _aligned_free(p);
 }
 
@@ -29,3 +39,9 @@ void SystemAllocator::ZeroMem() {
 
 void SystemAllocator::Layout() {
 }
+
+// the CRT heap is shared with every other malloc in the process, a block can't be told apart,
+// so a SystemAllocator only works as the last resort of a combinator (FallbackAllocator secondary, Segregator large side)
+bool SystemAllocator::Owns(const void* ptr) {
+    return false;
+}
@@ -19,4 +19,7 @@ public:
     inline void Reset() final;
     inline void ZeroMem() final;
     inline void Layout() final;
+
+    // always false, see the definition
+    bool Owns(const void* ptr) final;
 };
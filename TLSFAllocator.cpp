@@ -0,0 +1,502 @@
+#include "TLSFAllocator.h"
+
+template <typename _ALLOC_BUFFER>
+TLSFAllocator<_ALLOC_BUFFER>::TLSFAllocator(size_t sz) :
+    m_size(sz), m_start(NULL), m_end(NULL), m_initialized(false),
+    m_vmAllocator(NULL), m_nVMPages(0)
+{
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
+        m_size &= ~TAG_MASK;
+        m_start = (uint8_t*)malloc(m_size * sizeof(uint8_t));
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        m_initialized = true;
+        build();
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        m_vmAllocator = new VMLinearAllocator(RESERVE_VIRTUAL_ADDRESS_SPACE);
+
+        uint32_t vmPageSize = m_vmAllocator->PageSize();
+        uint32_t n = (uint32_t)ceil((double)sz / vmPageSize);
+        size_t vmAllocSize = (size_t)n * vmPageSize;
+
+        m_start = m_vmAllocator->Alloc(n);
+        m_end = (void*)((uintptr_t)m_start + vmAllocSize);
+        m_size = vmAllocSize;
+        m_nVMPages = n;
+        m_initialized = true;
+        build();
+    }
+    else {
+        assert(false && "BUFFER WASN'T PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
+}
+
+template <typename _ALLOC_BUFFER>
+TLSFAllocator<_ALLOC_BUFFER>::TLSFAllocator(void* buffer, size_t sz) :
+    m_size(sz), m_start(NULL), m_end(NULL), m_initialized(true),
+    m_vmAllocator(NULL), m_nVMPages(0)
+{
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+        assert(((uintptr_t)buffer & TAG_MASK) == 0);
+        m_size &= ~TAG_MASK;
+        m_start = buffer;
+        m_end = (void*)((uintptr_t)m_start + m_size * sizeof(uint8_t));
+        build();
+    }
+    else {
+        assert(false && "BUFFER PROVIDED IN CTOR. TEMPLATE & ARGUMENT MISMATCH! MAKE SURE YOU \
+            INSTANTIATE RIGHT CLASS AND CALL THE RIGHT CONSTRUCTOR.");
+        return;
+    }
+}
+
+template <typename _ALLOC_BUFFER>
+TLSFAllocator<_ALLOC_BUFFER>::~TLSFAllocator() {
+    if (m_initialized)
+        Release();
+    if (m_vmAllocator)
+        delete m_vmAllocator;
+}
+
+/*
+* The last word of the arena is an epilogue tag of size 0 that is never free,
+* so merging with the right neighbour never runs past m_end.
+*/
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::build() {
+    assert(m_size >= minBlockSize + tagSize && m_size < ((size_t)1 << FL_INDEX_MAX));
+
+    m_flBitmap = 0;
+    memset(m_slBitmap, 0, sizeof(m_slBitmap));
+    memset(m_blocks, 0, sizeof(m_blocks));
+
+    *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+
+    _markFree(m_start, m_size - tagSize);
+    _insertFreeBlock(m_start);
+}
+
+template <typename _ALLOC_BUFFER>
+uint32_t TLSFAllocator<_ALLOC_BUFFER>::_fls(size_t x) {
+    // index of the most significant set bit, x != 0
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (uint32_t)index;
+#else
+    return 63 - (uint32_t)__builtin_clzll(x);
+#endif
+}
+
+template <typename _ALLOC_BUFFER>
+uint32_t TLSFAllocator<_ALLOC_BUFFER>::_ffs(uint32_t x) {
+    // index of the least significant set bit, x != 0
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(x);
+#endif
+}
+
+// list that a free block of size sz belongs to
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::_mappingInsert(size_t sz, uint32_t& fl, uint32_t& sl) {
+    if (sz < SMALL_BLOCK_SIZE) {
+        fl = 0;
+        sl = (uint32_t)sz / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+    }
+    else {
+        fl = _fls(sz);
+        sl = (uint32_t)(sz >> (fl - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+        fl -= FL_INDEX_SHIFT - 1;
+    }
+}
+
+// first list whose every block fits sz, round the size up to the next second level boundary
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::_mappingSearch(size_t sz, uint32_t& fl, uint32_t& sl) {
+    if (sz >= SMALL_BLOCK_SIZE)
+        sz += ((size_t)1 << (_fls(sz) - SL_INDEX_COUNT_LOG2)) - 1;
+    _mappingInsert(sz, fl, sl);
+}
+
+template <typename _ALLOC_BUFFER>
+void* TLSFAllocator<_ALLOC_BUFFER>::_findSuitableBlock(uint32_t& fl, uint32_t& sl) {
+    if (fl >= FL_INDEX_COUNT)
+        return NULL;
+
+    uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+
+    if (!slMap) {
+        // no list on this level, take the smallest non-empty first level above
+        uint32_t flMap = fl + 1 < FL_INDEX_COUNT ? m_flBitmap & (~0u << (fl + 1)) : 0;
+        if (!flMap)
+            return NULL;
+
+        fl = _ffs(flMap);
+        slMap = m_slBitmap[fl];
+    }
+
+    sl = _ffs(slMap);
+    return m_blocks[fl][sl];
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::_insertFreeBlock(void* block) {
+    FreeBlockHeader* header = (FreeBlockHeader*)block;
+    uint32_t fl, sl;
+    _mappingInsert(header->tag & ~TAG_MASK, fl, sl);
+
+    header->prev = NULL;
+    header->next = m_blocks[fl][sl];
+    if (header->next)
+        ((FreeBlockHeader*)header->next)->prev = block;
+
+    m_blocks[fl][sl] = block;
+    m_flBitmap |= 1u << fl;
+    m_slBitmap[fl] |= 1u << sl;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::_removeFreeBlock(void* block) {
+    FreeBlockHeader* header = (FreeBlockHeader*)block;
+    uint32_t fl, sl;
+    _mappingInsert(header->tag & ~TAG_MASK, fl, sl);
+
+    if (header->next)
+        ((FreeBlockHeader*)header->next)->prev = header->prev;
+
+    if (header->prev) {
+        ((FreeBlockHeader*)header->prev)->next = header->next;
+    }
+    else {
+        m_blocks[fl][sl] = header->next;
+        if (!header->next) {
+            m_slBitmap[fl] &= ~(1u << sl);
+            if (!m_slBitmap[fl])
+                m_flBitmap &= ~(1u << fl);
+        }
+    }
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::_markFree(void* block, size_t sz) {
+    // a free block never has a free left neighbour, they would have been merged
+    ((FreeBlockHeader*)block)->tag = sz | TAG_FREE;
+    *(size_t*)((uintptr_t)block + sz - tagSize) = sz;
+    *(size_t*)((uintptr_t)block + sz) |= TAG_PREV_FREE;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::_fitPadding(ptrdiff_t& padding, size_t alignment) {
+    // if can't fit the tag and the header into the padding
+    if (padding < (ptrdiff_t)minPadding) {
+        if ((minPadding - padding) % alignment == 0) {
+            padding = minPadding;
+        }
+        else {
+            padding += alignment * (1 + (minPadding - padding) / alignment);
+        }
+    }
+}
+
+// block is free and already removed from its list
+template <typename _ALLOC_BUFFER>
+void* TLSFAllocator<_ALLOC_BUFFER>::_carve(void* block, size_t sz, size_t alignment) {
+    size_t blockSize = ((FreeBlockHeader*)block)->tag & ~TAG_MASK;
+
+    void* ptr = (void*)(((uintptr_t)block + alignment - 1) & ~(alignment - 1));
+    ptrdiff_t padding = (uintptr_t)ptr - (uintptr_t)block;
+    _fitPadding(padding, alignment);
+    ptr = (void*)((uintptr_t)block + padding);
+
+    // the block has to hold the free header & footer once it's freed
+    size_t usedSize = (padding + sz + TAG_MASK) & ~TAG_MASK;
+    if (usedSize < minBlockSize)
+        usedSize = minBlockSize;
+    assert(usedSize <= blockSize);
+
+    if (blockSize - usedSize >= minBlockSize) {
+        // the remainder goes back to its list
+        void* newBlock = (void*)((uintptr_t)block + usedSize);
+        _markFree(newBlock, blockSize - usedSize);
+        _insertFreeBlock(newBlock);
+        blockSize = usedSize;
+    }
+    else {
+        *(size_t*)((uintptr_t)block + blockSize) &= ~TAG_PREV_FREE;
+    }
+
+    ((FreeBlockHeader*)block)->tag = blockSize;
+
+    AllocatedBlockHeader* allocHeader = new((void*)((uintptr_t)ptr - allocHeaderSize)) AllocatedBlockHeader;
+    allocHeader->sz = blockSize - padding;
+    allocHeader->padding = padding;
+    *(size_t*)((uintptr_t)block + tagSize) = padding;
+
+    return ptr;
+}
+
+template <typename _ALLOC_BUFFER>
+void* TLSFAllocator<_ALLOC_BUFFER>::Alloc(size_t sz, size_t alignment) {
+    assert((alignment & (alignment - 1)) == 0);
+
+    // blocks are only granule aligned, reserve the worst case padding up front
+    // so that any block in the list we pick is guaranteed to fit
+    size_t worstPadding = minPadding + (alignment > tagSize ? alignment - tagSize : 0);
+
+    // above the largest class, the rounding would wrap
+    if (sz > MAX_BLOCK_SIZE - worstPadding) {
+        _statsFail(sz);
+        return NULL;
+    }
+
+    size_t blockSize = (sz + worstPadding + TAG_MASK) & ~TAG_MASK;
+    if (blockSize < minBlockSize)
+        blockSize = minBlockSize;
+
+    uint32_t fl, sl;
+    _mappingSearch(blockSize, fl, sl);
+
+    void* block = _findSuitableBlock(fl, sl);
+
+    if (block) {
+        _removeFreeBlock(block);
+    }
+    else {
+        if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+            block = alloc_VMDYNAMIC_VMEXPAND(blockSize);
+        }
+        if (!block) {
+            _statsFail(sz);
+            return NULL;
+        }
+    }
+
+    void* ptr = _carve(block, sz, alignment);
+    _statsAlloc(sz, ((AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize))->sz);
+
+    return ptr;
+}
+
+template <typename _ALLOC_BUFFER>
+void* TLSFAllocator<_ALLOC_BUFFER>::alloc_VMDYNAMIC_VMEXPAND(size_t sz) {
+    // no list could serve the request
+    // grow the arena from the epilogue, absorbing the last block if it is free
+    uint32_t vmPageSize = m_vmAllocator->PageSize();
+    size_t* epilogue = (size_t*)((uintptr_t)m_end - tagSize);
+    void* block;
+    size_t blockSize;
+
+    if (*epilogue & TAG_PREV_FREE) {
+        blockSize = *(size_t*)((uintptr_t)epilogue - tagSize);
+        block = (void*)((uintptr_t)epilogue - blockSize);
+        _removeFreeBlock(block);
+    }
+    else {
+        block = epilogue;
+        blockSize = 0;
+    }
+
+    // the search rounds up to the next class, the tail block may be in the request's own class and fit already
+    if (blockSize >= sz)
+        return block;
+
+    // the new epilogue takes a word from the new pages
+    uint32_t n = (uint32_t)ceil((double)(sz + tagSize - blockSize) / vmPageSize);
+    size_t vmAllocSize = (size_t)n * vmPageSize;
+
+    void* vmAlloc = m_vmAllocator->Alloc(n);
+    // out of address space, or the pages didn't land right after the arena
+    if (vmAlloc != m_end) {
+        if (vmAlloc)
+            m_vmAllocator->Shrink(n);
+        if (blockSize)
+            _insertFreeBlock(block);
+        return NULL;
+    }
+
+    m_nVMPages += n;
+    m_end = (void*)((uintptr_t)m_end + vmAllocSize);
+    m_size += vmAllocSize;
+
+    *(size_t*)((uintptr_t)m_end - tagSize) = 0;
+
+    _markFree(block, blockSize + vmAllocSize);
+
+    return block;
+}
+
+template <typename _ALLOC_BUFFER>
+size_t TLSFAllocator<_ALLOC_BUFFER>::UsableSize(void* ptr) {
+    return ((AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize))->sz;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    AllocatedBlockHeader* allocHeader = (AllocatedBlockHeader*)((uintptr_t)ptr - allocHeaderSize);
+
+    void* block = (void*)((uintptr_t)ptr - allocHeader->padding);
+    size_t tag = *(size_t*)block;
+
+    if (tag & TAG_FREE)
+        return;
+
+    _statsFree(allocHeader->sz);
+
+    size_t blockSize = tag & ~TAG_MASK;
+    void* next = (void*)((uintptr_t)block + blockSize);
+    size_t nextTag = *(size_t*)next;
+
+    // merge with the left neighbour, its footer sits right before our tag
+    if (tag & TAG_PREV_FREE) {
+        size_t prevSize = *(size_t*)((uintptr_t)block - tagSize);
+        block = (void*)((uintptr_t)block - prevSize);
+        blockSize += prevSize;
+        _removeFreeBlock(block);
+    }
+
+    // merge with the right neighbour
+    if (nextTag & TAG_FREE) {
+        blockSize += nextTag & ~TAG_MASK;
+        _removeFreeBlock(next);
+    }
+
+    _markFree(block, blockSize);
+    _insertFreeBlock(block);
+
+    ptr = NULL;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::Layout() {
+    std::cout << ((uintptr_t)m_end - (uintptr_t)m_start) << "\nNum of committed VM pages: " << m_nVMPages
+        << "\nFirst level bitmap: " << std::hex << m_flBitmap << std::dec << "\nFree lists: ";
+
+    for (uint32_t fl = 0; fl < FL_INDEX_COUNT; ++fl) {
+        if (!(m_flBitmap & (1u << fl)))
+            continue;
+
+        for (uint32_t sl = 0; sl < SL_INDEX_COUNT; ++sl) {
+            size_t n = 0, total = 0;
+            for (void* block = m_blocks[fl][sl]; block; block = ((FreeBlockHeader*)block)->next) {
+                total += ((FreeBlockHeader*)block)->tag & ~TAG_MASK;
+                ++n;
+            }
+            if (n)
+                std::cout << " [" << fl << ", " << sl << ": " << n << " blocks, " << total << " bytes] ";
+        }
+    }
+
+    std::cout << "\n";
+
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    while (_walk(cursor, block)) {
+        _layoutBlock(block);
+        report.Add(block);
+    }
+
+    _layoutReport(report);
+}
+
+template <typename _ALLOC_BUFFER>
+bool TLSFAllocator<_ALLOC_BUFFER>::Walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    return _walk(cursor, block);
+}
+
+template <typename _ALLOC_BUFFER>
+HeapReport TLSFAllocator<_ALLOC_BUFFER>::Report() {
+    HeapWalkCursor cursor;
+    HeapBlock block;
+    HeapReport report;
+
+    while (_walk(cursor, block))
+        report.Add(block);
+
+    return report;
+}
+
+// physical walk by the boundary tags, the epilogue (size 0) ends it
+template <typename _ALLOC_BUFFER>
+bool TLSFAllocator<_ALLOC_BUFFER>::_walk(HeapWalkCursor& cursor, HeapBlock& block) {
+    if (!m_initialized)
+        return false;
+
+    if (!cursor.block)
+        cursor.block = m_start;
+
+    uintptr_t cur = (uintptr_t)cursor.block;
+    if (cur >= (uintptr_t)m_end - tagSize)
+        return false;
+
+    size_t tag = *(size_t*)cur;
+    if (!(tag & ~TAG_MASK))
+        return false;
+
+    block.offset = cur - (uintptr_t)m_start;
+    block.size = tag & ~TAG_MASK;
+    block.free = (tag & TAG_FREE) != 0;
+    block.padding = block.free ? 0 : *(size_t*)(cur + tagSize);
+
+    cursor.block = (void*)(cur + block.size);
+    return true;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::Release() {
+    _statsReset();
+    if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC_PREALLOC>::value) {
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value) {
+        m_vmAllocator->Release();
+    }
+    else if constexpr(std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_STATIC>::value) {
+        free(m_start);
+    }
+    m_initialized = false;
+    return;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::Reset() {
+    _statsReset();
+    build();
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::ZeroMem() {
+    memset(m_start, 0, m_size);
+}
+
+template <typename _ALLOC_BUFFER>
+bool TLSFAllocator<_ALLOC_BUFFER>::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::RegisterPages(Allocator* owner) {
+    // VMDYNAMIC: the whole reservation, pages committed later are covered too
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Register(m_start, sz, owner ? owner : this);
+}
+
+template <typename _ALLOC_BUFFER>
+void TLSFAllocator<_ALLOC_BUFFER>::UnregisterPages() {
+    size_t sz = std::is_same<_ALLOC_BUFFER, ALLOC_BUFFER_VMDYNAMIC>::value ? RESERVE_VIRTUAL_ADDRESS_SPACE : m_size;
+    AllocatorPageMap::Unregister(m_start, sz);
+}
+
+template class TLSFAllocator<ALLOC_BUFFER_STATIC>;
+template class TLSFAllocator<ALLOC_BUFFER_STATIC_PREALLOC>;
+template class TLSFAllocator<ALLOC_BUFFER_VMDYNAMIC>;
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Allocator.h"
+#include "VMLinearAllocator.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <memory>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+Two-Level Segregated Fit allocator (Masmano et al.)
+
+Free blocks are kept in FL_INDEX_COUNT x SL_INDEX_COUNT segregated lists.
+The first level splits sizes by powers of two, the second level splits each power of two linearly.
+Two levels of bitmaps tell which lists are non-empty, so finding a list that
+is guaranteed to fit the request is a couple of bit scans: O(1) alloc and free, no search loops.
+Blocks carry boundary tags (same layout as SequentialListAllocator in BOUNDARY_TAG mode),
+so Free merges with both physical neighbours in O(1).
+
+Buffer modes follow SequentialListAllocator, in VMDYNAMIC mode
+a page run is committed at the end of the arena when no list can serve the request.
+Committing pages is the only part that isn't bounded by a constant.
+*/
+
+template <typename _ALLOC_BUFFER>
+class TLSFAllocator : public Allocator {
+
+public:
+    // STATIC & VMDYNAMIC
+    TLSFAllocator(size_t sz);
+
+    // STATIC PREALLOC
+    TLSFAllocator(void* buffer, size_t sz);
+
+    ~TLSFAllocator();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+
+    void Layout() final;
+
+    // ptr lies in the arena
+    bool Owns(const void* ptr) final;
+    // maps the arena (the whole reservation in VMDYNAMIC mode) in AllocatorPageMap
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+
+    // blocks in address order, see HeapWalk.h
+    bool Walk(HeapWalkCursor& cursor, HeapBlock& block) final;
+    HeapReport Report() final;
+
+    // bytes from ptr to the end of its block, at least the size it was allocated with
+    size_t UsableSize(void* ptr);
+
+    // largest block of the top class, Alloc fails above it (headers included)
+    static constexpr size_t MAX_BLOCK_SIZE = (size_t)1 << 32;
+
+protected:
+    // [tag|nextFree|prevFree ... footer] free block
+    // [tag ... AllocatedBlockHeader|user data] allocated block
+    struct FreeBlockHeader {
+        size_t tag;
+        void* next;
+        void* prev;
+    };
+
+    // the padding comes first, with the minimum padding it's the word after the tag,
+    // larger paddings are repeated there, so a heap walk finds the header from the start of the block
+    struct AllocatedBlockHeader {
+        size_t padding;
+        size_t sz;
+    };
+
+private:
+    /* FUNCTIONS */
+
+    inline void build();
+
+    void* alloc_VMDYNAMIC_VMEXPAND(size_t sz);
+
+    inline void _mappingInsert(size_t sz, uint32_t& fl, uint32_t& sl);
+    inline void _mappingSearch(size_t sz, uint32_t& fl, uint32_t& sl);
+    inline void* _findSuitableBlock(uint32_t& fl, uint32_t& sl);
+
+    inline void _insertFreeBlock(void* block);
+    inline void _removeFreeBlock(void* block);
+    inline void _markFree(void* block, size_t sz);
+
+    inline void _fitPadding(ptrdiff_t& padding, size_t alignment);
+    inline void* _carve(void* block, size_t sz, size_t alignment);
+
+    bool _walk(HeapWalkCursor& cursor, HeapBlock& block);
+
+    static inline uint32_t _fls(size_t x);
+    static inline uint32_t _ffs(uint32_t x);
+
+    /* CONSTEXPRS */
+
+    static constexpr size_t tagSize = sizeof(size_t);
+    static constexpr size_t TAG_FREE = 1;
+    static constexpr size_t TAG_PREV_FREE = 2;
+    static constexpr size_t TAG_MASK = tagSize - 1;
+
+    static constexpr size_t allocHeaderSize = sizeof(AllocatedBlockHeader);
+    // header + footer
+    static constexpr size_t minBlockSize = sizeof(FreeBlockHeader) + tagSize;
+    static constexpr size_t minPadding = tagSize + allocHeaderSize;
+
+    static constexpr uint32_t SL_INDEX_COUNT_LOG2 = 5;
+    static constexpr uint32_t SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2;
+    static constexpr uint32_t ALIGN_SIZE_LOG2 = 3;
+    // blocks up to 4GB
+    static constexpr uint32_t FL_INDEX_MAX = 32;
+    static constexpr uint32_t FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2;
+    static constexpr uint32_t FL_INDEX_COUNT = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+    static_assert(MAX_BLOCK_SIZE == (size_t)1 << FL_INDEX_MAX, "the largest class bounds the blocks");
+    // below this size the first level is 0 and the second level is linear in ALIGN_SIZE steps
+    static constexpr size_t SMALL_BLOCK_SIZE = (size_t)1 << FL_INDEX_SHIFT;
+
+    static constexpr size_t RESERVE_VIRTUAL_ADDRESS_SPACE = 1024 * 1024 * 1024;
+
+    /* VARIABLES */
+
+    size_t m_size;
+
+    void* m_start;
+    void* m_end;
+
+    bool m_initialized;
+
+    uint32_t m_flBitmap;
+    uint32_t m_slBitmap[FL_INDEX_COUNT];
+    void* m_blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+    VMLinearAllocator* m_vmAllocator;
+    uint32_t m_nVMPages;
+};
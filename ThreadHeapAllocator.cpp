@@ -0,0 +1,340 @@
+#include "ThreadHeapAllocator.h"
+#include "AllocatorPageMap.h"
+#include <iostream>
+
+static std::atomic<uint64_t> nextAllocatorId(1);
+
+struct ThreadHeapAllocator::ThreadHeaps {
+    // last heap used by this thread, the scan in _threadHeap only runs when a thread switches allocators
+    struct HeapCache {
+        uint64_t allocatorId;
+        Heap* heap;
+    };
+
+    // a thread that owns heaps in more allocators keeps the extra ones until its id is reused
+    static constexpr uint32_t MAX_OWNED = 16;
+
+    // trivially destructible, still readable by the thread_local destructors that run after this one
+    static thread_local HeapCache cache;
+    static thread_local bool exited;
+
+    Heap* heaps[MAX_OWNED];
+    uint32_t n;
+
+    ThreadHeaps() : n(0) {}
+
+    ~ThreadHeaps() {
+        // whatever the thread does from now on doesn't touch the heaps it gives up
+        exited = true;
+        cache.allocatorId = 0;
+        cache.heap = NULL;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            Heap* heap = heaps[i];
+            _drain(heap);
+            // release, the adopting thread sees the drained slabs
+            heap->ownerThread.store(0, std::memory_order_release);
+            _release(heap);
+        }
+    }
+
+    bool Add(Heap* heap) {
+        if (n == MAX_OWNED)
+            return false;
+        heaps[n++] = heap;
+        return true;
+    }
+};
+
+thread_local ThreadHeapAllocator::ThreadHeaps::HeapCache ThreadHeapAllocator::ThreadHeaps::cache = { 0, NULL };
+thread_local bool ThreadHeapAllocator::ThreadHeaps::exited = false;
+
+ThreadHeapAllocator::ThreadHeapAllocator(size_t heapSize) : m_heapSize(heapSize), m_nHeaps(0), m_pageOwner(this), m_fallback(NULL) {
+    m_id = nextAllocatorId.fetch_add(1, std::memory_order_relaxed);
+    InitializeSRWLock(&m_fallbackLock);
+
+    for (uint32_t i = 0; i < MAX_HEAPS; ++i)
+        m_heaps[i].store(NULL, std::memory_order_relaxed);
+}
+
+ThreadHeapAllocator::~ThreadHeapAllocator() {
+    // a heap whose thread is still running is deleted when the thread exits
+    for (uint32_t i = 0; i < MAX_HEAPS; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_relaxed);
+        if (!heap)
+            continue;
+        heap->slabs.UnregisterPages();
+        _release(heap);
+    }
+}
+
+uint32_t ThreadHeapAllocator::HeapCount() {
+    uint32_t n = m_nHeaps.load(std::memory_order_acquire);
+    return n < MAX_HEAPS ? n : MAX_HEAPS;
+}
+
+ThreadHeapAllocator::Heap* ThreadHeapAllocator::_threadHeap(bool create) {
+    ThreadHeaps::HeapCache& cache = ThreadHeaps::cache;
+
+    if (cache.allocatorId == m_id)
+        return cache.heap;
+
+    // the thread gave its heaps up, it frees remotely and allocates from the fallback heap
+    if (ThreadHeaps::exited)
+        return NULL;
+
+    static thread_local ThreadHeaps owned;
+
+    DWORD thread = GetCurrentThreadId();
+    uint32_t n = HeapCount();
+
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (heap && heap->ownerThread.load(std::memory_order_relaxed) == thread) {
+            cache.allocatorId = m_id;
+            cache.heap = heap;
+            return heap;
+        }
+    }
+
+    if (!create)
+        return NULL;
+
+    Heap* heap = _adopt(thread);
+
+    if (!heap) {
+        heap = _newHeap(thread);
+        if (!heap)
+            return NULL;
+    }
+
+    if (owned.Add(heap))
+        heap->refs.fetch_add(1, std::memory_order_relaxed);
+
+    cache.allocatorId = m_id;
+    cache.heap = heap;
+    return heap;
+}
+
+ThreadHeapAllocator::Heap* ThreadHeapAllocator::_newHeap(DWORD thread) {
+    // claim a slot, it reads NULL to the other threads until the heap is published
+    uint32_t i = m_nHeaps.fetch_add(1, std::memory_order_acq_rel);
+    if (i >= MAX_HEAPS)
+        return NULL;
+
+    Heap* heap = new Heap(m_heapSize, thread);
+    // seq_cst, like the m_pageOwner store & load in RegisterPages: a RegisterPages running
+    // at the same time either finds the heap or the heap finds the owner
+    m_heaps[i].store(heap);
+
+    heap->slabs.RegisterPages(m_pageOwner.load(), i + 1);
+    return heap;
+}
+
+// a thread past its exit, e.g. a thread_local destructor or the CRT freeing its buffers
+void* ThreadHeapAllocator::_fallbackAlloc(size_t sz, size_t alignment) {
+    AcquireSRWLockExclusive(&m_fallbackLock);
+
+    if (!m_fallback)
+        m_fallback = _newHeap(FALLBACK_OWNER);
+
+    void* ptr = NULL;
+    if (m_fallback) {
+        // everybody frees into it remotely, the lock makes the allocating thread its owner for now
+        if (m_fallback->remoteFree.load(std::memory_order_relaxed))
+            _drain(m_fallback);
+        ptr = m_fallback->slabs.Alloc(sz, alignment);
+    }
+
+    ReleaseSRWLockExclusive(&m_fallbackLock);
+    return ptr;
+}
+
+ThreadHeapAllocator::Heap* ThreadHeapAllocator::_adopt(DWORD thread) {
+    uint32_t n = HeapCount();
+
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (!heap || heap->ownerThread.load(std::memory_order_relaxed) != 0)
+            continue;
+
+        DWORD abandoned = 0;
+        if (heap->ownerThread.compare_exchange_strong(abandoned, thread, std::memory_order_acquire)) {
+            // remote frees that came in after the old owner exited
+            _drain(heap);
+            return heap;
+        }
+    }
+
+    return NULL;
+}
+
+ThreadHeapAllocator::Heap* ThreadHeapAllocator::_ownerHeap(const void* ptr) {
+    uint32_t slot;
+    if (AllocatorPageMap::Owner(ptr, &slot) != m_pageOwner.load(std::memory_order_relaxed) || !slot || slot > MAX_HEAPS)
+        return NULL;
+
+    // an owner passed to RegisterPages may have mapped other ranges with their own size classes
+    Heap* heap = m_heaps[slot - 1].load(std::memory_order_acquire);
+    return heap && heap->slabs.Owns(ptr) ? heap : NULL;
+}
+
+bool ThreadHeapAllocator::Owns(const void* ptr) {
+    return _ownerHeap(ptr) != NULL;
+}
+
+void ThreadHeapAllocator::RegisterPages(Allocator* owner) {
+    m_pageOwner.store(owner ? owner : this);
+
+    uint32_t n = HeapCount();
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load();
+        if (heap)
+            heap->slabs.RegisterPages(owner ? owner : this, i + 1);
+    }
+}
+
+// the remote frees look the heaps up in the page map, so they stay mapped to this allocator
+void ThreadHeapAllocator::UnregisterPages() {
+    RegisterPages(this);
+}
+
+size_t ThreadHeapAllocator::UsableSize(void* ptr) {
+    Heap* heap = _ownerHeap(ptr);
+    assert(heap && "PTR ISN'T OWNED BY ANY THREAD HEAP");
+    return heap->slabs.UsableSize(ptr);
+}
+
+// the allocator or the owner thread lets go, the last one deletes the heap
+void ThreadHeapAllocator::_release(Heap* heap) {
+    if (heap->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete heap;
+}
+
+// lock-free push, the only consumer takes the whole list so there's no ABA
+void ThreadHeapAllocator::_remoteFree(Heap* heap, void* ptr) {
+    RemoteFreeHeader* header = (RemoteFreeHeader*)ptr;
+    void* head = heap->remoteFree.load(std::memory_order_relaxed);
+
+    do {
+        header->next = head;
+    } while (!heap->remoteFree.compare_exchange_weak(head, ptr, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// owner only, frees the pending remote frees as a batch
+void ThreadHeapAllocator::_drain(Heap* heap) {
+    void* ptr = heap->remoteFree.exchange(NULL, std::memory_order_acquire);
+
+    while (ptr) {
+        void* next = ((RemoteFreeHeader*)ptr)->next;
+        heap->slabs.Free(ptr);
+        ptr = next;
+    }
+}
+
+void* ThreadHeapAllocator::Alloc(size_t sz, size_t alignment) {
+    Heap* heap = _threadHeap(true);
+    if (!heap) {
+        void* ptr = ThreadHeaps::exited ? _fallbackAlloc(sz, alignment) : NULL;
+        if (!ptr)
+            _statsFail(sz);
+        return ptr;
+    }
+
+    // plain load first, the exchange is only paid when there's something to take
+    if (heap->remoteFree.load(std::memory_order_relaxed))
+        _drain(heap);
+
+    return heap->slabs.Alloc(sz, alignment);
+}
+
+void ThreadHeapAllocator::Free(void*& ptr) {
+    if (!ptr)
+        return;
+
+    Heap* heap = _threadHeap(false);
+    if (heap && heap->slabs.Owns(ptr)) {
+        heap->slabs.Free(ptr);
+        return;
+    }
+
+    heap = _ownerHeap(ptr);
+    assert(heap && "PTR ISN'T OWNED BY ANY THREAD HEAP");
+
+    _remoteFree(heap, ptr);
+    ptr = NULL;
+}
+
+void ThreadHeapAllocator::Release() {
+    _statsReset();
+
+    uint32_t n = HeapCount();
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (!heap)
+            continue;
+        heap->remoteFree.store(NULL, std::memory_order_relaxed);
+        heap->slabs.Release();
+    }
+}
+
+void ThreadHeapAllocator::Reset() {
+    _statsReset();
+
+    uint32_t n = HeapCount();
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (!heap)
+            continue;
+        heap->remoteFree.store(NULL, std::memory_order_relaxed);
+        heap->slabs.Reset();
+    }
+}
+
+void ThreadHeapAllocator::ZeroMem() {
+    uint32_t n = HeapCount();
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (!heap)
+            continue;
+        _drain(heap);
+        heap->slabs.ZeroMem();
+    }
+}
+
+void ThreadHeapAllocator::Layout() {
+    uint32_t n = HeapCount();
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (!heap)
+            continue;
+
+        uint32_t nPending = 0;
+        for (void* ptr = heap->remoteFree.load(std::memory_order_acquire); ptr; ptr = ((RemoteFreeHeader*)ptr)->next)
+            ++nPending;
+
+        DWORD owner = heap->ownerThread.load(std::memory_order_relaxed);
+        if (owner == FALLBACK_OWNER)
+            std::cout << "Heap " << i << " (fallback), " << nPending << " remote frees pending\n";
+        else if (owner)
+            std::cout << "Heap " << i << " (thread " << owner << "), " << nPending << " remote frees pending\n";
+        else
+            std::cout << "Heap " << i << " (abandoned), " << nPending << " remote frees pending\n";
+        heap->slabs.Layout();
+    }
+}
+
+AllocatorStats ThreadHeapAllocator::GetStats() {
+    AllocatorStats stats = _statsSnapshot();
+
+    uint32_t n = HeapCount();
+    for (uint32_t i = 0; i < n; ++i) {
+        Heap* heap = m_heaps[i].load(std::memory_order_acquire);
+        if (!heap)
+            continue;
+
+        stats.Accumulate(heap->slabs.GetStats());
+    }
+
+    return stats;
+}
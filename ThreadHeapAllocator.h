@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Allocator.h"
+#include "SlabAllocator.h"
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+
+/*
+Owner thread heaps with remote frees (mimalloc style)
+
+Every thread that allocates gets its own heap, a SlabAllocator over its own VM reservation, that only the owner thread touches.
+A Free from the owner goes straight to its heap.
+A Free from any other thread is pushed onto the owning heap's remote free list, a lock-free MPSC stack
+(threaded through the freed slots themselves, the link is the first word like the slab free list),
+and the owner takes the whole list with one exchange on its next Alloc and frees the batch into its slabs.
+Neither side ever takes a lock, the producer/consumer pattern costs a CAS per remote free and an exchange per batch.
+
+The owner of a pointer is the heap whose reservation contains it.
+Heaps are kept in a fixed array that is only ever appended to, so it can be scanned without a lock,
+and every heap is mapped in AllocatorPageMap with its index as the size class, so a remote Free finds its heap in two loads.
+A thread that exits frees its pending remote frees and marks its heaps abandoned,
+the next thread without a heap adopts an abandoned one (and drains what was freed to it since) before it claims a new slot,
+so the array bounds the threads alive at once, not the threads ever started.
+A heap is deleted by whichever lets go last, the allocator or the thread that owns it.
+A thread that allocates after its exit (a later thread_local destructor, the CRT) frees remotely
+and allocates from a fallback heap shared under a lock.
+
+Same limits as SlabAllocator: up to 2048 bytes, alignment up to 16.
+Release, Reset, ZeroMem and Layout aren't thread-safe, call them when no other thread uses the allocator.
+*/
+
+class ThreadHeapAllocator : public Allocator {
+public:
+    // heapSize: virtual address space to reserve for every thread's heap
+    ThreadHeapAllocator(size_t heapSize);
+    ~ThreadHeapAllocator();
+
+    void* Alloc(size_t sz, size_t alignment) final;
+    void Free(void*&) final;
+    inline void Release() final;
+    inline void Reset() final;
+    inline void ZeroMem() final;
+    void Layout() final;
+
+    // sum of the heaps
+    AllocatorStats GetStats() final;
+
+    uint32_t HeapCount();
+
+    // ptr lies in one of the heaps
+    bool Owns(const void* ptr) final;
+    // the heaps are always in AllocatorPageMap, this maps them (and heaps created afterwards) to owner,
+    // UnregisterPages maps them back to this allocator, the destructor removes them
+    void RegisterPages(Allocator* owner = NULL) final;
+    void UnregisterPages() final;
+    size_t UsableSize(void* ptr);
+
+protected:
+    struct RemoteFreeHeader {
+        void* next;
+    };
+
+    struct Heap {
+        // written by every remote thread, kept away from the owner's data
+        alignas(64) std::atomic<void*> remoteFree;
+        // 0 once the owner exited, thread ids are never 0
+        alignas(64) std::atomic<DWORD> ownerThread;
+        // held by the allocator and by the owner thread
+        std::atomic<uint32_t> refs;
+        SlabAllocator slabs;
+
+        Heap(size_t sz, DWORD owner) : remoteFree(NULL), ownerThread(owner), refs(1), slabs(sz) {}
+    };
+
+private:
+    // heap of the calling thread, created on its first Alloc
+    Heap* _threadHeap(bool create);
+    Heap* _ownerHeap(const void* ptr);
+    // takes over the heap of an exited thread
+    Heap* _adopt(DWORD thread);
+    // published in a new slot, NULL when they're all taken
+    Heap* _newHeap(DWORD thread);
+    void* _fallbackAlloc(size_t sz, size_t alignment);
+
+    inline void _remoteFree(Heap* heap, void* ptr);
+    static inline void _drain(Heap* heap);
+    static inline void _release(Heap* heap);
+
+    // heaps owned by the calling thread, abandoned when it exits
+    struct ThreadHeaps;
+
+    static constexpr uint32_t MAX_HEAPS = 256;
+    // owner of the fallback heap, never a thread id (those are multiples of 4) nor 0, so it's never adopted
+    static constexpr DWORD FALLBACK_OWNER = 0xFFFFFFFF;
+
+    size_t m_heapSize;
+    // tells apart allocator instances in the per thread heap cache
+    uint64_t m_id;
+
+    std::atomic<Heap*> m_heaps[MAX_HEAPS];
+    std::atomic<uint32_t> m_nHeaps;
+
+    // AllocatorPageMap owner of the heaps, this unless RegisterPages said otherwise
+    std::atomic<Allocator*> m_pageOwner;
+
+    // serializes the threads allocating after their exit
+    SRWLOCK m_fallbackLock;
+    Heap* m_fallback;
+};
@@ -1,5 +1,6 @@
 #include "VMAllocator.h"
 #include <assert.h>
+#include <string.h>
 #include <iostream>
 #include <algorithm>
 
@@ -8,37 +9,137 @@ VMAllocator::VMAllocator(size_t sz) {
     GetSystemInfo(&sSysInfo);
     m_pgSize = sSysInfo.dwPageSize;
 
-    m_numPages = (uint32_t)ceil(sz / m_pgSize);
-    m_size = m_numPages * m_pgSize;
+    // the buddy system needs a power of two number of pages
+    m_maxOrder = _ceilLog2((sz + m_pgSize - 1) / m_pgSize);
+    assert(m_maxOrder < 32);
+
+    m_numPages = (uint32_t)1 << m_maxOrder;
+    m_size = (size_t)m_numPages * m_pgSize;
 
     m_start = VirtualAlloc(NULL, m_size, MEM_RESERVE, PAGE_READWRITE);
     m_end = (void*)((uintptr_t)m_start + m_size);
-    m_reserved = m_start;
+
+    // one block for all the bitmaps and the order table
+    size_t nWords = 0;
+    for (uint32_t order = 0; order <= m_maxOrder; ++order)
+        nWords += (((size_t)m_numPages >> order) + 63) / 64;
+
+    size_t nOrderWords = (m_numPages + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    m_metadata = new uint64_t[nWords + nOrderWords];
+
+    uint64_t* words = m_metadata;
+    for (uint32_t order = 0; order <= m_maxOrder; ++order) {
+        m_freeBitmap[order] = words;
+        words += (((size_t)m_numPages >> order) + 63) / 64;
+    }
+    m_order = (uint8_t*)words;
+
+    build();
 }
 
 VMAllocator ::~VMAllocator() {
+    VirtualFree(m_start, 0, MEM_RELEASE);
+    delete[] m_metadata;
+}
+
+// the whole range is a single free run of the highest order
+void VMAllocator::build() {
+    for (uint32_t order = 0; order <= m_maxOrder; ++order) {
+        memset(m_freeBitmap[order], 0, ((((size_t)m_numPages >> order) + 63) / 64) * sizeof(uint64_t));
+        m_freeHint[order] = 0;
+        m_freeCount[order] = 0;
+    }
+
+    _setFree(m_maxOrder, 0);
+}
+
+uint32_t VMAllocator::_ceilLog2(size_t x) {
+    uint32_t order = 0;
+    while (((size_t)1 << order) < x)
+        ++order;
+    return order;
+}
+
+bool VMAllocator::_isFree(uint32_t order, size_t index) {
+    return (m_freeBitmap[order][index / 64] >> (index % 64)) & 1;
+}
+
+void VMAllocator::_setFree(uint32_t order, size_t index) {
+    m_freeBitmap[order][index / 64] |= (uint64_t)1 << (index % 64);
+    if (index / 64 < m_freeHint[order])
+        m_freeHint[order] = index / 64;
+    ++m_freeCount[order];
+}
+
+void VMAllocator::_clearFree(uint32_t order, size_t index) {
+    m_freeBitmap[order][index / 64] &= ~((uint64_t)1 << (index % 64));
+    --m_freeCount[order];
+}
+
+// lowest free run of the given order
+bool VMAllocator::_findFree(uint32_t order, size_t& index) {
+    if (!m_freeCount[order])
+        return false;
+
+    size_t nWords = (((size_t)m_numPages >> order) + 63) / 64;
+
+    for (size_t i = m_freeHint[order]; i < nWords; ++i) {
+        uint64_t word = m_freeBitmap[order][i];
+        if (!word)
+            continue;
+
+        m_freeHint[order] = i;
+
+        uint32_t bit = 0;
+        while (!((word >> bit) & 1))
+            ++bit;
+
+        index = i * 64 + bit;
+        return true;
+    }
+
+    return false;
 }
 
 // retrieve N contagious pages
 void* VMAllocator::Alloc(uint32_t n) {
     assert(n>0);
 
-    size_t allocSize = n * m_pgSize;
+    uint32_t order = _ceilLog2(n);
+    if (order > m_maxOrder)
+        return NULL;
+
+    // smallest free run that is large enough, split it down to the requested order
+    uint32_t k = order;
+    size_t index;
 
-    // commit memory from the end of the reserved virtual address space
-    // we don't need to worry about fragmentation in virtual address space
-    // since for 64-bit systems it's practically unlimited
+    while (k <= m_maxOrder && !_findFree(k, index))
+        ++k;
 
-    if ((uintptr_t)m_reserved + allocSize > (uintptr_t)m_end)
+    if (k > m_maxOrder)
         return NULL;
 
-    void* p = VirtualAlloc(m_reserved, allocSize, MEM_COMMIT, PAGE_READWRITE);
-    m_reserved = (void*)((uintptr_t)m_reserved + allocSize);
+    _clearFree(k, index);
+
+    while (k > order) {
+        --k;
+        index <<= 1;
+        // right half stays free
+        _setFree(k, index + 1);
+    }
 
-    AllocHeader* allocHeader = new(p) AllocHeader;
-    allocHeader->n = n;
+    size_t page = index << order;
+    m_order[page] = (uint8_t)order;
 
-    return (void*)((uintptr_t)p + allocHeaderSize);
+    // only commit what was asked for, the rest of the run stays reserved
+    void* p = (void*)((uintptr_t)m_start + page * m_pgSize);
+    if (!VirtualAlloc(p, (size_t)n * m_pgSize, MEM_COMMIT, PAGE_READWRITE)) {
+        // out of commit charge, the run goes back to the bitmaps as if it never left
+        _merge(order, index);
+        return NULL;
+    }
+
+    return p;
 }
 
 void VMAllocator::Free(void* ptr) {
@@ -46,26 +147,45 @@ void VMAllocator::Free(void* ptr) {
     // Reserved pages can be released only by freeing the entire block that was initially reserved by VirtualAlloc.
     // Thus, we're not releasing virtual memory, just decommitting it.
 
-    void* p = (void*)((uintptr_t)ptr - allocHeaderSize);
-    AllocHeader* allocHeader = (AllocHeader*)p;
-    uint32_t blockSize = allocHeader->n*m_pgSize;
+    if (!ptr)
+        return;
+
+    size_t page = ((uintptr_t)ptr - (uintptr_t)m_start) / m_pgSize;
+    uint32_t order = m_order[page];
 
-    // if the freed block is the last committed page, decrement the m_reserved ptr as well,
-    // thus, we can guarantee that every new allocation starts from the END in suballocators
+    VirtualFree(ptr, ((size_t)1 << order) * m_pgSize, MEM_DECOMMIT);
+
+    _merge(order, page >> order);
+}
 
-    if ((uintptr_t)p + blockSize == (uintptr_t)m_reserved)
-        m_reserved = p;
+void VMAllocator::_merge(uint32_t order, size_t index) {
+    // merge with the buddy while it's free
+    while (order < m_maxOrder && _isFree(order, index ^ 1)) {
+        _clearFree(order, index ^ 1);
+        index >>= 1;
+        ++order;
+    }
 
-    VirtualFree(p, blockSize, MEM_DECOMMIT);
+    _setFree(order, index);
 }
 
 void VMAllocator::Release() {
-    VirtualFree(m_start, (uintptr_t)m_reserved-(uintptr_t)m_start, MEM_DECOMMIT);
-    m_reserved = m_start;
+    VirtualFree(m_start, m_size, MEM_DECOMMIT);
+    build();
 }
 
 size_t VMAllocator::PageSize() {
     return (size_t)m_pgSize;
 }
 
+bool VMAllocator::Owns(const void* ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)m_start && (uintptr_t)ptr < (uintptr_t)m_end;
+}
+
+void* VMAllocator::Start() {
+    return m_start;
+}
 
+size_t VMAllocator::Size() {
+    return m_size;
+}
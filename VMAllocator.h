@@ -4,6 +4,17 @@
 
 #define DEFAULT_VM_PAGE_SIZE 4096
 
+/*
+Binary buddy allocator over a reserved range of virtual memory.
+Alloc(n) hands out a run of 2^ceil(log2(n)) pages (only the first n are committed),
+Free decommits the run and merges it with its buddy as long as the buddy is free,
+so holes anywhere in the range are reused, not only the ones at the end.
+
+Free runs are decommitted, so they can't hold any links.
+All bookkeeping lives in a separately allocated metadata block:
+a free bitmap per order and the order of every allocated run, indexed by its first page.
+*/
+
 class VMAllocator {
 public:
     VMAllocator(size_t sz);
@@ -14,21 +25,38 @@ public:
     void Release();
 
     size_t PageSize();
+    // ptr lies in the reserved range
+    bool Owns(const void* ptr);
+    void* Start();
+    // bytes reserved
+    size_t Size();
 
-protected:
-    struct AllocHeader {
-        uint32_t n;
-    };
+private:
+    void build();
 
-public:
-    static constexpr size_t allocHeaderSize = sizeof(AllocHeader);
+    inline bool _isFree(uint32_t order, size_t index);
+    inline void _setFree(uint32_t order, size_t index);
+    inline void _clearFree(uint32_t order, size_t index);
+    bool _findFree(uint32_t order, size_t& index);
+    // gives a run back, merged with its buddies while they're free
+    void _merge(uint32_t order, size_t index);
+
+    static inline uint32_t _ceilLog2(size_t x);
 
-private:
     DWORD m_pgSize;
     uint32_t m_numPages;
+    uint32_t m_maxOrder;
 
     void* m_start;
-    void* m_reserved;
     void* m_end;
     size_t m_size;
-};
\ No newline at end of file
+
+    // m_freeBitmap[order] has a bit per run of 2^order pages
+    uint64_t* m_freeBitmap[32];
+    // lowest bitmap word that may have a free bit, per order
+    size_t m_freeHint[32];
+    size_t m_freeCount[32];
+    // order of the allocated run starting at a page
+    uint8_t* m_order;
+    uint64_t* m_metadata;
+};
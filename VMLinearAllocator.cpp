@@ -3,27 +3,133 @@
 #include <iostream>
 #include <algorithm>
 
-VMLinearAllocator::VMLinearAllocator(size_t sz) {
+// SeLockMemoryPrivilege has to be enabled in the process token before any MEM_LARGE_PAGES allocation
+static size_t enableLargePages() {
+    HANDLE token;
+    TOKEN_PRIVILEGES tp;
+
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return 0;
+
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    bool enabled = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) &&
+        GetLastError() != ERROR_NOT_ALL_ASSIGNED;
+
+    CloseHandle(token);
+
+    return enabled ? GetLargePageMinimum() : 0;
+}
+
+VMLinearAllocator::VMLinearAllocator(size_t sz, bool largePages, DWORD numaNode) : m_largePages(false), m_numaNode(numaNode) {
     SYSTEM_INFO sSysInfo;
     GetSystemInfo(&sSysInfo);
     m_pgSize = sSysInfo.dwPageSize;
 
-    m_numPages = (uint32_t)ceil(sz / m_pgSize);
-    m_size = m_numPages * m_pgSize;
+    size_t largePageSize = largePages ? LargePageSize() : 0;
+
+    if (largePageSize) {
+        m_pgSize = (DWORD)largePageSize;
+        m_numPages = (uint32_t)((sz + m_pgSize - 1) / m_pgSize);
+        m_size = (size_t)m_numPages * m_pgSize;
+
+        // find a large page aligned range that is free right now and hold it with one reservation per large page,
+        // Alloc swaps them for large pages. Another thread can map into the range between the probe and the reservations, then probe again
+        for (int attempt = 0; attempt < PROBE_ATTEMPTS && !m_largePages; ++attempt) {
+            void* probe = VirtualAlloc(NULL, m_size + m_pgSize, MEM_RESERVE, PAGE_READWRITE);
+            if (!probe)
+                break;
+            VirtualFree(probe, 0, MEM_RELEASE);
+            m_start = (void*)(((uintptr_t)probe + m_pgSize - 1) & ~((uintptr_t)m_pgSize - 1));
+            m_largePages = _reservePages(m_start, m_size);
+        }
+
+        if (!m_largePages)
+            m_pgSize = sSysInfo.dwPageSize;
+    }
+
+    if (!m_largePages) {
+        m_numPages = (uint32_t)((sz + m_pgSize - 1) / m_pgSize);
+        m_size = (size_t)m_numPages * m_pgSize;
+        m_start = VirtualAlloc(NULL, m_size, MEM_RESERVE, PAGE_READWRITE);
+    }
 
-    m_start = VirtualAlloc(NULL, m_size, MEM_RESERVE, PAGE_READWRITE);
     m_end = (void*)((uintptr_t)m_start + m_size);
     m_reserved = m_start;
+    m_committed = m_start;
 }
 
 VMLinearAllocator ::~VMLinearAllocator() {
+    if (!m_largePages) {
+        VirtualFree(m_start, 0, MEM_RELEASE);
+        return;
+    }
+
+    // every _commitLargePages call and every page still held by _reservePages is a separate allocation
+    MEMORY_BASIC_INFORMATION mbi;
+    for (uintptr_t p = (uintptr_t)m_start; p < (uintptr_t)m_end; p += mbi.RegionSize) {
+        VirtualQuery((void*)p, &mbi, sizeof(mbi));
+        if (mbi.State != MEM_FREE)
+            VirtualFree(mbi.AllocationBase, 0, MEM_RELEASE);
+    }
+}
+
+size_t VMLinearAllocator::LargePageSize() {
+    static size_t largePageSize = enableLargePages();
+    return largePageSize;
+}
+
+void* VMLinearAllocator::AllocLargePages(size_t sz) {
+    size_t largePageSize = LargePageSize();
+    if (!largePageSize)
+        return NULL;
+
+    sz = (sz + largePageSize - 1) & ~(largePageSize - 1);
+    return VirtualAlloc(NULL, sz, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
+void VMLinearAllocator::FreeLargePages(void* ptr) {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+// reserve [ptr, ptr + sz) a large page at a time, so the pages can be released one by one, all or nothing
+bool VMLinearAllocator::_reservePages(void* ptr, size_t sz) {
+    for (uintptr_t p = (uintptr_t)ptr; p < (uintptr_t)ptr + sz; p += m_pgSize) {
+        if (!VirtualAlloc((void*)p, m_pgSize, MEM_RESERVE, PAGE_READWRITE)) {
+            _releasePages(ptr, p - (uintptr_t)ptr);
+            return false;
+        }
+    }
+    return true;
+}
+
+void VMLinearAllocator::_releasePages(void* ptr, size_t sz) {
+    for (uintptr_t p = (uintptr_t)ptr; p < (uintptr_t)ptr + sz; p += m_pgSize)
+        VirtualFree((void*)p, 0, MEM_RELEASE);
+}
+
+// map [ptr, ptr + sz) with large pages, regular pages if the large ones run out
+void* VMLinearAllocator::_commitLargePages(void* ptr, size_t sz) {
+    void* p = _virtualAlloc(ptr, sz, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES);
+    if (!p)
+        p = _virtualAlloc(ptr, sz, MEM_RESERVE | MEM_COMMIT);
+    return p;
+}
+
+// commits go through the NUMA variant only when a node was requested
+void* VMLinearAllocator::_virtualAlloc(void* ptr, size_t sz, DWORD type) {
+    if (m_numaNode == NUMA_NO_PREFERRED_NODE)
+        return VirtualAlloc(ptr, sz, type, PAGE_READWRITE);
+    return VirtualAllocExNuma(GetCurrentProcess(), ptr, sz, type, PAGE_READWRITE, m_numaNode);
 }
 
 // retrieve N contagious pages
 void* VMLinearAllocator::Alloc(uint32_t n) {
     assert(n>0);
 
-    size_t allocSize = n * m_pgSize;
+    size_t allocSize = (size_t)n * m_pgSize;
 
     // commit memory from the end of the reserved virtual address space
     // we don't need to worry about fragmentation in virtual address space
@@ -32,7 +138,34 @@ void* VMLinearAllocator::Alloc(uint32_t n) {
     if ((uintptr_t)m_reserved + allocSize > (uintptr_t)m_end)
         return NULL;
 
-    void* p = VirtualAlloc(m_reserved, allocSize, MEM_COMMIT, PAGE_READWRITE);
+    if (m_largePages) {
+        void* p = m_reserved;
+        uintptr_t reservedEnd = (uintptr_t)m_reserved + allocSize;
+
+        if (reservedEnd > (uintptr_t)m_committed) {
+            size_t commitSize = reservedEnd - (uintptr_t)m_committed;
+
+            // large pages can't be committed into a reservation, give the pages up right before mapping them
+            _releasePages(m_committed, commitSize);
+            if (!_commitLargePages(m_committed, commitSize)) {
+                // somebody else mapped into the pages in between, if they can't be held again the range ends here
+                if (!_reservePages(m_committed, commitSize)) {
+                    _releasePages((void*)reservedEnd, (uintptr_t)m_end - reservedEnd);
+                    m_end = m_committed;
+                }
+                return NULL;
+            }
+            m_committed = (void*)reservedEnd;
+        }
+
+        m_reserved = (void*)reservedEnd;
+        return p;
+    }
+
+    // a failed commit leaves the range as it was, a later Alloc starts from the same place
+    void* p = _virtualAlloc(m_reserved, allocSize, MEM_COMMIT);
+    if (!p)
+        return NULL;
     m_reserved = (void*)((uintptr_t)m_reserved + allocSize);
 
     return p;
@@ -42,7 +175,22 @@ void VMLinearAllocator::Free(void* ptr) {
     assert(false, "Can't free vmlinear allocator\n");
 }
 
+// give the last n pages back to the OS, next Alloc continues from the new end
+void VMLinearAllocator::Shrink(uint32_t n) {
+    size_t shrinkSize = (size_t)n * m_pgSize;
+
+    assert((uintptr_t)m_reserved - shrinkSize >= (uintptr_t)m_start);
+
+    m_reserved = (void*)((uintptr_t)m_reserved - shrinkSize);
+    if (!m_largePages)
+        VirtualFree(m_reserved, shrinkSize, MEM_DECOMMIT);
+}
+
 void VMLinearAllocator::Release() {
+    if (m_largePages) {
+        m_reserved = m_start;
+        return;
+    }
     VirtualFree(m_start, (uintptr_t)m_reserved-(uintptr_t)m_start, MEM_DECOMMIT);
     m_reserved = m_start;
 }
@@ -51,4 +199,12 @@ size_t VMLinearAllocator::PageSize() {
     return (size_t)m_pgSize;
 }
 
+bool VMLinearAllocator::LargePages() {
+    return m_largePages;
+}
+
+DWORD VMLinearAllocator::NumaNode() {
+    return m_numaNode;
+}
+
 
@@ -4,23 +4,63 @@
 
 #define DEFAULT_VM_PAGE_SIZE 4096
 
+/*
+Large pages:
+With largePages the range is aligned to the large page size (2MB on x64) and PageSize() returns the large page size.
+Win32 can't commit large pages into an existing reservation, they have to be reserved and committed at once,
+so the range is held by one reservation per large page and every Alloc swaps the reservations at the end for large pages.
+Large pages are locked in physical memory and can't be decommitted, Shrink and Release only rewind the allocator,
+the pages stay committed and are reused by the next Alloc.
+Falls back to regular pages when the process lacks SeLockMemoryPrivilege or no contiguous physical memory is left.
+
+NUMA:
+With numaNode the pages are committed with VirtualAllocExNuma, so the physical memory prefers that node.
+NUMA_NO_PREFERRED_NODE (default) leaves the placement to the OS.
+*/
+
 class VMLinearAllocator {
 public:
-    VMLinearAllocator(size_t sz);
+    VMLinearAllocator(size_t sz, bool largePages = false, DWORD numaNode = NUMA_NO_PREFERRED_NODE);
     ~VMLinearAllocator();
 
     void* Alloc(uint32_t n);
     void Free(void* ptr);
     void Release();
 
+    // decommit the last n committed pages
+    void Shrink(uint32_t n);
+
     size_t PageSize();
 
+    bool LargePages();
+
+    // large page size if large pages can be used by this process, 0 otherwise
+    static size_t LargePageSize();
+
+    // reserve & commit sz bytes (rounded up to the large page size) of large pages, NULL if not available
+    static void* AllocLargePages(size_t sz);
+    static void FreeLargePages(void* ptr);
+
+    DWORD NumaNode();
+
 private:
+    bool _reservePages(void* ptr, size_t sz);
+    void _releasePages(void* ptr, size_t sz);
+    void* _commitLargePages(void* ptr, size_t sz);
+    inline void* _virtualAlloc(void* ptr, size_t sz, DWORD type);
+
     DWORD m_pgSize;
     uint32_t m_numPages;
 
     void* m_start;
     void* m_reserved;
+    // end of the mapped large pages
+    void* m_committed;
     void* m_end;
     size_t m_size;
+
+    bool m_largePages;
+    DWORD m_numaNode;
+
+    static constexpr int PROBE_ATTEMPTS = 4;
 };
\ No newline at end of file
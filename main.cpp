@@ -3,13 +3,34 @@
 #include "PoolAllocator.h"
 #include "SequentialListAllocator.h"
 #include "RBTreeAllocator.h"
+#include "TLSFAllocator.h"
+#include "SlabAllocator.h"
+#include "BTreeAllocator.h"
+#include "ThreadHeapAllocator.h"
+#include "ShardedAllocator.h"
+#include "Segregator.h"
+#include "FallbackAllocator.h"
+#include "Bucketizer.h"
 #include "SystemAllocator.h"
 #include "AllocatorBenchmark.h"
+#include "AllocatorMicrobench.h"
+#include "AllocatorWorkload.h"
+#include "AllocatorInterpose.h"
+#include "PersistentHeap.h"
+#include "SharedHeap.h"
+#include "AllocatorPageMap.h"
+#include "RelocatableAllocator.h"
 #include <iostream>
 #include <Windows.h>
 #include "Util.h"
 
-int main() {
+int main(int argc, char** argv) {
+#ifdef ALLOC_MICROBENCH
+    // the microbenchmark target, scenarios with hardware counters instead of the benchmarks below
+    AllocatorMicrobench::Run();
+    return 0;
+#endif
+
     //void* p = malloc( 64* 1024*1024 );
     //SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT> sqlAllocator(64 *1024* 1024);
     //SystemAllocator sysAllocator;
@@ -44,7 +65,381 @@ int main() {
 
     //tree.Layout();
 
-    RBTreeAllocator alloc(64*1024);
+    // address ordered vs. boundary tagged free list, the Layout() after every pass reports the fragmentation
+    SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_ADDRESS_ORDERED> sqlOrdered(64 * 1024 * 1024);
+    SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG> sqlTagged(64 * 1024 * 1024);
+    AllocatorBenchmark ab;
+
+    std::cout << "\n##########################################\n";
+    std::cout << "SEQUENTIAL LIST ALLOCATOR (ADDRESS ORDERED) BENCHMARK\n";
+    ab.Benchmark(&sqlOrdered, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "SEQUENTIAL LIST ALLOCATOR (BOUNDARY TAG) BENCHMARK\n";
+    ab.Benchmark(&sqlTagged, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    // the committed size printed by Layout() is the footprint of the (size, address) ordered best fit
+    RBTreeAllocator<ALLOC_BUFFER_VMDYNAMIC> rbtAllocator(64 * 1024);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "RED BLACK TREE ALLOCATOR BENCHMARK\n";
+    ab.Benchmark(&rbtAllocator, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    TLSFAllocator<ALLOC_BUFFER_STATIC> tlsfAllocator(64 * 1024 * 1024);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "TLSF ALLOCATOR BENCHMARK\n";
+    ab.Benchmark(&tlsfAllocator, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    SlabAllocator slabAllocator(256 * 1024 * 1024);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "SLAB ALLOCATOR BENCHMARK\n";
+    ab.Benchmark(&slabAllocator, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    // same arena with regular and large pages, the alloc/free passes barely change but the memory bound
+    // throughput pass does once the working set outgrows the TLB reach of 4KB pages
+    SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG> sqlSmallPages(64 * 1024 * 1024);
+    SequentialListAllocator<ALLOC_BUFFER_VMDYNAMIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG> sqlLargePages(64 * 1024 * 1024, true);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "SEQUENTIAL LIST ALLOCATOR (4KB PAGES) BENCHMARK\n";
+    ab.Benchmark(&sqlSmallPages, AllocatorBenchmark::ALLOC_RANDOM | AllocatorBenchmark::FREE_RAND);
+    ab.Throughput(&sqlSmallPages);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "SEQUENTIAL LIST ALLOCATOR (LARGE PAGES) BENCHMARK\n";
+    if (!VMLinearAllocator::LargePageSize())
+        std::cout << "Large pages unavailable (SeLockMemoryPrivilege), falling back to regular pages\n";
+    ab.Benchmark(&sqlLargePages, AllocatorBenchmark::ALLOC_RANDOM | AllocatorBenchmark::FREE_RAND);
+    ab.Throughput(&sqlLargePages);
+
+    BTreeAllocator<ALLOC_BUFFER_VMDYNAMIC> btAllocator(64 * 1024);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "B+ TREE ALLOCATOR BENCHMARK\n";
+    ab.Benchmark(&btAllocator, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    // free block index lookups, RB tree vs B+ tree, from 10^3 to 10^6 free blocks
+    for (uint32_t nFreeBlocks = 1000; nFreeBlocks <= 1000000; nFreeBlocks *= 10) {
+        RBTreeAllocator<ALLOC_BUFFER_VMDYNAMIC> rbtFragmented(64 * 1024);
+        BTreeAllocator<ALLOC_BUFFER_VMDYNAMIC> btFragmented(64 * 1024);
+
+        std::cout << "\n##########################################\n";
+        std::cout << "RED BLACK TREE VS B+ TREE, " << nFreeBlocks << " FREE BLOCKS\n";
+        ab.Fragmented(&rbtFragmented, nFreeBlocks);
+        ab.Fragmented(&btFragmented, nFreeBlocks);
+        btFragmented.Layout();
+    }
+
+    // producer/consumer, blocks allocated on one thread and freed on another
+    ThreadHeapAllocator threadHeapAllocator(256 * 1024 * 1024);
+    SystemAllocator sysAllocator;
+
+    std::cout << "\n##########################################\n";
+    std::cout << "THREAD HEAP ALLOCATOR VS SYSTEM ALLOCATOR, CROSS THREAD FREES\n";
+    ab.CrossThread(&threadHeapAllocator);
+    ab.CrossThread(&sysAllocator);
+    threadHeapAllocator.Layout();
+
+    // one lock for everybody vs. a shard per processor, 1 to 8 threads
+    typedef SequentialListAllocator<ALLOC_BUFFER_STATIC_PREALLOC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG> SqlShard;
+    typedef RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC> RbtShard;
+
+    for (uint32_t nThreads = 1; nThreads <= 8; nThreads *= 2) {
+        ShardedAllocator<SqlShard> sqlGlobalLock(64 * 1024 * 1024, 1);
+        ShardedAllocator<SqlShard> sqlSharded(64 * 1024 * 1024);
+        ShardedAllocator<RbtShard> rbtGlobalLock(64 * 1024 * 1024, 1);
+        ShardedAllocator<RbtShard> rbtSharded(64 * 1024 * 1024);
+
+        std::cout << "\n##########################################\n";
+        std::cout << "GLOBAL LOCK VS " << sqlSharded.ShardCount() << " SHARDS, " << nThreads << " THREADS\n";
+        ab.Scaling(&sqlGlobalLock, nThreads);
+        ab.Scaling(&sqlSharded, nThreads);
+        ab.Scaling(&rbtGlobalLock, nThreads);
+        ab.Scaling(&rbtSharded, nThreads);
+    }
+
+    // lock policies, uncontended (1 thread) and contended (4 threads), the unlocked arena is the single threaded baseline
+    SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_NONE> sqlNoLock(64 * 1024 * 1024);
+    SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_SPIN> sqlSpinLock(64 * 1024 * 1024);
+    SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_MUTEX> sqlMutex(64 * 1024 * 1024);
+    SequentialListAllocator<ALLOC_BUFFER_STATIC, ALLOC_PATTERN_FIRST_FIT, ALLOC_FREELIST_BOUNDARY_TAG, ALLOC_LOCK_TICKET> sqlTicketLock(64 * 1024 * 1024);
+
+    Allocator* lockedAllocators[] = { &sqlNoLock, &sqlSpinLock, &sqlMutex, &sqlTicketLock };
+    const char* lockNames[] = { "NO LOCK", "SPINLOCK", "MUTEX", "TICKET LOCK" };
+
+    for (int i = 0; i < 4; ++i) {
+        std::cout << "\n##########################################\n";
+        std::cout << "SEQUENTIAL LIST ALLOCATOR, " << lockNames[i] << "\n";
+        ab.Scaling(lockedAllocators[i], 1);
+        if (i > 0)
+            ab.Scaling(lockedAllocators[i], 4);
+    }
+
+    // composed at compile time, small blocks from pools, the rest from a RB tree
+    Segregator<256, Bucketizer<16, 256, 16>, RBTreeAllocator<ALLOC_BUFFER_STATIC>>
+        segregator(std::make_tuple(4 * MB), std::make_tuple(64 * MB));
+    FallbackAllocator<PoolAllocator<>, RBTreeAllocator<ALLOC_BUFFER_STATIC>>
+        fallback(std::make_tuple(1 * MB, 1024), std::make_tuple(64 * MB));
+
+    std::cout << "\n##########################################\n";
+    std::cout << "SEGREGATOR (BUCKETIZED POOLS <= 256 BYTES, RED BLACK TREE) BENCHMARK\n";
+    ab.Benchmark(&segregator, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    std::cout << "\n##########################################\n";
+    std::cout << "FALLBACK (POOL, RED BLACK TREE) BENCHMARK\n";
+    ab.Benchmark(&fallback, AllocatorBenchmark::ALLOC_SEQ | AllocatorBenchmark::ALLOC_RANDOM |
+        AllocatorBenchmark::FREE_FIFO | AllocatorBenchmark::FREE_LIFO | AllocatorBenchmark::FREE_RAND);
+
+    // the renderer frame workload (or the spec file given on the command line) on one general purpose heap per run,
+    // then composed: linear scratch reset per frame, bucketized pools for short lived objects, a TLSF heap for the level & immortal ones
+    WorkloadSpec spec = WorkloadSpec::RendererFrame();
+    if (argc > 1 && !spec.Load(argv[1]))
+        return 1;
+
+    {
+        WorkloadTrace trace(spec);
+
+        std::cout << "\n##########################################\n";
+        std::cout << "WORKLOAD REPLAY\n";
+
+        TLSFAllocator<ALLOC_BUFFER_STATIC> tlsfHeap(256 * MB);
+        RBTreeAllocator<ALLOC_BUFFER_STATIC> rbtHeap(256 * MB);
+        LinearAllocator<> scratch(64 * MB);
+        Segregator<256, Bucketizer<16, 256, 16>, TLSFAllocator<ALLOC_BUFFER_STATIC>>
+            pools(std::make_tuple(16 * MB), std::make_tuple(64 * MB));
+        TLSFAllocator<ALLOC_BUFFER_STATIC> assets(256 * MB);
+
+        Allocator* tlsfStreams[WorkloadSpec::MAX_STREAMS];
+        Allocator* rbtStreams[WorkloadSpec::MAX_STREAMS];
+        Allocator* composedStreams[WorkloadSpec::MAX_STREAMS];
+        for (uint32_t s = 0; s < spec.nStreams; ++s) {
+            tlsfStreams[s] = &tlsfHeap;
+            rbtStreams[s] = &rbtHeap;
+            if (spec.streams[s].resetPerFrame)
+                composedStreams[s] = &scratch;
+            else if (spec.streams[s].lifetime.kind == WorkloadLifetime::FRAME || spec.streams[s].lifetime.kind == WorkloadLifetime::FRAMES)
+                composedStreams[s] = &pools;
+            else
+                composedStreams[s] = &assets;
+        }
+
+        trace.Replay("TLSF", tlsfStreams);
+        trace.Replay("RBTree", rbtStreams);
+        trace.Replay("Linear, Segregator Bucketizer/TLSF, TLSF", composedStreams);
+    }
+
+    // the interposed malloc family, small blocks from the thread heaps, large ones from the TLSF back-end
+    {
+        std::cout << "\n##########################################\n";
+        std::cout << "INTERPOSED MALLOC\n";
+
+        bool ok = true;
+        char* small = (char*)interpose_malloc(100);
+        memset(small, 0xAB, 100);
+        // grows past the thread heaps, the bytes move to the back-end
+        char* grown = (char*)interpose_realloc(small, 64 * 1024);
+        ok = ok && grown && grown[0] == (char)0xAB && grown[99] == (char)0xAB;
+        ok = ok && interpose_malloc_usable_size(grown) >= 64 * 1024;
+        int* zeroed = (int*)interpose_calloc(1000, sizeof(int));
+        ok = ok && zeroed && !zeroed[0] && !zeroed[999];
+        // too large for the back-end
+        ok = ok && !interpose_malloc(SIZE_MAX) && !interpose_calloc(SIZE_MAX / 2, 4);
+        interpose_free(grown);
+        interpose_free(zeroed);
+
+        std::cout << "malloc/realloc/calloc/free round trip: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    // 32 bit generational handles to pool slots, a handle to a freed slot fails to resolve even once the slot is reused
+    {
+        std::cout << "\n##########################################\n";
+        std::cout << "POOL ALLOCATOR HANDLES\n";
+
+        PoolAllocator<ALLOC_LOCK_SPIN, ALLOC_HANDLES_GENERATIONAL> pool(64 * 1024, 64);
+        PoolHandle entities[16];
+        bool ok = true;
+        for (int i = 0; i < 16; ++i) {
+            entities[i] = pool.AllocHandle();
+            ok = ok && entities[i] && pool.Resolve(entities[i]);
+        }
+
+        PoolHandle stale = entities[3];
+        void* slot = pool.Resolve(stale);
+        ok = ok && pool.FreeHandle(stale) && !pool.IsValid(stale);
+        // a second free of the same handle is refused, the slot isn't pushed twice
+        ok = ok && !pool.FreeHandle(stale);
+
+        // the slot comes back first, under a new generation
+        entities[3] = pool.AllocHandle();
+        ok = ok && pool.Resolve(entities[3]) == slot && entities[3] != stale && !pool.Resolve(stale);
+
+        for (int i = 0; i < 16; ++i)
+            ok = ok && pool.FreeHandle(entities[i]);
+
+        std::cout << "AllocHandle, Resolve, stale handle rejection: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    // a heap in a file, written by one instance and found again by the next, a file that isn't a heap is left alone
+    {
+        typedef PersistentHeap<RBTreeAllocator<ALLOC_BUFFER_STATIC_PREALLOC>> Heap;
+        const char* path = "persistent_demo.heap";
+        const char* foreignPath = "persistent_demo.txt";
+
+        std::cout << "\n##########################################\n";
+        std::cout << "PERSISTENT HEAP\n";
+
+        DeleteFileA(path);
+        Heap created(path, 1 * MB);
+        bool ok = created.Status() == Heap::CREATED;
+        char* message = (char*)created.Alloc(32, 8);
+        ok = ok && message;
+        if (message) {
+            strcpy(message, "warm restart");
+            created.SetRoot(message);
+        }
+        created.Release();
+
+        Heap reopened(path, 1 * MB);
+        ok = ok && reopened.Status() == Heap::RESTORED && reopened.Root() && !strcmp((char*)reopened.Root(), "warm restart");
+        reopened.Release();
+        DeleteFileA(path);
+        std::cout << "create, SetRoot, Release, reopen, Root: " << (ok ? "ok" : "FAILED") << "\n";
+
+        FILE* foreign = fopen(foreignPath, "w");
+        if (foreign) {
+            fputs("not a heap\n", foreign);
+            fclose(foreign);
+        }
+        Heap refused(foreignPath, 1 * MB);
+        char line[32] = {};
+        foreign = fopen(foreignPath, "r");
+        if (foreign) {
+            fgets(line, sizeof(line), foreign);
+            fclose(foreign);
+        }
+        ok = refused.Status() == Heap::FAILED && !strcmp(line, "not a heap\n");
+        refused.Release();
+        DeleteFileA(foreignPath);
+        std::cout << "foreign file left untouched: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    // one section opened twice, as a producer and a consumer process would, a handle from one resolves in the other
+    {
+        std::cout << "\n##########################################\n";
+        std::cout << "SHARED HEAP\n";
+
+        SharedHeap producer("alloc_shared_demo", 4 * MB);
+        SharedHeap consumer("alloc_shared_demo", 0);
+        bool ok = producer.Status() == SharedHeap::CREATED && consumer.Status() == SharedHeap::OPENED;
+
+        SharedHandle handle = producer.AllocHandle(256, 64);
+        ok = ok && handle != SharedHeap::NULL_HANDLE;
+        if (ok) {
+            strcpy((char*)producer.Resolve(handle), "zero copy");
+            producer.SetRoot(handle);
+            ok = consumer.Root() == handle && !strcmp((char*)consumer.Resolve(handle), "zero copy") &&
+                ((uintptr_t)consumer.Resolve(handle) & 63) == 0;
+            consumer.FreeHandle(handle);
+            consumer.SetRoot(SharedHeap::NULL_HANDLE);
+        }
+        // the free from the consumer is seen by the producer, no block is in use any more
+        HeapReport report = producer.Report();
+        ok = ok && report.nUsedBlocks == 0;
+
+        std::cout << "AllocHandle, Resolve, FreeHandle across two mappings: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    // pointers find their allocator in the page map, thread heaps are in it from the start
+    {
+        std::cout << "\n##########################################\n";
+        std::cout << "ALLOCATOR PAGE MAP\n";
+
+        SlabAllocator slabs(16 * MB);
+        ThreadHeapAllocator threadHeaps(16 * MB);
+
+        slabs.RegisterPages();
+        void* slabPtr = slabs.Alloc(64, 8);
+        void* heapPtr = threadHeaps.Alloc(64, 8);
+        bool ok = slabPtr && heapPtr && AllocatorPageMap::Owner(slabPtr) == &slabs && AllocatorPageMap::Owner(heapPtr) == &threadHeaps;
+
+        // freed through the map, the slab allocator gets it back
+        void* freed = slabPtr;
+        AllocatorPageMap::Free(slabPtr);
+        ok = ok && !slabPtr && slabs.Alloc(64, 8) == freed;
+
+        slabs.UnregisterPages();
+        ok = ok && AllocatorPageMap::Owner(freed) == NULL && threadHeaps.Owns(heapPtr);
+        threadHeaps.Free(heapPtr);
+
+        std::cout << "Register, Owner, Free, Unregister: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    // every other block freed, then compacted a slice at a time, the handles follow their blocks
+    {
+        std::cout << "\n##########################################\n";
+        std::cout << "RELOCATABLE ALLOCATOR\n";
+
+        constexpr uint32_t N_BLOCKS = 256;
+        RelocatableAllocator<> reloc(1 * MB, N_BLOCKS);
+        RelocHandle handles[N_BLOCKS];
+        bool ok = true;
+
+        for (uint32_t i = 0; i < N_BLOCKS; ++i) {
+            handles[i] = reloc.AllocHandle(1000);
+            ok = ok && handles[i];
+            if (handles[i])
+                *(uint32_t*)reloc.Resolve(handles[i]) = i;
+        }
+        for (uint32_t i = 1; i < N_BLOCKS; i += 2)
+            reloc.FreeHandle(handles[i]);
+        // the last freed block joins the free space above the top
+        ok = ok && reloc.Report().nFreeBlocks == N_BLOCKS / 2;
+
+        // once per frame, a tenth of a millisecond each, until the pass is through
+        size_t moved = 0;
+        for (uint32_t frame = 0; frame < 1000 && reloc.Report().nFreeBlocks > 1; ++frame)
+            moved += reloc.Compact(0.1);
+
+        for (uint32_t i = 0; i < N_BLOCKS; i += 2)
+            ok = ok && *(uint32_t*)reloc.Resolve(handles[i]) == i;
+        HeapReport report = reloc.Report();
+        ok = ok && moved && report.nFreeBlocks == 1 && report.nUsedBlocks == N_BLOCKS / 2;
+        // the oversized request is refused, not wrapped
+        ok = ok && !reloc.AllocHandle(SIZE_MAX);
+
+        std::cout << "moved " << moved << " bytes\n";
+        std::cout << "Fragment, Compact, Resolve: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    // a request just under the arena, the tail block fits though the class search rounded past it
+    {
+        std::cout << "\n##########################################\n";
+        std::cout << "TLSF VMDYNAMIC GROWTH\n";
+
+        bool ok = true;
+        for (size_t sz = 64 * 1024 - 512; sz < 64 * 1024; sz += 8) {
+            TLSFAllocator<ALLOC_BUFFER_VMDYNAMIC> tlsf(64 * 1024);
+            void* ptr = tlsf.Alloc(sz, 8);
+            void* next = tlsf.Alloc(64, 8);
+            ok = ok && ptr && next;
+            tlsf.Free(ptr);
+            tlsf.Free(next);
+            ok = ok && tlsf.Report().nUsedBlocks == 0;
+        }
+
+        std::cout << "Alloc up to the arena size on a fresh arena: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+
+    RBTreeAllocator<ALLOC_BUFFER_STATIC> alloc(64*1024);
     alloc.Layout();
     void* ptr1 = alloc.Alloc(64, 8);
     alloc.Layout();